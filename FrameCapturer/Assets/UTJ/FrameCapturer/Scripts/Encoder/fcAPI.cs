@@ -83,6 +83,18 @@ namespace UTJ.FrameCapturer
         [DllImport ("fccore")] private static extern void        fcDestroyStream(fcStream s);
         [DllImport ("fccore")] public static extern ulong        fcStreamGetWrittenSize(fcStream s);
 
+        // handle of a background operation (e.g. fcMP4Context.ReleaseAsync()). poll it with fcAsyncIsFinished().
+        // Release() waits for the operation if it is not finished yet. every handle must be released.
+        public struct fcAsync
+        {
+            public IntPtr ptr;
+            public void Release() { fcAsyncRelease(this); ptr = IntPtr.Zero; }
+            public static implicit operator bool(fcAsync v) { return v.ptr != IntPtr.Zero; }
+        }
+        [DllImport ("fccore")] public static extern Bool         fcAsyncIsFinished(fcAsync a);
+        [DllImport ("fccore")] public static extern void         fcAsyncWait(fcAsync a);
+        [DllImport ("fccore")] private static extern void        fcAsyncRelease(fcAsync a);
+
         [DllImport ("fccore")] public static extern void         fcGuardBegin();
         [DllImport ("fccore")] public static extern void         fcGuardEnd();
         [DllImport ("fccore")] public static extern fcDeferredCall fcAllocateDeferredCall();
@@ -337,6 +349,15 @@ namespace UTJ.FrameCapturer
             public fcBitrateMode audioBitrateMode;
             public int audioTargetBitrate;
             [HideInInspector] public int audioFlags;
+            public Bool audioSampleClock;
+
+            public double interleaveWindow;
+            public double chunkDuration;
+
+            public int videoParallelSegments;
+            public int videoSegmentFrames;
+            public int videoMaxBufferedFrames;
+            public Bool videoConstantFramerate;
 
             public static fcMP4Config default_value
             {
@@ -359,6 +380,15 @@ namespace UTJ.FrameCapturer
                         audioBitrateMode = fcBitrateMode.VBR,
                         audioTargetBitrate = 128 * 1000,
                         audioFlags = (int)fcMP4AudioFlags.AACMask,
+                        audioSampleClock = true,
+
+                        interleaveWindow = 1.0,
+                        chunkDuration = 0.5,
+
+                        videoParallelSegments = 0,
+                        videoSegmentFrames = 120,
+                        videoMaxBufferedFrames = 0,
+                        videoConstantFramerate = false,
                     };
                 }
             }
@@ -367,6 +397,8 @@ namespace UTJ.FrameCapturer
         {
             public IntPtr ptr;
             public void Release() { fcMP4DestroyContext(this); ptr = IntPtr.Zero; }
+            // returns immediately. the encoders are drained and the file is finalized in the background
+            public fcAsync ReleaseAsync() { var ret = fcMP4DestroyContextAsync(this, IntPtr.Zero, IntPtr.Zero); ptr = IntPtr.Zero; return ret; }
             public static implicit operator bool(fcMP4Context v) { return v.ptr != IntPtr.Zero; }
         }
 
@@ -374,6 +406,7 @@ namespace UTJ.FrameCapturer
         [DllImport ("fccore")] public static extern fcMP4Context     fcMP4CreateContext(ref fcMP4Config conf);
         [DllImport ("fccore")] public static extern fcMP4Context     fcMP4OSCreateContext(ref fcMP4Config conf, string path);
         [DllImport ("fccore")] private static extern void            fcMP4DestroyContext(fcMP4Context ctx);
+        [DllImport ("fccore")] private static extern fcAsync         fcMP4DestroyContextAsync(fcMP4Context ctx, IntPtr cb, IntPtr userdata);
         [DllImport ("fccore")] public static extern void             fcMP4AddOutputStream(fcMP4Context ctx, fcStream s);
         [DllImport ("fccore")] private static extern IntPtr          fcMP4GetAudioEncoderInfo(fcMP4Context ctx);
         [DllImport ("fccore")] private static extern IntPtr          fcMP4GetVideoEncoderInfo(fcMP4Context ctx);
@@ -399,6 +432,8 @@ namespace UTJ.FrameCapturer
         {
             public IntPtr ptr;
             public void Release() { fcWebMDestroyContext(this); ptr = IntPtr.Zero; }
+            // returns immediately. the encoders are drained and the file is finalized in the background
+            public fcAsync ReleaseAsync() { var ret = fcWebMDestroyContextAsync(this, IntPtr.Zero, IntPtr.Zero); ptr = IntPtr.Zero; return ret; }
             public static implicit operator bool(fcWebMContext v) { return v.ptr != IntPtr.Zero; }
         }
 
@@ -411,7 +446,13 @@ namespace UTJ.FrameCapturer
         public enum fcWebMAudioEncoder
         {
             Vorbis,
-            //Opus, // not implemented yet
+            Opus,
+        };
+        public enum fcVPXDeadline
+        {
+            Realtime,
+            Good,
+            Best,
         };
 
         [Serializable]
@@ -433,6 +474,24 @@ namespace UTJ.FrameCapturer
             public fcBitrateMode audioBitrateMode;
             public int audioTargetBitrate;
 
+            public double interleaveWindow;
+
+            public Bool live;
+            public double maxClusterDuration;
+            public int maxClusterSize;
+            public double cueInterval;
+
+            public fcVPXDeadline videoDeadline;
+            public int videoCpuUsed;
+            public int videoThreads;
+            public int videoTileColumns;
+            public Bool videoRowMT;
+            public int videoLagInFrames;
+
+            public int videoParallelSegments;
+            public int videoSegmentFrames;
+            public int videoMaxBufferedFrames;
+
             public static fcWebMConfig default_value
             {
                 get
@@ -454,6 +513,24 @@ namespace UTJ.FrameCapturer
                         audioNumChannels = 2,
                         audioBitrateMode = fcBitrateMode.VBR,
                         audioTargetBitrate = 128 * 1000,
+
+                        interleaveWindow = 1.0,
+
+                        live = true,
+                        maxClusterDuration = 0.0,
+                        maxClusterSize = 0,
+                        cueInterval = 0.0,
+
+                        videoDeadline = fcVPXDeadline.Realtime,
+                        videoCpuUsed = 8,
+                        videoThreads = 0,
+                        videoTileColumns = -1,
+                        videoRowMT = true,
+                        videoLagInFrames = 0,
+
+                        videoParallelSegments = 0,
+                        videoSegmentFrames = 120,
+                        videoMaxBufferedFrames = 0,
                     };
                 }
             }
@@ -462,6 +539,7 @@ namespace UTJ.FrameCapturer
         [DllImport ("fccore")] public static extern Bool fcWebMIsSupported();
         [DllImport ("fccore")] public static extern fcWebMContext fcWebMCreateContext(ref fcWebMConfig conf);
         [DllImport ("fccore")] private static extern void fcWebMDestroyContext(fcWebMContext ctx);
+        [DllImport ("fccore")] private static extern fcAsync fcWebMDestroyContextAsync(fcWebMContext ctx, IntPtr cb, IntPtr userdata);
         [DllImport ("fccore")] public static extern void fcWebMAddOutputStream(fcWebMContext ctx, fcStream stream);
         // timestamp=-1 is treated as current time.
         [DllImport ("fccore")] public static extern Bool fcWebMAddVideoFramePixels(fcWebMContext ctx, byte[] pixels, fcPixelFormat fmt, double timestamp = -1.0);
@@ -518,6 +596,12 @@ namespace UTJ.FrameCapturer
             public static implicit operator bool(fcOggContext v) { return v.ptr != IntPtr.Zero; }
         }
 
+        public enum fcOggAudioEncoder
+        {
+            Vorbis,
+            Opus, // sampleRate must be 8000, 12000, 16000, 24000 or 48000 and numChannels 1 or 2
+        };
+
         [Serializable]
         public struct fcOggConfig
         {
@@ -525,6 +609,7 @@ namespace UTJ.FrameCapturer
             [HideInInspector] public int numChannels;
             public fcBitrateMode bitrateMode;
             public int targetBitrate;
+            public fcOggAudioEncoder encoder;
 
             public static fcOggConfig default_value
             {
@@ -536,6 +621,7 @@ namespace UTJ.FrameCapturer
                         numChannels = 2,
                         bitrateMode = fcBitrateMode.VBR,
                         targetBitrate = 128 * 1000,
+                        encoder = fcOggAudioEncoder.Vorbis,
                     };
                 }
             }
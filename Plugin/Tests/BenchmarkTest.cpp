@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "TestCommon.h"
+
+struct BenchmarkResolution
+{
+    const char *name;
+    int width, height;
+};
+
+static const BenchmarkResolution g_resolutions[] = {
+    { "1080p", 1920, 1080 },
+    { "4K", 3840, 2160 },
+    { "8K", 7680, 4320 },
+};
+
+static const char* GetKernelTargetName(fcKernelTarget v)
+{
+    switch (v) {
+    case fcKernelTarget::SSE2: return "SSE2";
+    case fcKernelTarget::SSE4: return "SSE4";
+    case fcKernelTarget::AVX: return "AVX";
+    case fcKernelTarget::AVX2: return "AVX2";
+    case fcKernelTarget::AVX512: return "AVX512";
+    case fcKernelTarget::NEON: return "NEON";
+    default: return "Scalar";
+    }
+}
+
+
+template<class T>
+static void YUVBenchmarkImpl(const BenchmarkResolution& res)
+{
+    const int NumIterations = 10;
+    int width = res.width;
+    int height = res.height;
+
+    RawVector<T> src(width * height);
+    CreateVideoData(&src[0], width, height, 0);
+
+    RawVector<u8> i420_buf(width * height * 3 / 2);
+    I420Data i420;
+    i420.y = i420_buf.data();
+    i420.u = (u8*)i420.y + width * height;
+    i420.v = (u8*)i420.u + width * height / 4;
+    i420.pitch_y = width;
+    i420.pitch_u = i420.pitch_v = width / 2;
+    i420.height = height;
+
+    RawVector<u8> nv12_buf(width * height * 3 / 2);
+    NV12Data nv12;
+    nv12.y = nv12_buf.data();
+    nv12.uv = (u8*)nv12.y + width * height;
+    nv12.pitch_y = width;
+    nv12.pitch_uv = width;
+    nv12.height = height;
+
+    // BT.709: BT.601 limited range from RGBAu8 goes to libyuv, which would hide the kernels being measured
+    const fcColorSpace cs = fcColorSpace::BT709;
+    const fcColorRange range = fcColorRange::Limited;
+
+    // warm up thread pool and buffers
+    fcConvertToI420(i420, &src[0], GetPixelFormat<T>::value, width, height, cs, range);
+
+    auto begin = fcGetTime();
+    for (int i = 0; i < NumIterations; ++i) {
+        fcConvertToI420(i420, &src[0], GetPixelFormat<T>::value, width, height, cs, range);
+    }
+    auto i420_time = (fcGetTime() - begin) / NumIterations;
+
+    begin = fcGetTime();
+    for (int i = 0; i < NumIterations; ++i) {
+        fcConvertToNV12(nv12, &src[0], GetPixelFormat<T>::value, width, height, cs, range);
+    }
+    auto nv12_time = (fcGetTime() - begin) / NumIterations;
+
+    // bytes read + written per second
+    double bytes = (double)width * height * (sizeof(T) + 1.5);
+    printf("  [%s] %s %s: I420 %.2lfms (%.2lfGB/s), NV12 %.2lfms (%.2lfGB/s)\n",
+        GetKernelTargetName(fcGetKernelTarget()), GetPixelFormat<T>::getName(), res.name,
+        i420_time * 1000.0, bytes / i420_time / 1e9,
+        nv12_time * 1000.0, bytes / nv12_time / 1e9);
+}
+
+
+template<class D, class S>
+static void ConvertBenchmarkImpl()
+{
+    const int NumIterations = 10;
+    const int NumPixels = 3840 * 2160;
+    if (GetPixelFormat<D>::value == GetPixelFormat<S>::value) { return; }
+
+    RawVector<S> src(NumPixels);
+    RawVector<D> dst(NumPixels);
+    CreateVideoData(&src[0], 3840, 2160, 0);
+    fcConvertPixelFormat(&dst[0], GetPixelFormat<D>::value, &src[0], GetPixelFormat<S>::value, NumPixels);
+
+    auto begin = fcGetTime();
+    for (int i = 0; i < NumIterations; ++i) {
+        fcConvertPixelFormat(&dst[0], GetPixelFormat<D>::value, &src[0], GetPixelFormat<S>::value, NumPixels);
+    }
+    auto time = (fcGetTime() - begin) / NumIterations;
+
+    double bytes = (double)NumPixels * (sizeof(S) + sizeof(D));
+    printf("  [%s] %s -> %s: %.2lfms (%.2lfGB/s)\n",
+        GetKernelTargetName(fcGetKernelTarget()), GetPixelFormat<S>::getName(), GetPixelFormat<D>::getName(), time * 1000.0, bytes / time / 1e9);
+}
+
+template<class S>
+static void ConvertBenchmarkSrc()
+{
+    ConvertBenchmarkImpl<RGBAu8, S>();
+    ConvertBenchmarkImpl<RGBu8, S>();
+    ConvertBenchmarkImpl<RGBAf16, S>();
+    ConvertBenchmarkImpl<RGBf16, S>();
+    ConvertBenchmarkImpl<RGBAf32, S>();
+    ConvertBenchmarkImpl<RGBf32, S>();
+}
+
+
+// runs body with the dispatched ISPC target, then with the scalar C++ kernels. every result line is tagged with the target.
+// ISPC always dispatches to the best compiled target the CPU supports. to measure another one,
+// build with that target alone (cmake -DFCISPC_TARGETS=avx2 etc) and run again.
+template<class Body>
+static void EachKernelTarget(const Body& body)
+{
+    bool has_ispc = fcGetKernelTarget() != fcKernelTarget::Scalar;
+    for (int scalar = has_ispc ? 0 : 1; scalar < 2; ++scalar) {
+        fcForceScalarKernels(scalar != 0);
+        body();
+    }
+    fcForceScalarKernels(false);
+}
+
+void ConvertBenchmark()
+{
+    printf("ConvertBenchmark begin\n");
+    EachKernelTarget([]() {
+        ConvertBenchmarkSrc<RGBAu8>();
+        ConvertBenchmarkSrc<RGBAf16>();
+        ConvertBenchmarkSrc<RGBAf32>();
+    });
+    printf("ConvertBenchmark end\n");
+}
+
+void YUVBenchmark()
+{
+    printf("YUVBenchmark begin\n");
+    EachKernelTarget([]() {
+        for (auto& res : g_resolutions) {
+            YUVBenchmarkImpl<RGBAu8>(res);
+            YUVBenchmarkImpl<RGBAf16>(res);
+            YUVBenchmarkImpl<RGBAf32>(res);
+        }
+    });
+    printf("YUVBenchmark end\n");
+}
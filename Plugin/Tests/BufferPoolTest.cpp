@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "TestCommon.h"
+
+
+static const int GifActiveTasks = 4;
+
+static void EncodeGif(int width, int height, int frame_count)
+{
+    fcGifConfig conf;
+    conf.width = width;
+    conf.height = height;
+    conf.max_active_tasks = GifActiveTasks;
+    fcIGifContext *ctx = fcGifCreateContext(&conf);
+
+    RawVector<RGBAu8> video_frame(width * height);
+    fcTime t = 0;
+    for (int i = 0; i < frame_count; ++i) {
+        CreateVideoData(&video_frame[0], width, height, i);
+        fcGifAddFramePixels(ctx, &video_frame[0], fcPixelFormat_RGBAu8, t);
+        t += 1.0 / 30.0;
+    }
+    fcGifDestroyContext(ctx);
+}
+
+// a context created after another one of the same size must get its frame buffers from the pool,
+// and the cache must stay within what one context holds at once instead of growing with every context
+static void PoolReuseTest()
+{
+    if (!fcGifIsSupported()) {
+        printf("  pool reuse: gif is not supported\n");
+        return;
+    }
+
+    const int Width = 320;
+    const int Height = 240;
+    const int FrameCount = 8;
+
+    fcReleaseBufferPool();
+    EncodeGif(Width, Height, FrameCount);
+
+    fcBufferPoolStats before, after, settled;
+    fcGetBufferPoolStats(&before);
+    EncodeGif(Width, Height, FrameCount);
+    fcGetBufferPoolStats(&after);
+    EncodeGif(Width, Height, FrameCount);
+    fcGetBufferPoolStats(&settled);
+
+    // each task holds a raw and an RGBA frame. size classes round up by 25% at most.
+    uint64_t frame_size = Width * Height * 4;
+    uint64_t max_cached = GifActiveTasks * 2 * frame_size * 5 / 4;
+
+    uint64_t allocations = after.allocations - before.allocations;
+    uint64_t reuses = after.reuses - before.reuses;
+    bool reused = allocations > 0 && reuses > 0;
+    bool bounded = after.cached_bytes <= max_cached && settled.cached_bytes <= max_cached;
+    printf("  pool reuse: %d / %d allocations reused, cached %d KB -> %d KB (max %d KB): %s\n",
+        (int)reuses, (int)allocations, (int)(after.cached_bytes / 1024), (int)(settled.cached_bytes / 1024),
+        (int)(max_cached / 1024), reused && bounded ? "ok" : "mismatch");
+    if (!reused || !bounded) { AddTestFailure(); }
+
+    // released blocks beyond max_cached_bytes must go back to the OS
+    fcBufferPoolConfig conf;
+    conf.max_cached_bytes = 512 * 1024;
+    fcSetBufferPoolConfig(&conf);
+    EncodeGif(Width, Height, FrameCount);
+    fcBufferPoolStats limited;
+    fcGetBufferPoolStats(&limited);
+    bool capped = limited.cached_bytes <= conf.max_cached_bytes;
+    printf("  pool limit: cached %d KB (max %d KB): %s\n",
+        (int)(limited.cached_bytes / 1024), (int)(conf.max_cached_bytes / 1024), capped ? "ok" : "mismatch");
+    if (!capped) { AddTestFailure(); }
+    fcSetBufferPoolConfig(nullptr);
+}
+
+// every path of AlignedAlloc() (heap, mapped large blocks, huge pages if configured) must honor the alignment,
+// AlignedRealloc() must keep the contents when a block moves across the large allocation threshold,
+// and the allocator stats must come back to where they were once everything is freed
+static void AllocatorTest()
+{
+    const size_t Alignments[] = { 0x10, 0x20, 0x40, 0x1000 };
+    const size_t Sizes[] = { 1, 1000, 64 * 1024 + 1, 1024 * 1024, 3 * 1024 * 1024 + 7 };
+
+    auto test = [&](const char *name, const fcAllocatorConfig& conf) {
+        fcSetAllocatorConfig(&conf);
+        fcAllocatorStats before, after, peak;
+        fcGetAllocatorStats(&before);
+
+        bool aligned = true, kept = true;
+        uint64_t large_peak = 0, huge_peak = 0;
+        for (size_t alignment : Alignments) {
+            for (size_t size : Sizes) {
+                auto *p = (u8*)AlignedAlloc(size, alignment);
+                aligned = aligned && p && ((size_t)p & (alignment - 1)) == 0;
+                if (!p) { continue; }
+                for (size_t i = 0; i < size; ++i) { p[i] = u8(i * 7); }
+
+                // grow across the threshold, then shrink back
+                size_t grown = size * 4;
+                p = (u8*)AlignedRealloc(p, size, grown, alignment);
+                aligned = aligned && p && ((size_t)p & (alignment - 1)) == 0;
+                if (!p) { continue; }
+                for (size_t i = 0; i < size; ++i) { kept = kept && p[i] == u8(i * 7); }
+                fcGetAllocatorStats(&peak);
+                large_peak = std::max<uint64_t>(large_peak, peak.large_bytes - before.large_bytes);
+                huge_peak = std::max<uint64_t>(huge_peak, peak.huge_page_bytes - before.huge_page_bytes);
+                p = (u8*)AlignedRealloc(p, grown, size, alignment);
+                aligned = aligned && p && ((size_t)p & (alignment - 1)) == 0;
+                if (!p) { continue; }
+                for (size_t i = 0; i < size; ++i) { kept = kept && p[i] == u8(i * 7); }
+                AlignedFree(p, size);
+            }
+        }
+
+        fcGetAllocatorStats(&after);
+        bool released =
+            after.heap_bytes == before.heap_bytes &&
+            after.large_bytes == before.large_bytes &&
+            after.huge_page_bytes == before.huge_page_bytes &&
+            after.numa_bound_bytes == before.numa_bound_bytes;
+        printf("  allocator (%s): alignment %s, realloc %s, stats %s, large %d KB, huge pages %d KB\n", name,
+            aligned ? "ok" : "misaligned", kept ? "ok" : "corrupted", released ? "ok" : "mismatch",
+            (int)(large_peak / 1024), (int)(huge_peak / 1024));
+        if (!aligned || !kept || !released) { AddTestFailure(); }
+    };
+
+    fcAllocatorConfig conf;
+    test("default", conf);
+
+    conf.large_alloc_threshold = 1024 * 1024;
+    test("large blocks", conf);
+
+    conf.use_huge_pages = true;
+    test("huge pages", conf);
+
+    fcSetAllocatorConfig(nullptr);
+}
+
+void BufferPoolTest()
+{
+    printf("BufferPoolTest begin\n");
+
+    PoolReuseTest();
+    AllocatorTest();
+
+    printf("BufferPoolTest end\n");
+}
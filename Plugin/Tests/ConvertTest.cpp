@@ -1,62 +1,435 @@
-#include "pch.h"
-#include "TestCommon.h"
-
-const int Width = 320;
-const int Height = 240;
-
-
-template<class Src, class Dst>
-void ConvertTestImpl(fcIPngContext *ctx, RawVector<Src>& src)
-{
-    char filename[128];
-    sprintf(filename, "%s_to_%s.png", GetPixelFormat<Src>::getName(), GetPixelFormat<Dst>::getName());
-
-    RawVector<Dst> dst;
-    dst.resize(Width * Height);
-    auto data = fcConvertPixelFormat(&dst[0], GetPixelFormat<Dst>::value, &src[0], GetPixelFormat<Src>::value, src.size());
-    fcPngExportPixels(ctx, filename, data, Width, Height, GetPixelFormat<Dst>::value);
-}
-
-void ConvertTest()
-{
-    printf("ConvertTest begin\n");
-
-    fcPngConfig conf;
-    fcIPngContext *ctx = fcPngCreateContext(&conf);
-
-#define TestCases(SrcT)\
-{\
-    RawVector<SrcT> video_frame(Width * Height);\
-    CreateVideoData(&video_frame[0], Width, Height, 0);\
-    ConvertTestImpl<SrcT, RGBAu8>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGBu8>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGu8>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, Ru8>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGBAf16>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGBf16>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGf16>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, Rf16>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGBAf32>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGBf32>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, RGf32>(ctx, video_frame);\
-    ConvertTestImpl<SrcT, Rf32>(ctx, video_frame);\
-}
-
-    TestCases(RGBAu8);
-    TestCases(RGBu8);
-    TestCases(RGu8);
-    TestCases(Ru8);
-    TestCases(RGBAf16);
-    TestCases(RGBf16);
-    TestCases(RGf16);
-    TestCases(Rf16);
-    TestCases(RGBAf32);
-    TestCases(RGBf32);
-    TestCases(RGf32);
-    TestCases(Rf32);
-
-    fcPngDestroyContext(ctx);
-
-    printf("ConvertTest end\n");
-
-}
+#include "pch.h"
+#include "TestCommon.h"
+
+const int Width = 320;
+const int Height = 240;
+
+
+template<class Src, class Dst>
+void ConvertTestImpl(fcIPngContext *ctx, RawVector<Src>& src)
+{
+    char filename[128];
+    sprintf(filename, "%s_to_%s.png", GetPixelFormat<Src>::getName(), GetPixelFormat<Dst>::getName());
+
+    RawVector<Dst> dst;
+    dst.resize(Width * Height);
+    auto data = fcConvertPixelFormat(&dst[0], GetPixelFormat<Dst>::value, &src[0], GetPixelFormat<Src>::value, src.size());
+    fcPngExportPixels(ctx, filename, data, Width, Height, GetPixelFormat<Dst>::value);
+}
+
+// banded (parallel) I420 / NV12 conversion must be byte-identical to converting the whole frame at once.
+// odd sizes and band heights that don't divide the frame put chroma rows and the last band on the edges.
+static void YUVBandTest()
+{
+    struct Size { int width, height; };
+    const Size Sizes[] = { { 1280, 720 }, { 1279, 721 }, { 1921, 1081 }, { 333, 97 } };
+    const int BandRows[] = { 2, 6, 64, 100 };
+    const fcPixelFormat Formats[] = { fcPixelFormat_RGBAu8, fcPixelFormat_RGBu8, fcPixelFormat_RGBAf16, fcPixelFormat_RGBAf32, fcPixelFormat_RGBAi16 };
+    const fcColorSpace ColorSpaces[] = { fcColorSpace::BT601, fcColorSpace::BT709 };
+
+    bool ok = true;
+    for (auto& size : Sizes) {
+        int width = size.width, height = size.height;
+        int cw = (width + 1) / 2, ch = (height + 1) / 2;
+
+        // a gradient with some noise so that every plane has content that differs from row to row
+        RawVector<RGBAf32> src_f32(width * height);
+        for (int iy = 0; iy < height; ++iy) {
+            for (int ix = 0; ix < width; ++ix) {
+                float n = float((ix * 7919 + iy * 104729) % 97) / 97.0f;
+                src_f32[iy * width + ix] = RGBAf32(float(ix) / width, float(iy) / height, n, 1.0f);
+            }
+        }
+
+        for (auto fmt : Formats) {
+            RawVector<u8> src(width * height * fcGetPixelSize(fmt));
+            fcConvertPixelFormat(src.data(), fmt, src_f32.data(), fcPixelFormat_RGBAf32, width * height);
+
+            for (auto cs : ColorSpaces) {
+                auto to_i420 = [&](RawVector<u8>& buf) {
+                    buf.resize(width * height + cw * ch * 2);
+                    I420Data dst;
+                    dst.y = buf.data();
+                    dst.u = buf.data() + width * height;
+                    dst.v = buf.data() + width * height + cw * ch;
+                    dst.pitch_y = width;
+                    dst.pitch_u = dst.pitch_v = cw;
+                    dst.height = height;
+                    fcConvertToI420(dst, src.data(), fmt, width, height, cs, fcColorRange::Limited);
+                };
+                auto to_nv12 = [&](RawVector<u8>& buf) {
+                    buf.resize(width * height + cw * 2 * ch);
+                    NV12Data dst;
+                    dst.y = buf.data();
+                    dst.uv = buf.data() + width * height;
+                    dst.pitch_y = width;
+                    dst.pitch_uv = cw * 2;
+                    dst.height = height;
+                    fcConvertToNV12(dst, src.data(), fmt, width, height, cs, fcColorRange::Limited);
+                };
+
+                RawVector<u8> whole_i420, whole_nv12, banded;
+                fcSetYUVBandRows(height);
+                to_i420(whole_i420);
+                to_nv12(whole_nv12);
+                for (int rows : BandRows) {
+                    fcSetYUVBandRows(rows);
+                    to_i420(banded);
+                    if (memcmp(banded.data(), whole_i420.data(), banded.size()) != 0) {
+                        printf("  yuv bands: I420 %dx%d fmt %x band %d mismatch\n", width, height, fmt, rows);
+                        ok = false;
+                    }
+                    to_nv12(banded);
+                    if (memcmp(banded.data(), whole_nv12.data(), banded.size()) != 0) {
+                        printf("  yuv bands: NV12 %dx%d fmt %x band %d mismatch\n", width, height, fmt, rows);
+                        ok = false;
+                    }
+                }
+            }
+        }
+    }
+    fcSetYUVBandRows(0);
+    printf("  yuv bands: %s\n", ok ? "ok" : "mismatch");
+}
+
+// BT.601 limited range from RGBAu8 goes through libyuv, as it did before the ISPC kernels. float sources take the kernels.
+// the two must agree within rounding, and NV12 must hold the same samples as I420.
+static void LibyuvBoundTest()
+{
+    const int W = 1279, H = 721;
+    const int MaxDiff = 2;
+    int cw = (W + 1) / 2, ch = (H + 1) / 2;
+
+    RawVector<RGBAu8> src_u8(W * H);
+    for (int iy = 0; iy < H; ++iy) {
+        for (int ix = 0; ix < W; ++ix) {
+            int n = (ix * 7919 + iy * 104729) % 256;
+            src_u8[iy * W + ix] = RGBAu8(u8(ix * 255 / W), u8(iy * 255 / H), u8(n), 255);
+        }
+    }
+    RawVector<RGBAf32> src_f32(W * H);
+    fcConvertPixelFormat(src_f32.data(), fcPixelFormat_RGBAf32, src_u8.data(), fcPixelFormat_RGBAu8, W * H);
+
+    auto to_i420 = [&](RawVector<u8>& buf, const void *src, fcPixelFormat fmt) {
+        buf.resize(W * H + cw * ch * 2);
+        I420Data dst;
+        dst.y = buf.data();
+        dst.u = buf.data() + W * H;
+        dst.v = buf.data() + W * H + cw * ch;
+        dst.pitch_y = W;
+        dst.pitch_u = dst.pitch_v = cw;
+        dst.height = H;
+        fcConvertToI420(dst, src, fmt, W, H, fcColorSpace::BT601, fcColorRange::Limited);
+    };
+    auto to_nv12 = [&](RawVector<u8>& buf, const void *src, fcPixelFormat fmt) {
+        buf.resize(W * H + cw * 2 * ch);
+        NV12Data dst;
+        dst.y = buf.data();
+        dst.uv = buf.data() + W * H;
+        dst.pitch_y = W;
+        dst.pitch_uv = cw * 2;
+        dst.height = H;
+        fcConvertToNV12(dst, src, fmt, W, H, fcColorSpace::BT601, fcColorRange::Limited);
+    };
+    auto max_diff = [](const RawVector<u8>& a, const RawVector<u8>& b) {
+        int ret = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            ret = std::max<int>(ret, std::abs(int(a[i]) - int(b[i])));
+        }
+        return ret;
+    };
+
+    RawVector<u8> i420_u8, i420_f32, nv12_u8, nv12_f32;
+    to_i420(i420_u8, src_u8.data(), fcPixelFormat_RGBAu8);
+    to_i420(i420_f32, src_f32.data(), fcPixelFormat_RGBAf32);
+    to_nv12(nv12_u8, src_u8.data(), fcPixelFormat_RGBAu8);
+    to_nv12(nv12_f32, src_f32.data(), fcPixelFormat_RGBAf32);
+
+    // NV12 from libyuv interleaved back to I420 layout
+    bool same_samples = memcmp(nv12_u8.data(), i420_u8.data(), W * H) == 0;
+    const u8 *uv = nv12_u8.data() + W * H;
+    const u8 *u = i420_u8.data() + W * H;
+    const u8 *v = u + cw * ch;
+    for (int i = 0; i < cw * ch; ++i) {
+        same_samples = same_samples && uv[i * 2 + 0] == u[i] && uv[i * 2 + 1] == v[i];
+    }
+
+    int diff_i420 = max_diff(i420_u8, i420_f32);
+    int diff_nv12 = max_diff(nv12_u8, nv12_f32);
+    bool ok = same_samples && diff_i420 <= MaxDiff && diff_nv12 <= MaxDiff;
+    printf("  libyuv vs kernels: I420 max diff %d, NV12 max diff %d, NV12 == I420 %s: %s\n",
+        diff_i420, diff_nv12, same_samples ? "yes" : "no", ok ? "ok" : "mismatch");
+    if (!ok) { AddTestFailure(); }
+}
+
+static double GetElement(const void *data, fcPixelFormat fmt, size_t i)
+{
+    switch (fmt & fcPixelFormat_TypeMask) {
+    case fcPixelFormat_Type_u8:  return ((const u8*)data)[i];
+    case fcPixelFormat_Type_i16: return ((const uint16_t*)data)[i];
+    case fcPixelFormat_Type_i32: return ((const int32_t*)data)[i];
+    case fcPixelFormat_Type_f16: return (float)((const half*)data)[i];
+    case fcPixelFormat_Type_f32: return ((const float*)data)[i];
+    default: return 0.0;
+    }
+}
+
+// ISPC and C++ kernels round differently in places (fast-math, rcp), so results may differ by one step of the format
+static bool NearlyEqual(const void *a, const void *b, fcPixelFormat fmt, size_t num_elements)
+{
+    int type = fmt & fcPixelFormat_TypeMask;
+    for (size_t i = 0; i < num_elements; ++i) {
+        double va = GetElement(a, fmt, i), vb = GetElement(b, fmt, i);
+        double tolerance = 1.0;
+        if (type == fcPixelFormat_Type_f16) { tolerance = 1e-3 * std::max(1.0, std::abs(va)); }
+        if (type == fcPixelFormat_Type_f32) { tolerance = 1e-5 * std::max(1.0, std::abs(va)); }
+        if (std::abs(va - vb) > tolerance) { return false; }
+    }
+    return true;
+}
+
+// every ISPC kernel against its generic:: C++ counterpart (fcForceScalarKernels())
+static void KernelTest()
+{
+    fcForceScalarKernels(false);
+    if (fcGetKernelTarget() == fcKernelTarget::Scalar) {
+        printf("  ispc vs scalar kernels: ISPC is not available\n");
+        return;
+    }
+
+    const int W = 331, H = 67; // odd sizes to exercise the kernels' tails
+    const fcPixelFormat Formats[] = {
+        fcPixelFormat_RGBAu8, fcPixelFormat_RGBu8, fcPixelFormat_RGu8, fcPixelFormat_Ru8,
+        fcPixelFormat_RGBAi16, fcPixelFormat_RGBi16, fcPixelFormat_RGi16, fcPixelFormat_Ri16,
+        fcPixelFormat_RGBAi32, fcPixelFormat_RGBi32, fcPixelFormat_RGi32, fcPixelFormat_Ri32,
+        fcPixelFormat_RGBAf16, fcPixelFormat_RGBf16, fcPixelFormat_RGf16, fcPixelFormat_Rf16,
+        fcPixelFormat_RGBAf32, fcPixelFormat_RGBf32, fcPixelFormat_RGf32, fcPixelFormat_Rf32,
+    };
+    const int MaxPixelSize = 16;
+
+    RawVector<RGBAf32> src_f32(W * H);
+    for (int i = 0; i < W * H; ++i) {
+        float n = float((i * 7919) % 251) / 251.0f;
+        src_f32[i] = RGBAf32(float(i % W) / W, float(i / W) / H, n, 1.0f - n);
+    }
+
+    int num_cases = 0, num_mismatches = 0;
+    auto check = [&](bool ok, const char *what, fcPixelFormat srcfmt, fcPixelFormat dstfmt) {
+        ++num_cases;
+        if (!ok) {
+            ++num_mismatches;
+            printf("  ispc vs scalar kernels: %s %x -> %x mismatch\n", what, srcfmt, dstfmt);
+        }
+    };
+
+    RawVector<u8> src(W * H * MaxPixelSize), ispc(W * H * MaxPixelSize), scalar(W * H * MaxPixelSize);
+    for (auto srcfmt : Formats) {
+        fcForceScalarKernels(true);
+        fcConvertPixelFormat(src.data(), srcfmt, src_f32.data(), fcPixelFormat_RGBAf32, W * H);
+
+        for (auto dstfmt : Formats) {
+            if (srcfmt == dstfmt) { continue; }
+            size_t num_elements = W * H * (dstfmt & fcPixelFormat_ChannelMask);
+
+            // format conversion
+            fcForceScalarKernels(false);
+            fcConvertPixelFormat(ispc.data(), dstfmt, src.data(), srcfmt, W * H);
+            fcForceScalarKernels(true);
+            fcConvertPixelFormat(scalar.data(), dstfmt, src.data(), srcfmt, W * H);
+            check(NearlyEqual(ispc.data(), scalar.data(), dstfmt, num_elements), "convert", srcfmt, dstfmt);
+
+            // resize + flip, both filters. i32 is not supported by fcTransformPixels()
+            if ((srcfmt & fcPixelFormat_TypeMask) == fcPixelFormat_Type_i32 || (dstfmt & fcPixelFormat_TypeMask) == fcPixelFormat_Type_i32) {
+                continue;
+            }
+            fcPixelRect src_rect, dst_rect;
+            src_rect.width = W;
+            src_rect.height = H;
+            dst_rect.width = W / 3;
+            dst_rect.height = H / 2;
+            size_t num_dst_elements = dst_rect.width * dst_rect.height * (dstfmt & fcPixelFormat_ChannelMask);
+            int flags[] = { fcTransform_FlipY, fcTransform_FlipY | fcTransform_Bilinear };
+            for (int f : flags) {
+                fcForceScalarKernels(false);
+                fcTransformPixels(ispc.data(), dstfmt, &dst_rect, src.data(), srcfmt, &src_rect, f);
+                fcForceScalarKernels(true);
+                fcTransformPixels(scalar.data(), dstfmt, &dst_rect, src.data(), srcfmt, &src_rect, f);
+                check(NearlyEqual(ispc.data(), scalar.data(), dstfmt, num_dst_elements),
+                    (f & fcTransform_Bilinear) ? "transform (bilinear)" : "transform (box)", srcfmt, dstfmt);
+            }
+        }
+
+        // fused YUV kernels. full range BT.709 so that libyuv is not involved
+        if (srcfmt == fcPixelFormat_RGBAu8 || srcfmt == fcPixelFormat_RGBAf16 || srcfmt == fcPixelFormat_RGBAf32) {
+            int cw = (W + 1) / 2, ch = (H + 1) / 2;
+            auto yuv = [&](RawVector<u8>& buf, bool nv12) {
+                if (nv12) {
+                    NV12Data dst;
+                    dst.y = buf.data();
+                    dst.uv = buf.data() + W * H;
+                    dst.pitch_y = W;
+                    dst.pitch_uv = cw * 2;
+                    dst.height = H;
+                    fcConvertToNV12(dst, src.data(), srcfmt, W, H, fcColorSpace::BT709, fcColorRange::Full);
+                }
+                else {
+                    I420Data dst;
+                    dst.y = buf.data();
+                    dst.u = buf.data() + W * H;
+                    dst.v = buf.data() + W * H + cw * ch;
+                    dst.pitch_y = W;
+                    dst.pitch_u = dst.pitch_v = cw;
+                    dst.height = H;
+                    fcConvertToI420(dst, src.data(), srcfmt, W, H, fcColorSpace::BT709, fcColorRange::Full);
+                }
+            };
+            for (int nv12 = 0; nv12 < 2; ++nv12) {
+                fcForceScalarKernels(false);
+                yuv(ispc, nv12 != 0);
+                fcForceScalarKernels(true);
+                yuv(scalar, nv12 != 0);
+                check(NearlyEqual(ispc.data(), scalar.data(), fcPixelFormat_Ru8, W * H + cw * ch * 2),
+                    nv12 ? "NV12" : "I420", srcfmt, nv12 ? fcPixelFormat_NV12 : fcPixelFormat_I420);
+            }
+        }
+    }
+    fcForceScalarKernels(false);
+
+    printf("  ispc vs scalar kernels: %d cases, %s\n", num_cases, num_mismatches == 0 ? "ok" : "mismatch");
+}
+
+void ConvertTest()
+{
+    printf("ConvertTest begin\n");
+
+    fcPngConfig conf;
+    fcIPngContext *ctx = fcPngCreateContext(&conf);
+
+#define TestCases(SrcT)\
+{\
+    RawVector<SrcT> video_frame(Width * Height);\
+    CreateVideoData(&video_frame[0], Width, Height, 0);\
+    ConvertTestImpl<SrcT, RGBAu8>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBu8>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGu8>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, Ru8>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBAi16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBi16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGi16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, Ri16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBAi32>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBi32>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGi32>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, Ri32>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBAf16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBf16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGf16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, Rf16>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBAf32>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGBf32>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, RGf32>(ctx, video_frame);\
+    ConvertTestImpl<SrcT, Rf32>(ctx, video_frame);\
+}
+
+    TestCases(RGBAu8);
+    TestCases(RGBu8);
+    TestCases(RGu8);
+    TestCases(Ru8);
+    TestCases(RGBAi16);
+    TestCases(RGBi16);
+    TestCases(RGi16);
+    TestCases(Ri16);
+    TestCases(RGBAi32);
+    TestCases(RGBi32);
+    TestCases(RGi32);
+    TestCases(Ri32);
+    TestCases(RGBAf16);
+    TestCases(RGBf16);
+    TestCases(RGf16);
+    TestCases(Rf16);
+    TestCases(RGBAf32);
+    TestCases(RGBf32);
+    TestCases(RGf32);
+    TestCases(Rf32);
+
+    // crop + flip + resize + conversion, both directly and as the png context's input stage
+    {
+        RawVector<RGBAf16> video_frame(Width * Height);
+        CreateVideoData(&video_frame[0], Width, Height, 0);
+
+        fcPixelRect src_rect;
+        src_rect.x = Width / 4;
+        src_rect.y = Height / 4;
+        src_rect.width = Width / 2;
+        src_rect.height = Height / 2;
+        src_rect.pitch = Width * sizeof(RGBAf16);
+
+        fcPixelRect dst_rect;
+        dst_rect.width = Width / 4;
+        dst_rect.height = Height / 4;
+
+        RawVector<RGBu8> dst(dst_rect.width * dst_rect.height);
+        fcTransformPixels(&dst[0], fcPixelFormat_RGBu8, &dst_rect, &video_frame[0], fcPixelFormat_RGBAf16, &src_rect, fcTransform_FlipY);
+        fcPngExportPixels(ctx, "Transform_Box.png", &dst[0], dst_rect.width, dst_rect.height, fcPixelFormat_RGBu8);
+
+        // regions that don't fit the image and i32 formats are rejected
+        {
+            fcPixelRect r = src_rect;
+            r.x = Width - r.width + 1;
+            bool x_rejected = !fcTransformPixels(&dst[0], fcPixelFormat_RGBu8, &dst_rect, &video_frame[0], fcPixelFormat_RGBAf16, &r, 0);
+            r = src_rect;
+            r.image_height = Height;
+            r.y = Height - r.height + 1;
+            bool y_rejected = !fcTransformPixels(&dst[0], fcPixelFormat_RGBu8, &dst_rect, &video_frame[0], fcPixelFormat_RGBAf16, &r, 0);
+            RawVector<RGBi32> dst_i32(dst_rect.width * dst_rect.height);
+            bool i32_rejected = !fcTransformPixels(&dst_i32[0], fcPixelFormat_RGBi32, &dst_rect, &video_frame[0], fcPixelFormat_RGBAf16, &src_rect, 0);
+            printf("  transform validation: %s\n", x_rejected && y_rejected && i32_rejected ? "ok" : "out of bounds rect or i32 accepted");
+        }
+
+        fcPixelTransform t;
+        t.src_rect = src_rect;
+        t.flags = fcTransform_FlipY | fcTransform_Bilinear;
+        fcPngSetPixelTransform(ctx, &t);
+        fcPngExportPixels(ctx, "Transform_Bilinear.png", &video_frame[0], Width, Height, fcPixelFormat_RGBAf16);
+        fcPngSetPixelTransform(ctx, nullptr);
+    }
+
+    // interleaved -> planar audio samples. every channel must come back bit-exact.
+    {
+        const int NumFrames = 48000 + 7; // odd length to exercise the kernel's tail
+        const int NumChannels = 3;
+
+        RawVector<float> planar[NumChannels];
+        RawVector<float> interleaved(NumFrames * NumChannels);
+        for (int ci = 0; ci < NumChannels; ++ci) {
+            planar[ci].resize(NumFrames);
+            CreateAudioData(planar[ci].data(), NumFrames, 0.0, 1.0f / (ci + 1));
+            for (int fi = 0; fi < NumFrames; ++fi) {
+                interleaved[fi * NumChannels + ci] = planar[ci][fi];
+            }
+        }
+
+        RawVector<float> result[NumChannels];
+        float *dst[NumChannels];
+        for (int ci = 0; ci < NumChannels; ++ci) {
+            result[ci].resize(NumFrames);
+            dst[ci] = result[ci].data();
+        }
+        fcDeinterleaveSamples(dst, interleaved.data(), NumFrames, NumChannels);
+
+        bool ok = true;
+        for (int ci = 0; ci < NumChannels; ++ci) {
+            ok = ok && memcmp(result[ci].data(), planar[ci].data(), sizeof(float) * NumFrames) == 0;
+        }
+        printf("  deinterleave samples: %s\n", ok ? "ok" : "mismatch");
+    }
+
+    YUVBandTest();
+    LibyuvBoundTest();
+    KernelTest();
+
+    fcPngDestroyContext(ctx);
+
+    printf("ConvertTest end\n");
+
+}
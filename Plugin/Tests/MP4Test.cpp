@@ -1,114 +1,146 @@
-#include "pch.h"
-#include "TestCommon.h"
-
-
-// custom stream functions (just a wrapper of FILE)
-static size_t tellp(void *f) { return ftell((FILE*)f); }
-static void   seekp(void *f, size_t pos) { fseek((FILE*)f, (long)pos, SEEK_SET); }
-static size_t write(void *f, const void *data, size_t len) { return fwrite(data, 1, len, (FILE*)f); }
-
-
-const int DurationInSeconds = 10;
-const int FrameRate = 60;
-const int Width = 320;
-const int Height = 240;
-
-const int SampleRate = 48000;
-const int NumChannels = 1;
-
-
-static void WriteMovieData(fcIMP4Context *ctx)
-{
-    // add video frames
-    std::thread video_thread = std::thread([&]() {
-        RawVector<RGBAu8> video_frame(Width * Height);
-        fcTime t = 0;
-        for (int i = 0; i < DurationInSeconds * FrameRate; ++i) {
-            CreateVideoData(&video_frame[0], Width, Height, i);
-            fcMP4AddVideoFramePixels(ctx, &video_frame[0], fcPixelFormat_RGBAu8, t);
-            t += 1.0 / FrameRate;
-        }
-    });
-
-    // add audio frames
-    std::thread audio_thread = std::thread([&]() {
-        RawVector<float> audio_sample(SampleRate * NumChannels);
-        fcTime t = 0;
-        for (int i = 0; i < DurationInSeconds; ++i) {
-            CreateAudioData(&audio_sample[0], (int)audio_sample.size(), i, 1.0f);
-            fcMP4AddAudioFrame(ctx, &audio_sample[0], (int)audio_sample.size(), t);
-            t += 1.0;
-        }
-    });
-
-    // wait
-    video_thread.join();
-    audio_thread.join();
-}
-
-
-void MP4Test(int video_encoder, int audio_encoder, const char *filename)
-{
-    fcMP4Config conf;
-    conf.video_width = Width;
-    conf.video_height = Height;
-    conf.video_bitrate_mode = fcVBR;
-    conf.video_target_bitrate = 256000;
-    conf.video_flags = video_encoder;
-    conf.audio_sample_rate = SampleRate;
-    conf.audio_num_channels = NumChannels;
-    conf.audio_target_bitrate = 128000;
-    conf.audio_flags = audio_encoder;
-
-
-    printf("MP4Test (%s) begin\n", filename);
-
-    fcStream* fstream = fcCreateFileStream(filename);
-    fcIMP4Context *ctx = fcMP4CreateContext(&conf);
-    if (!ctx) {
-        printf("  Failed to create context. Possibly H264 or AAC encoder is not available.\n");
-    }
-    fcMP4AddOutputStream(ctx, fstream);
-    WriteMovieData(ctx);
-    fcMP4DestroyContext(ctx);
-    fcDestroyStream(fstream);
-
-    printf("MP4Test (%s) end\n", filename);
-}
-
-void MP4TestOSProvidedEncoder(const char *filename)
-{
-    fcMP4Config conf;
-    conf.video_width = Width;
-    conf.video_height = Height;
-    conf.video_bitrate_mode = fcVBR;
-    conf.video_target_bitrate = 256000;
-    conf.audio_sample_rate = SampleRate;
-    conf.audio_num_channels = NumChannels;
-    conf.audio_target_bitrate = 128000;
-
-    printf("MP4Test (%s) begin\n", filename);
-
-    fcIMP4Context *ctx = fcMP4OSCreateContext(&conf, "WMF.mp4");
-    WriteMovieData(ctx);
-    fcMP4DestroyContext(ctx);
-
-    printf("MP4Test (%s) end\n", filename);
-}
-
-
-void MP4Test()
-{
-    if (!fcMP4IsSupported()) {
-        printf("MP4Test: mp4 is not supported\n");
-        return;
-    }
-
-    MP4Test(fcMP4_H264NVIDIA, 0, "NVIDIA.mp4");
-    MP4Test(fcMP4_H264AMD, 0, "AMD.mp4");
-    MP4Test(fcMP4_H264IntelHW, 0, "IntelHW.mp4");
-    MP4Test(fcMP4_H264IntelSW, 0, "IntelSW.mp4");
-    MP4Test(fcMP4_H264OpenH264, fcMP4_AACFAAC, "OpenH264.mp4");
-    MP4TestOSProvidedEncoder("WMF.mp4");
-}
-
+#include "pch.h"
+#include "TestCommon.h"
+
+
+// custom stream functions (just a wrapper of FILE)
+static size_t tellp(void *f) { return ftell((FILE*)f); }
+static void   seekp(void *f, size_t pos) { fseek((FILE*)f, (long)pos, SEEK_SET); }
+static size_t write(void *f, const void *data, size_t len) { return fwrite(data, 1, len, (FILE*)f); }
+
+
+const int DurationInSeconds = 10;
+const int FrameRate = 60;
+const int Width = 320;
+const int Height = 240;
+
+const int SampleRate = 48000;
+const int NumChannels = 1;
+
+
+static void WriteMovieData(fcIMP4Context *ctx)
+{
+    // add video frames
+    std::thread video_thread = std::thread([&]() {
+        RawVector<RGBAu8> video_frame(Width * Height);
+        fcTime t = 0;
+        for (int i = 0; i < DurationInSeconds * FrameRate; ++i) {
+            CreateVideoData(&video_frame[0], Width, Height, i);
+            fcMP4AddVideoFramePixels(ctx, &video_frame[0], fcPixelFormat_RGBAu8, t);
+            t += 1.0 / FrameRate;
+        }
+    });
+
+    // add audio frames
+    std::thread audio_thread = std::thread([&]() {
+        RawVector<float> audio_sample(SampleRate * NumChannels);
+        fcTime t = 0;
+        for (int i = 0; i < DurationInSeconds; ++i) {
+            CreateAudioData(&audio_sample[0], (int)audio_sample.size(), i, 1.0f);
+            fcMP4AddAudioFrame(ctx, &audio_sample[0], (int)audio_sample.size(), t);
+            t += 1.0;
+        }
+    });
+
+    // wait
+    video_thread.join();
+    audio_thread.join();
+}
+
+
+void MP4Test(int video_encoder, int audio_encoder, const char *filename)
+{
+    fcMP4Config conf;
+    conf.video_width = Width;
+    conf.video_height = Height;
+    conf.video_bitrate_mode = fcVBR;
+    conf.video_target_bitrate = 256000;
+    conf.video_flags = video_encoder;
+    conf.audio_sample_rate = SampleRate;
+    conf.audio_num_channels = NumChannels;
+    conf.audio_target_bitrate = 128000;
+    conf.audio_flags = audio_encoder;
+
+
+    printf("MP4Test (%s) begin\n", filename);
+
+    fcStream* fstream = fcCreateFileStream(filename);
+    fcIMP4Context *ctx = fcMP4CreateContext(&conf);
+    if (!ctx) {
+        printf("  Failed to create context. Possibly H264 or AAC encoder is not available.\n");
+    }
+    fcMP4AddOutputStream(ctx, fstream);
+    fcStream* h264_tap = fcCreateMemoryStream();
+    fcStream* aac_tap = fcCreateMemoryStream();
+    fcMP4AddElementaryStreamTap(ctx, h264_tap, aac_tap);
+    fcSetContextTracing(ctx, true);
+    WriteMovieData(ctx);
+
+    PrintContextStats(ctx);
+    if (ctx) { CheckContextStats(ctx); }
+    std::string trace_path = std::string(filename) + ".trace.json";
+    fcDumpContextTrace(ctx, trace_path.c_str());
+
+    // finalize in background. fstream must stay alive until it is done.
+    std::atomic_bool finished(false);
+    fcAsync *async = fcMP4DestroyContextAsync(ctx, [](void *userdata) { *(std::atomic_bool*)userdata = true; }, &finished);
+    fcTime wait_begin = fcGetTime();
+    while (!fcAsyncIsFinished(async)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    fcAsyncRelease(async);
+    printf("  finalized in %.1lfms (callback %s)\n", (fcGetTime() - wait_begin) * 1000.0, finished ? "called" : "not called");
+    printf("  elementary streams: h264 %llu bytes, aac %llu bytes\n",
+        (unsigned long long)fcStreamGetWrittenSize(h264_tap), (unsigned long long)fcStreamGetWrittenSize(aac_tap));
+    fcDestroyStream(aac_tap);
+    fcDestroyStream(h264_tap);
+    fcDestroyStream(fstream);
+
+    printf("MP4Test (%s) end\n", filename);
+}
+
+void MP4TestOSProvidedEncoder(const char *filename)
+{
+    fcMP4Config conf;
+    conf.video_width = Width;
+    conf.video_height = Height;
+    conf.video_bitrate_mode = fcVBR;
+    conf.video_target_bitrate = 256000;
+    conf.audio_sample_rate = SampleRate;
+    conf.audio_num_channels = NumChannels;
+    conf.audio_target_bitrate = 128000;
+
+    printf("MP4Test (%s) begin\n", filename);
+
+    fcIMP4Context *ctx = fcMP4OSCreateContext(&conf, "WMF.mp4");
+    WriteMovieData(ctx);
+    fcMP4DestroyContext(ctx);
+
+    printf("MP4Test (%s) end\n", filename);
+}
+
+
+void MP4Test()
+{
+    if (!fcMP4IsSupported()) {
+        printf("MP4Test: mp4 is not supported\n");
+        return;
+    }
+
+    // probe all encoders in the background while the first tests run. contexts then skip encoders that failed.
+    {
+        fcMP4Config conf;
+        conf.video_width = Width;
+        conf.video_height = Height;
+        conf.audio_sample_rate = SampleRate;
+        conf.audio_num_channels = NumChannels;
+        fcMP4ProbeEncoders(&conf);
+    }
+
+    MP4Test(fcMP4_H264NVIDIA, 0, "NVIDIA.mp4");
+    MP4Test(fcMP4_H264AMD, 0, "AMD.mp4");
+    MP4Test(fcMP4_H264IntelHW, 0, "IntelHW.mp4");
+    MP4Test(fcMP4_H264IntelSW, 0, "IntelSW.mp4");
+    MP4Test(fcMP4_H264OpenH264, fcMP4_AACFAAC, "OpenH264.mp4");
+    MP4TestOSProvidedEncoder("WMF.mp4");
+}
+
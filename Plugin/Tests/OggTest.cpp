@@ -1,33 +1,120 @@
-#include "pch.h"
-#include "TestCommon.h"
-
-void OggTest()
-{
-    const int SamplingRate = 48000;
-    const int DurationInSeconds = 10;
-
-    char filename[32];
-    sprintf(filename, "test.ogg");
-
-    fcOggConfig conf;
-    conf.sample_rate = SamplingRate;
-    conf.num_channels = 1;
-    fcStream *fstream = fcCreateFileStream(filename);
-    fcIOggContext *ctx = fcOggCreateContext(&conf);
-    fcOggAddOutputStream(ctx, fstream);
-
-
-    // add audio frames
-    {
-        RawVector<float> audio_sample(SamplingRate);
-        fcTime t = 0;
-        while (t < (double)DurationInSeconds) {
-            CreateAudioData(audio_sample.data(), (int)audio_sample.size(), t, 1.0f);
-            fcOggAddAudioFrame(ctx, audio_sample.data(), (int)audio_sample.size(), t);
-            t += 1.0;
-        }
-    }
-
-    fcOggDestroyContext(ctx);
-    fcDestroyStream(fstream);
-}
+#include "pch.h"
+#include "TestCommon.h"
+
+void OggTest(fcOggAudioEncoder encoder)
+{
+    const int SamplingRate = 48000;
+    const int DurationInSeconds = 10;
+
+    const char *encoder_name = "";
+    switch (encoder) {
+    case fcOggAudioEncoder::Vorbis: encoder_name = "Vorbis"; break;
+    case fcOggAudioEncoder::Opus: encoder_name = "Opus"; break;
+    }
+    char filename[64];
+    sprintf(filename, "%s.ogg", encoder_name);
+
+    fcOggConfig conf;
+    conf.encoder = encoder;
+    conf.sample_rate = SamplingRate;
+    conf.num_channels = 1;
+    fcStream *fstream = fcCreateFileStream(filename);
+    fcIOggContext *ctx = fcOggCreateContext(&conf);
+    if (!ctx) {
+        printf("OggTest: %s is not supported\n", encoder_name);
+        fcDestroyStream(fstream);
+        return;
+    }
+    fcOggAddOutputStream(ctx, fstream);
+
+
+    // add audio frames
+    {
+        RawVector<float> audio_sample(SamplingRate);
+        fcTime t = 0;
+        while (t < (double)DurationInSeconds) {
+            CreateAudioData(audio_sample.data(), (int)audio_sample.size(), t, 1.0f);
+            fcOggAddAudioFrame(ctx, audio_sample.data(), (int)audio_sample.size(), t);
+            t += 1.0;
+        }
+    }
+
+    fcOggDestroyContext(ctx);
+    fcDestroyStream(fstream);
+}
+
+// one audio analysis written to Ogg, WebM (audio only) and a raw packet stream
+void OggSharedEncoderTest()
+{
+    const int SamplingRate = 48000;
+    const int DurationInSeconds = 10;
+
+    fcOggConfig conf;
+    conf.sample_rate = SamplingRate;
+    conf.num_channels = 1;
+    fcIOggContext *ctx = fcOggCreateContext(&conf);
+    if (!ctx) { return; }
+
+    fcWebMConfig wconf;
+    wconf.video = false;
+    wconf.audio_sample_rate = SamplingRate;
+    wconf.audio_num_channels = 1;
+    fcIWebMContext *webm = fcWebMCreateContext(&wconf);
+
+    // a webm track declared with another format must be refused
+    {
+        fcWebMConfig mconf = wconf;
+        mconf.audio_num_channels = 2;
+        fcIWebMContext *mismatch = fcWebMCreateContext(&mconf);
+        if (mismatch) {
+            printf("  format mismatch: %s\n", !fcOggAddWebMOutput(ctx, mismatch) ? "ok" : "accepted");
+            fcWebMDestroyContext(mismatch);
+        }
+    }
+
+    fcStream *ostream = fcCreateFileStream("Shared.ogg");
+    fcStream *wstream = fcCreateFileStream("Shared.webm");
+    fcStream *pstream = fcCreateFileStream("Shared.packets");
+    fcOggAddOutputStream(ctx, ostream);
+    fcOggAddPacketStream(ctx, pstream);
+    if (webm) {
+        fcWebMAddOutputStream(webm, wstream);
+        if (!fcOggAddWebMOutput(ctx, webm)) {
+            printf("OggSharedEncoderTest: fcOggAddWebMOutput() failed\n");
+        }
+    }
+
+    // add audio frames
+    {
+        RawVector<float> audio_sample(SamplingRate);
+        fcTime t = 0;
+        while (t < (double)DurationInSeconds) {
+            CreateAudioData(audio_sample.data(), (int)audio_sample.size(), t, 1.0f);
+            fcOggAddAudioFrame(ctx, audio_sample.data(), (int)audio_sample.size(), t);
+            t += 1.0;
+        }
+    }
+
+    // the Ogg context feeds webm, so it goes first
+    fcOggDestroyContext(ctx);
+    fcWebMDestroyContext(webm);
+    fcDestroyStream(ostream);
+    fcDestroyStream(wstream);
+    fcDestroyStream(pstream);
+}
+
+
+void OggTest()
+{
+    printf("OggTest (Vorbis) begin\n");
+    OggTest(fcOggAudioEncoder::Vorbis);
+    printf("OggTest (Vorbis) end\n");
+
+    printf("OggTest (Opus) begin\n");
+    OggTest(fcOggAudioEncoder::Opus);
+    printf("OggTest (Opus) end\n");
+
+    printf("OggTest (shared encoder) begin\n");
+    OggSharedEncoderTest();
+    printf("OggTest (shared encoder) end\n");
+}
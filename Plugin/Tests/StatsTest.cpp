@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "TestCommon.h"
+
+
+static bool Near(double v, double expected, double tolerance)
+{
+    return std::abs(v - expected) <= expected * tolerance;
+}
+
+// percentiles of known durations must land within the bucket resolution (~10%) of the true value
+static void HistogramTest()
+{
+    {
+        StatsHistogram hist;
+        for (int i = 0; i < 98; ++i) { hist.add(0.001); }
+        for (int i = 0; i < 2; ++i) { hist.add(0.1); }
+
+        fcStageStats s;
+        hist.get(s);
+        bool ok =
+            s.count == 100 &&
+            Near(s.total_ms, 298.0, 0.001) &&
+            Near(s.max_ms, 100.0, 0.001) &&
+            Near(s.p50_ms, 1.0, 0.1) &&
+            Near(s.p99_ms, 100.0, 0.1);
+        printf("  histogram: count %llu, total %.3lfms, p50 %.3lfms, p99 %.3lfms, max %.3lfms: %s\n",
+            (unsigned long long)s.count, s.total_ms, s.p50_ms, s.p99_ms, s.max_ms, ok ? "ok" : "mismatch");
+    }
+
+    {
+        // one sample of d and one far above it: the median is d's bucket, unaffected by the max clamp
+        const double Durations[] = { 3e-6, 50e-6, 1e-3, 17e-3, 250e-3, 2.0 };
+        bool ok = true;
+        for (double d : Durations) {
+            StatsHistogram hist;
+            hist.add(d);
+            hist.add(d * 1000.0);
+
+            fcStageStats s;
+            hist.get(s);
+            if (!Near(s.p50_ms, d * 1e3, 0.1)) {
+                printf("  histogram: p50 of %.6lfms is %.6lfms\n", d * 1e3, s.p50_ms);
+                ok = false;
+            }
+        }
+        printf("  histogram: percentile resolution: %s\n", ok ? "ok" : "mismatch");
+    }
+
+    {
+        StatsHistogram hist;
+        fcStageStats s;
+        hist.get(s);
+        bool ok = s.count == 0 && s.total_ms == 0.0 && s.p50_ms == 0.0 && s.p99_ms == 0.0 && s.max_ms == 0.0;
+        printf("  histogram: empty: %s\n", ok ? "ok" : "mismatch");
+    }
+}
+
+void StatsTest()
+{
+    printf("StatsTest begin\n");
+    HistogramTest();
+    printf("StatsTest end\n");
+}
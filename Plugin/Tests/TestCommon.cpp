@@ -1,77 +1,158 @@
-#include "pch.h"
-#include "TestCommon.h"
-#ifdef _WIN32
-    #pragma comment(lib, "Half.lib")
-#endif
-
-
-template<class T> T White();
-template<class T> T Black();
-
-template<> Ru8       White() { return Ru8(255); }
-template<> Rf16      White() { return Rf16(1.0f); }
-template<> Rf32      White() { return Rf32(1.0f); }
-template<> RGu8      White() { return RGu8(255, 255); }
-template<> RGf16     White() { return RGf16(1.0f, 1.0f); }
-template<> RGf32     White() { return RGf32(1.0f, 1.0f); }
-template<> RGBu8     White() { return RGBu8(255, 255, 255); }
-template<> RGBf16    White() { return RGBf16(1.0f, 1.0f, 1.0f); }
-template<> RGBf32    White() { return RGBf32(1.0f, 1.0f, 1.0f); }
-template<> RGBAu8    White() { return RGBAu8(255, 255, 255, 255); }
-template<> RGBAf16   White() { return RGBAf16(1.0f, 1.0f, 1.0f, 1.0f); }
-template<> RGBAf32   White() { return RGBAf32(1.0f, 1.0f, 1.0f, 1.0f); }
-
-template<> Ru8       Black() { return Ru8(0); }
-template<> Rf16      Black() { return Rf16(0.0f); }
-template<> Rf32      Black() { return Rf32(0.0f); }
-template<> RGu8      Black() { return RGu8(0, 0); }
-template<> RGf16     Black() { return RGf16(0.0f, 0.0f); }
-template<> RGf32     Black() { return RGf32(0.0f, 0.0f); }
-template<> RGBu8     Black() { return RGBu8(0, 0, 0); }
-template<> RGBf16    Black() { return RGBf16(0.0f, 0.0f, 0.0f); }
-template<> RGBf32    Black() { return RGBf32(0.0f, 0.0f, 0.0f); }
-template<> RGBAu8    Black() { return RGBAu8(0, 0, 0, 255); }
-template<> RGBAf16   Black() { return RGBAf16(0.0f, 0.0f, 0.0f, 1.0f); }
-template<> RGBAf32   Black() { return RGBAf32(0.0f, 0.0f, 0.0f, 1.0f); }
-
-
-template<class T>
-void CreateVideoData(T *pixels, int width, int height, int frame)
-{
-    const int block_size = 32;
-    for (int iy = 0; iy < height; iy++) {
-        for (int ix = 0; ix < width; ix++) {
-            int ip = iy * width + ix;
-            int yb = iy / block_size;
-            int xb = (ix + iy + frame) / block_size;
-
-            if ((xb) % 2 == 0) {
-                pixels[ip] = White<T>();
-            }
-            else {
-                pixels[ip] = Black<T>();
-            }
-        }
-    }
-}
-
-template void CreateVideoData<   Ru8 >(Ru8 *pixels, int width, int height, int frame);
-template void CreateVideoData<   Rf16>(Rf16 *pixels, int width, int height, int frame);
-template void CreateVideoData<   Rf32>(Rf32 *pixels, int width, int height, int frame);
-template void CreateVideoData<  RGu8 >(RGu8 *pixels, int width, int height, int frame);
-template void CreateVideoData<  RGf16>(RGf16 *pixels, int width, int height, int frame);
-template void CreateVideoData<  RGf32>(RGf32 *pixels, int width, int height, int frame);
-template void CreateVideoData< RGBu8 >(RGBu8 *pixels, int width, int height, int frame);
-template void CreateVideoData< RGBf16>(RGBf16 *pixels, int width, int height, int frame);
-template void CreateVideoData< RGBf32>(RGBf32 *pixels, int width, int height, int frame);
-template void CreateVideoData<RGBAu8 >(RGBAu8 *pixels, int width, int height, int frame);
-template void CreateVideoData<RGBAf16>(RGBAf16 *pixels, int width, int height, int frame);
-template void CreateVideoData<RGBAf32>(RGBAf32 *pixels, int width, int height, int frame);
-
-
-void CreateAudioData(float *samples, int num_samples, double t, float scale)
-{
-    for (int i = 0; i < num_samples; ++i) {
-        samples[i] = std::sin((float(i + ((double)num_samples * t)) * 5.5f) * (3.14159f / 180.0f)) * scale;
-    }
-}
+#include "pch.h"
+#include "TestCommon.h"
+#ifdef _WIN32
+    #pragma comment(lib, "Half.lib")
+#endif
+
+
+template<class T> T White();
+template<class T> T Black();
+
+template<> Ru8       White() { return Ru8(255); }
+template<> Rf16      White() { return Rf16(1.0f); }
+template<> Rf32      White() { return Rf32(1.0f); }
+template<> RGu8      White() { return RGu8(255, 255); }
+template<> RGf16     White() { return RGf16(1.0f, 1.0f); }
+template<> RGf32     White() { return RGf32(1.0f, 1.0f); }
+template<> RGBu8     White() { return RGBu8(255, 255, 255); }
+template<> RGBf16    White() { return RGBf16(1.0f, 1.0f, 1.0f); }
+template<> RGBf32    White() { return RGBf32(1.0f, 1.0f, 1.0f); }
+template<> RGBAu8    White() { return RGBAu8(255, 255, 255, 255); }
+template<> RGBAf16   White() { return RGBAf16(1.0f, 1.0f, 1.0f, 1.0f); }
+template<> RGBAf32   White() { return RGBAf32(1.0f, 1.0f, 1.0f, 1.0f); }
+template<> Ri16      White() { return Ri16(255); }
+template<> Ri32      White() { return Ri32(255); }
+template<> RGi16     White() { return RGi16(255, 255); }
+template<> RGi32     White() { return RGi32(255, 255); }
+template<> RGBi16    White() { return RGBi16(255, 255, 255); }
+template<> RGBi32    White() { return RGBi32(255, 255, 255); }
+template<> RGBAi16   White() { return RGBAi16(255, 255, 255, 255); }
+template<> RGBAi32   White() { return RGBAi32(255, 255, 255, 255); }
+
+template<> Ru8       Black() { return Ru8(0); }
+template<> Rf16      Black() { return Rf16(0.0f); }
+template<> Rf32      Black() { return Rf32(0.0f); }
+template<> RGu8      Black() { return RGu8(0, 0); }
+template<> RGf16     Black() { return RGf16(0.0f, 0.0f); }
+template<> RGf32     Black() { return RGf32(0.0f, 0.0f); }
+template<> RGBu8     Black() { return RGBu8(0, 0, 0); }
+template<> RGBf16    Black() { return RGBf16(0.0f, 0.0f, 0.0f); }
+template<> RGBf32    Black() { return RGBf32(0.0f, 0.0f, 0.0f); }
+template<> RGBAu8    Black() { return RGBAu8(0, 0, 0, 255); }
+template<> RGBAf16   Black() { return RGBAf16(0.0f, 0.0f, 0.0f, 1.0f); }
+template<> RGBAf32   Black() { return RGBAf32(0.0f, 0.0f, 0.0f, 1.0f); }
+template<> Ri16      Black() { return Ri16(0); }
+template<> Ri32      Black() { return Ri32(0); }
+template<> RGi16     Black() { return RGi16(0, 0); }
+template<> RGi32     Black() { return RGi32(0, 0); }
+template<> RGBi16    Black() { return RGBi16(0, 0, 0); }
+template<> RGBi32    Black() { return RGBi32(0, 0, 0); }
+template<> RGBAi16   Black() { return RGBAi16(0, 0, 0, 255); }
+template<> RGBAi32   Black() { return RGBAi32(0, 0, 0, 255); }
+
+
+template<class T>
+void CreateVideoData(T *pixels, int width, int height, int frame)
+{
+    const int block_size = 32;
+    for (int iy = 0; iy < height; iy++) {
+        for (int ix = 0; ix < width; ix++) {
+            int ip = iy * width + ix;
+            int yb = iy / block_size;
+            int xb = (ix + iy + frame) / block_size;
+
+            if ((xb) % 2 == 0) {
+                pixels[ip] = White<T>();
+            }
+            else {
+                pixels[ip] = Black<T>();
+            }
+        }
+    }
+}
+
+template void CreateVideoData<   Ru8 >(Ru8 *pixels, int width, int height, int frame);
+template void CreateVideoData<   Rf16>(Rf16 *pixels, int width, int height, int frame);
+template void CreateVideoData<   Rf32>(Rf32 *pixels, int width, int height, int frame);
+template void CreateVideoData<  RGu8 >(RGu8 *pixels, int width, int height, int frame);
+template void CreateVideoData<  RGf16>(RGf16 *pixels, int width, int height, int frame);
+template void CreateVideoData<  RGf32>(RGf32 *pixels, int width, int height, int frame);
+template void CreateVideoData< RGBu8 >(RGBu8 *pixels, int width, int height, int frame);
+template void CreateVideoData< RGBf16>(RGBf16 *pixels, int width, int height, int frame);
+template void CreateVideoData< RGBf32>(RGBf32 *pixels, int width, int height, int frame);
+template void CreateVideoData<RGBAu8 >(RGBAu8 *pixels, int width, int height, int frame);
+template void CreateVideoData<RGBAf16>(RGBAf16 *pixels, int width, int height, int frame);
+template void CreateVideoData<RGBAf32>(RGBAf32 *pixels, int width, int height, int frame);
+template void CreateVideoData<   Ri16>(Ri16 *pixels, int width, int height, int frame);
+template void CreateVideoData<   Ri32>(Ri32 *pixels, int width, int height, int frame);
+template void CreateVideoData<  RGi16>(RGi16 *pixels, int width, int height, int frame);
+template void CreateVideoData<  RGi32>(RGi32 *pixels, int width, int height, int frame);
+template void CreateVideoData< RGBi16>(RGBi16 *pixels, int width, int height, int frame);
+template void CreateVideoData< RGBi32>(RGBi32 *pixels, int width, int height, int frame);
+template void CreateVideoData<RGBAi16>(RGBAi16 *pixels, int width, int height, int frame);
+template void CreateVideoData<RGBAi32>(RGBAi32 *pixels, int width, int height, int frame);
+
+
+void CreateAudioData(float *samples, int num_samples, double t, float scale)
+{
+    for (int i = 0; i < num_samples; ++i) {
+        samples[i] = std::sin((float(i + ((double)num_samples * t)) * 5.5f) * (3.14159f / 180.0f)) * scale;
+    }
+}
+
+static std::atomic_int g_test_failures(0);
+
+void AddTestFailure()
+{
+    ++g_test_failures;
+}
+
+int GetTestFailures()
+{
+    return g_test_failures;
+}
+
+void PrintContextStats(const void *ctx)
+{
+    fcStats stats;
+    if (!fcGetContextStats(ctx, &stats)) { return; }
+
+    for (int i = 0; i < fcStatsStage_Count; ++i) {
+        const auto& s = stats.stages[i];
+        if (s.count == 0) { continue; }
+        printf("  %-12s %6llu samples, p50 %.3lfms, p99 %.3lfms, max %.3lfms\n",
+            fcGetStatsStageName((fcStatsStage)i), (unsigned long long)s.count, s.p50_ms, s.p99_ms, s.max_ms);
+    }
+    printf("  queue depth max: video %d, audio %d. buffer waits: %llu (%.1lfms). written: %llu bytes\n",
+        stats.video_queue_depth_max, stats.audio_queue_depth_max,
+        (unsigned long long)stats.buffer_waits, stats.buffer_wait_ms, (unsigned long long)stats.bytes_written);
+}
+
+bool CheckContextStats(const void *ctx)
+{
+    // frames are dequeued when their encode task finishes. give the tasks in flight time to drain.
+    fcStats stats;
+    fcTime begin = fcGetTime();
+    for (;;) {
+        if (!fcGetContextStats(ctx, &stats)) {
+            printf("  stats: context not found: mismatch\n");
+            return false;
+        }
+        if ((stats.video_queue_depth == 0 && stats.audio_queue_depth == 0) || fcGetTime() - begin > 10.0) { break; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    bool ok =
+        stats.stages[fcStatsStage_Encode].count > 0 &&
+        stats.stages[fcStatsStage_Mux].count > 0 &&
+        stats.bytes_written > 0 &&
+        stats.video_queue_depth == 0 &&
+        stats.audio_queue_depth == 0;
+    printf("  stats: encode %llu, mux %llu, written %llu bytes, queue depth video %d audio %d: %s\n",
+        (unsigned long long)stats.stages[fcStatsStage_Encode].count,
+        (unsigned long long)stats.stages[fcStatsStage_Mux].count,
+        (unsigned long long)stats.bytes_written,
+        stats.video_queue_depth, stats.audio_queue_depth,
+        ok ? "ok" : "mismatch");
+    return ok;
+}
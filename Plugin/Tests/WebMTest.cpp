@@ -1,121 +1,304 @@
-#include "pch.h"
-#include "TestCommon.h"
-
-
-// custom stream functions (just a wrapper of FILE)
-static size_t tellp(void *f) { return ftell((FILE*)f); }
-static void   seekp(void *f, size_t pos) { fseek((FILE*)f, (long)pos, SEEK_SET); }
-static size_t write(void *f, const void *data, size_t len) { return fwrite(data, 1, len, (FILE*)f); }
-
-void WebMTest(fcWebMVideoEncoder ve, fcWebMAudioEncoder ae)
-{
-    const int DurationInSeconds = 10;
-    const int FrameRate = 60;
-    const int Width = 320;
-    const int Height = 240;
-    const int SamplingRate = 48000;
-
-    fcWebMConfig conf;
-    //conf.video = false;
-    conf.video_encoder = ve;
-    conf.video_width = Width;
-    conf.video_height = Height;
-    //conf.video_bitrate_mode = fcVBR;
-    conf.video_target_bitrate = 256 * 1000;
-    conf.audio_encoder = ae;
-    conf.audio_sample_rate = SamplingRate;
-    conf.audio_num_channels = 1;
-    conf.audio_target_bitrate = 64 * 1000;
-
-    const char *video_encoder_name = nullptr;
-    const char *audio_encoder_name = nullptr;
-    switch (ve) {
-    case fcWebMVideoEncoder::VP8: video_encoder_name = "VP8"; break;
-    case fcWebMVideoEncoder::VP9: video_encoder_name = "VP9"; break;
-    }
-    switch (ae) {
-    case fcWebMAudioEncoder::Vorbis: audio_encoder_name = "Vorbis"; break;
-    case fcWebMAudioEncoder::Opus: audio_encoder_name = "Opus"; break;
-    }
-
-    char filename_f[256];
-    char filename_c[256];
-    char filename_m[256];
-    sprintf(filename_f, "file_stream (%s %s).webm", video_encoder_name, audio_encoder_name);
-    sprintf(filename_c, "custom_stream (%s %s).webm", video_encoder_name, audio_encoder_name);
-    sprintf(filename_m, "memory_stream (%s %s).webm", video_encoder_name, audio_encoder_name);
-
-
-    // create output streams
-    fcStream* fstream = fcCreateFileStream(filename_f);
-    fcStream* mstream = fcCreateMemoryStream();
-    FILE *ofile = fopen(filename_c, "wb");
-    fcStream* cstream = fcCreateCustomStream(ofile, &tellp, &seekp, &write);
-
-    // create mp4 context and add output streams
-    fcIWebMContext *ctx = fcWebMCreateContext(&conf);
-    fcWebMAddOutputStream(ctx, fstream);
-    fcWebMAddOutputStream(ctx, mstream);
-    fcWebMAddOutputStream(ctx, cstream);
-
-    // create movie data
-    {
-        // add video frames
-        std::thread video_thread = std::thread([&]() {
-            RawVector<RGBAu8> video_frame(Width * Height);
-            fcTime t = 0;
-            for (int i = 0; i < DurationInSeconds * FrameRate; ++i) {
-                CreateVideoData(video_frame.data(), Width, Height, i);
-                fcWebMAddVideoFramePixels(ctx, video_frame.data(), fcPixelFormat_RGBAu8, t);
-                t += 1.0 / FrameRate;
-            }
-        });
-
-        // add audio frames
-        std::thread audio_thread = std::thread([&]() {
-            RawVector<float> audio_sample(SamplingRate);
-            fcTime t = 0;
-            while (t < (double)DurationInSeconds) {
-                CreateAudioData(audio_sample.data(), (int)audio_sample.size(), t, 1.0f);
-                fcWebMAddAudioFrame(ctx, audio_sample.data(), (int)audio_sample.size(), t);
-                t += 1.0;
-            }
-        });
-
-        // wait
-        video_thread.join();
-        audio_thread.join();
-    }
-
-    // destroy mp4 context
-    fcWebMDestroyContext(ctx);
-
-    // destroy output streams
-    {
-        fcBufferData bd = fcStreamGetBufferData(mstream);
-        std::fstream of(filename_m, std::ios::binary | std::ios::out);
-        of.write((char*)bd.data, bd.size);
-    }
-    fcDestroyStream(fstream);
-    fcDestroyStream(mstream);
-    fcDestroyStream(cstream);
-    fclose(ofile);
-}
-
-
-void WebMTest()
-{
-    if (!fcWebMIsSupported()) {
-        printf("WebMTest: webm is not supported\n");
-        return;
-    }
-
-    printf("WebMTest (VP8 & Vorbis) begin\n");
-    WebMTest(fcWebMVideoEncoder::VP8, fcWebMAudioEncoder::Vorbis);
-    printf("WebMTest (VP8 & Vorbis) end\n");
-
-    printf("WebMTest (VP9 & Opus) begin\n");
-    WebMTest(fcWebMVideoEncoder::VP9, fcWebMAudioEncoder::Opus);
-    printf("WebMTest (VP9 & Opus) end\n");
-}
-
+#include "pch.h"
+#include "TestCommon.h"
+
+
+// custom stream functions (just a wrapper of FILE)
+static size_t tellp(void *f) { return ftell((FILE*)f); }
+static void   seekp(void *f, size_t pos) { fseek((FILE*)f, (long)pos, SEEK_SET); }
+static size_t write(void *f, const void *data, size_t len) { return fwrite(data, 1, len, (FILE*)f); }
+
+void WebMTest(fcWebMVideoEncoder ve, fcWebMAudioEncoder ae)
+{
+    const int DurationInSeconds = 10;
+    const int FrameRate = 60;
+    const int Width = 320;
+    const int Height = 240;
+    const int SamplingRate = 48000;
+
+    fcWebMConfig conf;
+    //conf.video = false;
+    conf.video_encoder = ve;
+    conf.video_width = Width;
+    conf.video_height = Height;
+    //conf.video_bitrate_mode = fcVBR;
+    conf.video_target_bitrate = 256 * 1000;
+    conf.audio_encoder = ae;
+    conf.audio_sample_rate = SamplingRate;
+    conf.audio_num_channels = 1;
+    conf.audio_target_bitrate = 64 * 1000;
+    conf.live = false; // all the outputs below can seek. get Cues
+    conf.cue_interval = 1.0; // a seek point every second
+
+    const char *video_encoder_name = nullptr;
+    const char *audio_encoder_name = nullptr;
+    switch (ve) {
+    case fcWebMVideoEncoder::VP8: video_encoder_name = "VP8"; break;
+    case fcWebMVideoEncoder::VP9: video_encoder_name = "VP9"; break;
+    }
+    switch (ae) {
+    case fcWebMAudioEncoder::Vorbis: audio_encoder_name = "Vorbis"; break;
+    case fcWebMAudioEncoder::Opus: audio_encoder_name = "Opus"; break;
+    }
+
+    char filename_f[256];
+    char filename_c[256];
+    char filename_m[256];
+    sprintf(filename_f, "file_stream (%s %s).webm", video_encoder_name, audio_encoder_name);
+    sprintf(filename_c, "custom_stream (%s %s).webm", video_encoder_name, audio_encoder_name);
+    sprintf(filename_m, "memory_stream (%s %s).webm", video_encoder_name, audio_encoder_name);
+
+
+    // create output streams
+    fcStream* fstream = fcCreateFileStream(filename_f);
+    fcStream* mstream = fcCreateMemoryStream();
+    FILE *ofile = fopen(filename_c, "wb");
+    fcStream* cstream = fcCreateCustomStream(ofile, &tellp, &seekp, &write);
+
+    // create mp4 context and add output streams
+    fcIWebMContext *ctx = fcWebMCreateContext(&conf);
+    fcWebMAddOutputStream(ctx, fstream);
+    fcWebMAddOutputStream(ctx, mstream);
+    fcWebMAddOutputStream(ctx, cstream);
+
+    // create movie data
+    {
+        // add video frames
+        std::thread video_thread = std::thread([&]() {
+            RawVector<RGBAu8> video_frame(Width * Height);
+            fcTime t = 0;
+            for (int i = 0; i < DurationInSeconds * FrameRate; ++i) {
+                CreateVideoData(video_frame.data(), Width, Height, i);
+                fcWebMAddVideoFramePixels(ctx, video_frame.data(), fcPixelFormat_RGBAu8, t);
+                t += 1.0 / FrameRate;
+            }
+        });
+
+        // add audio frames
+        std::thread audio_thread = std::thread([&]() {
+            RawVector<float> audio_sample(SamplingRate);
+            fcTime t = 0;
+            while (t < (double)DurationInSeconds) {
+                CreateAudioData(audio_sample.data(), (int)audio_sample.size(), t, 1.0f);
+                fcWebMAddAudioFrame(ctx, audio_sample.data(), (int)audio_sample.size(), t);
+                t += 1.0;
+            }
+        });
+
+        // wait
+        video_thread.join();
+        audio_thread.join();
+    }
+
+    PrintContextStats(ctx);
+    CheckContextStats(ctx);
+
+    // destroy mp4 context
+    fcWebMDestroyContext(ctx);
+
+    // destroy output streams
+    {
+        fcBufferData bd = fcStreamGetBufferData(mstream);
+        std::fstream of(filename_m, std::ios::binary | std::ios::out);
+        of.write((char*)bd.data, bd.size);
+    }
+    fcDestroyStream(fstream);
+    fcDestroyStream(mstream);
+    fcDestroyStream(cstream);
+    fclose(ofile);
+}
+
+
+// minimal EBML walker for the tests: collects SimpleBlocks in file order. Segment and Cluster are entered, everything else
+// is skipped. returns false if data is truncated or malformed.
+struct WebMBlock
+{
+    int track;
+    int64_t time; // in timecode scale units (1ms by default)
+    bool keyframe;
+};
+
+static bool ReadEBMLID(const u8 *&p, const u8 *end, uint32_t& id)
+{
+    if (p >= end || *p == 0) { return false; }
+    int len = 1;
+    while (len <= 4 && (*p & (0x80 >> (len - 1))) == 0) { ++len; }
+    if (len > 4 || p + len > end) { return false; }
+    id = 0;
+    for (int i = 0; i < len; ++i) { id = (id << 8) | p[i]; }
+    p += len;
+    return true;
+}
+
+static bool ReadEBMLSize(const u8 *&p, const u8 *end, uint64_t& size, bool& unknown)
+{
+    if (p >= end || *p == 0) { return false; }
+    int len = 1;
+    while ((*p & (0x80 >> (len - 1))) == 0) { ++len; }
+    if (p + len > end) { return false; }
+    size = *p & (0xFF >> len);
+    unknown = size == (0xFFu >> len);
+    for (int i = 1; i < len; ++i) {
+        size = (size << 8) | p[i];
+        unknown = unknown && p[i] == 0xFF;
+    }
+    p += len;
+    return true;
+}
+
+static bool ParseWebMBlocks(const void *data, size_t data_size, std::vector<WebMBlock>& dst)
+{
+    const uint32_t ID_Segment = 0x18538067, ID_Cluster = 0x1F43B675, ID_Timecode = 0xE7, ID_SimpleBlock = 0xA3;
+
+    const u8 *p = (const u8*)data;
+    const u8 *end = p + data_size;
+    int64_t cluster_time = 0;
+    while (p < end) {
+        uint32_t id;
+        uint64_t size;
+        bool unknown;
+        if (!ReadEBMLID(p, end, id) || !ReadEBMLSize(p, end, size, unknown)) { return false; }
+        if (id == ID_Segment || id == ID_Cluster) { continue; } // children follow
+        if (unknown || size > uint64_t(end - p)) { return false; }
+
+        if (id == ID_Timecode) {
+            cluster_time = 0;
+            for (uint64_t i = 0; i < size; ++i) { cluster_time = (cluster_time << 8) | p[i]; }
+        }
+        else if (id == ID_SimpleBlock) {
+            const u8 *b = p, *bend = p + size;
+            uint64_t track;
+            if (!ReadEBMLSize(b, bend, track, unknown) || bend - b < 3) { return false; }
+            int16_t rel = int16_t((b[0] << 8) | b[1]);
+            dst.push_back({ (int)track, cluster_time + rel, (b[2] & 0x80) != 0 });
+        }
+        p += size;
+    }
+    return true;
+}
+
+// parallel segments: every segment must start with a keyframe and the frames must come out in input order.
+// max_buffered_frames below what the segments can hold makes the caller wait for the encoders.
+static void WebMSegmentTest(fcWebMVideoEncoder ve, const char *name, int max_buffered_frames = 0)
+{
+    const int FrameRate = 30;
+    const int Width = 320;
+    const int Height = 240;
+    const int Segments = 4;
+    const int SegmentFrames = 10;
+    const int NumFrames = Segments * SegmentFrames * 2;
+
+    fcWebMConfig conf;
+    conf.video_encoder = ve;
+    conf.video_width = Width;
+    conf.video_height = Height;
+    conf.video_target_framerate = FrameRate;
+    conf.video_target_bitrate = 256 * 1000;
+    conf.audio = false;
+    conf.video_parallel_segments = Segments;
+    conf.video_segment_frames = SegmentFrames;
+    conf.video_max_buffered_frames = max_buffered_frames;
+
+    fcStream* mstream = fcCreateMemoryStream();
+    fcIWebMContext *ctx = fcWebMCreateContext(&conf);
+    fcWebMAddOutputStream(ctx, mstream);
+    {
+        RawVector<RGBAu8> video_frame(Width * Height);
+        for (int i = 0; i < NumFrames; ++i) {
+            CreateVideoData(video_frame.data(), Width, Height, i);
+            fcWebMAddVideoFramePixels(ctx, video_frame.data(), fcPixelFormat_RGBAu8, (double)i / FrameRate);
+        }
+    }
+    fcWebMDestroyContext(ctx);
+
+    std::vector<WebMBlock> blocks;
+    fcBufferData bd = fcStreamGetBufferData(mstream);
+    bool parsed = ParseWebMBlocks(bd.data, bd.size, blocks);
+    fcDestroyStream(mstream);
+
+    bool ordered = parsed && (int)blocks.size() == NumFrames;
+    bool keyframes = ordered;
+    for (size_t i = 0; ordered && i < blocks.size(); ++i) {
+        int64_t expected = blocks[0].time + int64_t(i) * 1000 / FrameRate;
+        ordered = std::abs(blocks[i].time - expected) <= 1;
+        if (i % SegmentFrames == 0) {
+            keyframes = keyframes && blocks[i].keyframe;
+        }
+    }
+    printf("  parallel segments (%s, %d buffered): %d / %d frames, order %s, keyframes %s\n", name, max_buffered_frames,
+        (int)blocks.size(), NumFrames, ordered ? "ok" : "mismatch", keyframes ? "ok" : "mismatch");
+    if (!ordered || !keyframes) { AddTestFailure(); }
+}
+
+// fcWebMDestroyContextAsync() must return before the encoder is drained. a slow preset with look-ahead leaves
+// LagFrames frames in the encoder, so the drain takes far longer than the call.
+static void WebMAsyncDestroyTest()
+{
+    const int FrameRate = 30;
+    const int Width = 640;
+    const int Height = 480;
+    const int LagFrames = 25;
+
+    fcWebMConfig conf;
+    conf.video_encoder = fcWebMVideoEncoder::VP8;
+    conf.video_width = Width;
+    conf.video_height = Height;
+    conf.video_target_framerate = FrameRate;
+    conf.audio = false;
+    conf.video_deadline = fcVPXDeadline::Good;
+    conf.video_cpu_used = 0;
+    conf.video_lag_in_frames = LagFrames;
+
+    fcStream* mstream = fcCreateMemoryStream();
+    fcIWebMContext *ctx = fcWebMCreateContext(&conf);
+    fcWebMAddOutputStream(ctx, mstream);
+    {
+        RawVector<RGBAu8> video_frame(Width * Height);
+        for (int i = 0; i < LagFrames; ++i) {
+            CreateVideoData(video_frame.data(), Width, Height, i);
+            fcWebMAddVideoFramePixels(ctx, video_frame.data(), fcPixelFormat_RGBAu8, (double)i / FrameRate);
+        }
+    }
+
+    fcTime begin = fcGetTime();
+    fcAsync *async = fcWebMDestroyContextAsync(ctx);
+    fcTime returned = fcGetTime() - begin;
+    bool pending = !fcAsyncIsFinished(async);
+    fcAsyncWait(async);
+    fcTime finished = fcGetTime() - begin;
+    fcAsyncRelease(async);
+    size_t written = fcStreamGetBufferData(mstream).size;
+    fcDestroyStream(mstream);
+
+    bool ok = pending && returned * 2.0 < finished && written > 0;
+    printf("  async destroy: returned in %.1lfms, drained in %.1lfms: %s\n", returned * 1000.0, finished * 1000.0,
+        ok ? "ok" : "mismatch");
+    if (!ok) { AddTestFailure(); }
+}
+
+
+void WebMTest()
+{
+    if (!fcWebMIsSupported()) {
+        printf("WebMTest: webm is not supported\n");
+        return;
+    }
+
+    printf("WebMTest (VP8 & Vorbis) begin\n");
+    WebMTest(fcWebMVideoEncoder::VP8, fcWebMAudioEncoder::Vorbis);
+    printf("WebMTest (VP8 & Vorbis) end\n");
+
+    printf("WebMTest (VP9 & Opus) begin\n");
+    WebMTest(fcWebMVideoEncoder::VP9, fcWebMAudioEncoder::Opus);
+    printf("WebMTest (VP9 & Opus) end\n");
+
+    printf("WebMTest (parallel segments) begin\n");
+    WebMSegmentTest(fcWebMVideoEncoder::VP8, "VP8");
+    WebMSegmentTest(fcWebMVideoEncoder::VP9, "VP9");
+    WebMSegmentTest(fcWebMVideoEncoder::VP8, "VP8", 3);
+    printf("WebMTest (parallel segments) end\n");
+
+    printf("WebMTest (async destroy) begin\n");
+    WebMAsyncDestroyTest();
+    printf("WebMTest (async destroy) end\n");
+}
+
@@ -1,21 +1,21 @@
-﻿#ifdef _MSC_VER
-    #pragma warning(disable: 4190)
-    #define _CRT_SECURE_NO_WARNINGS
-#endif
-
-#include <algorithm>
-#include <string>
-#include <vector>
-#include <deque>
-#include <list>
-#include <map>
-#include <memory>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
-#include <future>
-#include <functional>
-#include <fstream>
-#include <sstream>
-#include <cstring>
+﻿#ifdef _MSC_VER
+    #pragma warning(disable: 4190)
+    #define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <cstring>
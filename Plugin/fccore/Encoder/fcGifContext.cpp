@@ -1,231 +1,268 @@
-﻿#include "pch.h"
-#include "fcInternal.h"
-#include "Foundation/fcFoundation.h"
-#include "GraphicsDevice/fcGraphicsDevice.h"
-#include "fcGifContext.h"
-
-#ifdef fcSupportGIF
-#include "jo_gif.i"
-
-typedef jo_gif_frame_t fcGifFrame;
-
-struct fcGifTaskData
-{
-    fcPixelFormat raw_pixel_format = fcPixelFormat_Unknown;
-    Buffer raw_pixels;
-    Buffer rgba8_pixels;
-    fcGifFrame *gif_frame = nullptr;
-    int frame = 0;
-    bool local_palette = true;
-    fcTime timestamp = 0.0;
-};
-
-class fcGifContext : public fcIGifContext
-{
-public:
-    fcGifContext(const fcGifConfig &conf, fcIGraphicsDevice *dev);
-    ~fcGifContext();
-    void release() override;
-
-    void addOutputStream(fcStream *s) override;
-    bool addFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp) override;
-    bool addFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp) override;
-    void forceKeyframe() override;
-
-private:
-    fcGifTaskData&  getTempraryVideoFrame();
-    void            returnTempraryVideoFrame(fcGifTaskData& v);
-
-    void addGifFrame(fcGifTaskData& data);
-    void kickTask(fcGifTaskData& data);
-    bool flush();
-
-private:
-    fcGifConfig m_conf;
-    fcIGraphicsDevice *m_dev = nullptr;
-    std::vector<fcStream*> m_streams;
-    std::vector<fcGifTaskData> m_buffers;
-    std::vector<fcGifTaskData*> m_buffers_unused;
-    std::list<fcGifFrame> m_gif_frames;
-    jo_gif_t m_gif;
-    TaskGroup m_tasks;
-    std::mutex m_mutex;
-    int m_frame = 0;
-    bool m_force_keyframe = false;
-};
-
-
-fcGifContext::fcGifContext(const fcGifConfig &conf, fcIGraphicsDevice *dev)
-    : m_conf(conf)
-    , m_dev(dev)
-{
-    m_gif = jo_gif_start(m_conf.width, m_conf.height, 0, m_conf.num_colors);
-
-    // allocate working buffers
-    if (m_conf.max_active_tasks <= 0) {
-        m_conf.max_active_tasks = std::thread::hardware_concurrency();
-    }
-    m_buffers.resize(m_conf.max_active_tasks);
-    for (auto& buf : m_buffers)
-    {
-        buf.rgba8_pixels.resize(m_conf.width * m_conf.height * fcGetPixelSize(fcPixelFormat_RGBAu8));
-        m_buffers_unused.push_back(&buf);
-    }
-}
-
-fcGifContext::~fcGifContext()
-{
-    m_tasks.wait();
-    flush();
-
-    jo_gif_end(&m_gif);
-}
-
-
-void fcGifContext::release()
-{
-    delete this;
-}
-
-void fcGifContext::addOutputStream(fcStream *os)
-{
-    if (!os) { return; }
-    m_streams.push_back(os);
-}
-
-fcGifTaskData& fcGifContext::getTempraryVideoFrame()
-{
-    fcGifTaskData *ret = nullptr;
-
-    // wait if all temporaries are in use
-    for (;;) {
-        {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            if (!m_buffers_unused.empty()) {
-                ret = m_buffers_unused.back();
-                m_buffers_unused.pop_back();
-                break;
-            }
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
-
-    return *ret;
-}
-
-void fcGifContext::returnTempraryVideoFrame(fcGifTaskData& v)
-{
-    std::unique_lock<std::mutex> lock(m_mutex);
-    m_buffers_unused.push_back(&v);
-}
-
-void fcGifContext::addGifFrame(fcGifTaskData& data)
-{
-    unsigned char *src = nullptr;
-    if (data.raw_pixel_format == fcPixelFormat_RGBAu8) {
-        src = (unsigned char*)&data.raw_pixels[0];
-    }
-    else {
-        // convert pixel format
-        size_t npixels = data.raw_pixels.size() / fcGetPixelSize(data.raw_pixel_format);
-        fcConvertPixelFormat(&data.rgba8_pixels[0], fcPixelFormat_RGBAu8, &data.raw_pixels[0], data.raw_pixel_format, npixels);
-        src = (unsigned char*)&data.rgba8_pixels[0];
-    }
-
-    jo_gif_frame(&m_gif, data.gif_frame, src, data.frame, data.local_palette);
-    returnTempraryVideoFrame(data);
-}
-
-void fcGifContext::kickTask(fcGifTaskData& data)
-{
-    m_gif_frames.push_back(fcGifFrame());
-    data.gif_frame = &m_gif_frames.back();
-    data.gif_frame->timestamp = data.timestamp;
-    data.frame = m_frame++;
-
-    if (data.frame == 0 || (m_conf.keyframe_interval > 0 && data.frame % m_conf.keyframe_interval == 0) || m_force_keyframe)
-    {
-        data.local_palette = true;
-        m_force_keyframe = false;
-    }
-    if (data.local_palette) {
-        // updating palette must be in sync
-        m_tasks.wait();
-        addGifFrame(data);
-    }
-    else
-    {
-        m_tasks.run([this, &data]() {
-            addGifFrame(data);
-        });
-    }
-}
-
-bool fcGifContext::addFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp)
-{
-    if (m_dev == nullptr) {
-        fcDebugLog("fcGifContext::addFrameTexture(): gfx device is null.");
-        return false;
-    }
-    fcGifTaskData& data = getTempraryVideoFrame();
-    data.timestamp = timestamp >= 0.0 ? timestamp : GetCurrentTimeInSeconds();
-    data.raw_pixels.resize(m_conf.width * m_conf.height * fcGetPixelSize(fmt));
-    data.raw_pixel_format = fmt;
-    if (!m_dev->readTexture(&data.raw_pixels[0], data.raw_pixels.size(), tex, m_conf.width, m_conf.height, fmt))
-    {
-        return false;
-    }
-
-    kickTask(data);
-    return true;
-}
-
-bool fcGifContext::addFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
-{
-    fcGifTaskData& data = getTempraryVideoFrame();
-    data.timestamp = timestamp >= 0.0 ? timestamp : GetCurrentTimeInSeconds();
-    data.raw_pixel_format = fmt;
-    data.raw_pixels.assign((char*)pixels, m_conf.width * m_conf.height * fcGetPixelSize(fmt));
-
-    kickTask(data);
-    return true;
-}
-
-void fcGifContext::forceKeyframe()
-{
-    m_force_keyframe = true;
-}
-
-bool fcGifContext::flush()
-{
-    m_tasks.wait();
-
-    int frame = 0;
-    for(auto os : m_streams) jo_gif_write_header(*os, &m_gif);
-    for (auto i = m_gif_frames.begin(); i != m_gif_frames.end(); ++i) {
-        auto next = i; ++next;
-        int duration = 1; // unit: centi-second
-        if (next != m_gif_frames.end()) {
-            duration = int((next->timestamp - i->timestamp) * 100.0); // seconds to centi-seconds
-        }
-        for (auto os : m_streams) jo_gif_write_frame(*os, &m_gif, &(*i), nullptr, frame++, duration);
-    }
-    for (auto os : m_streams) jo_gif_write_footer(*os, &m_gif);
-
-    return true;
-}
-
-
-fcIGifContext* fcGifCreateContextImpl(const fcGifConfig &conf, fcIGraphicsDevice *dev)
-{
-    return new fcGifContext(conf, dev);
-}
-
-#else // fcSupportGIF
-
-fcIGifContext* fcGifCreateContextImpl(const fcGifConfig &conf, fcIGraphicsDevice *dev)
-{
-    return nullptr;
-}
-
-#endif // fcSupportGIF
+﻿#include "pch.h"
+#include "fcInternal.h"
+#include "Foundation/fcFoundation.h"
+#include "GraphicsDevice/fcGraphicsDevice.h"
+#include "fcGifContext.h"
+
+#ifdef fcSupportGIF
+#include "jo_gif.i"
+
+typedef jo_gif_frame_t fcGifFrame;
+
+struct fcGifTaskData
+{
+    fcPixelFormat raw_pixel_format = fcPixelFormat_Unknown;
+    PooledBuffer raw_pixels;
+    PooledBuffer rgba8_pixels;
+    fcGifFrame *gif_frame = nullptr;
+    int frame = 0;
+    bool local_palette = true;
+    fcTime timestamp = 0.0;
+};
+
+class fcGifContext : public fcIGifContext
+{
+public:
+    fcGifContext(const fcGifConfig &conf, fcIGraphicsDevice *dev);
+    ~fcGifContext();
+    void release() override;
+
+    void addOutputStream(fcStream *s) override;
+    bool addFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp) override;
+    bool addFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp) override;
+    void forceKeyframe() override;
+    void setPixelTransform(const fcPixelTransform *t) override;
+
+private:
+    fcGifTaskData&  getTempraryVideoFrame();
+    void            returnTempraryVideoFrame(fcGifTaskData& v);
+
+    void addGifFrame(fcGifTaskData& data);
+    void kickTask(fcGifTaskData& data);
+    bool flush();
+
+private:
+    fcGifConfig m_conf;
+    fcIGraphicsDevice *m_dev = nullptr;
+    PixelTransformStage m_pixel_transform;
+    StatsCollector m_stats;
+    std::vector<std::unique_ptr<StatsStream>> m_streams;
+    std::vector<fcGifTaskData> m_buffers;
+    std::vector<fcGifTaskData*> m_buffers_unused;
+    std::list<fcGifFrame> m_gif_frames;
+    jo_gif_t m_gif;
+    TaskGroup m_tasks;
+    std::mutex m_mutex;
+    int m_frame = 0;
+    bool m_force_keyframe = false;
+};
+
+
+fcGifContext::fcGifContext(const fcGifConfig &conf, fcIGraphicsDevice *dev)
+    : m_conf(conf)
+    , m_dev(dev)
+    , m_stats(static_cast<fcIGifContext*>(this))
+{
+    m_gif = jo_gif_start(m_conf.width, m_conf.height, 0, m_conf.num_colors);
+
+    // allocate working buffers
+    if (m_conf.max_active_tasks <= 0) {
+        m_conf.max_active_tasks = std::thread::hardware_concurrency();
+    }
+    m_buffers.resize(m_conf.max_active_tasks);
+    for (auto& buf : m_buffers)
+    {
+        buf.rgba8_pixels.resize(m_conf.width * m_conf.height * fcGetPixelSize(fcPixelFormat_RGBAu8));
+        m_buffers_unused.push_back(&buf);
+    }
+}
+
+fcGifContext::~fcGifContext()
+{
+    m_tasks.wait();
+    flush();
+
+    jo_gif_end(&m_gif);
+}
+
+
+void fcGifContext::release()
+{
+    delete this;
+}
+
+void fcGifContext::addOutputStream(fcStream *os)
+{
+    if (!os) { return; }
+    m_streams.emplace_back(new StatsStream(*os, m_stats));
+}
+
+fcGifTaskData& fcGifContext::getTempraryVideoFrame()
+{
+    fcGifTaskData *ret = nullptr;
+
+    // wait if all temporaries are in use
+    double wait_begin = 0.0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_buffers_unused.empty()) {
+                ret = m_buffers_unused.back();
+                m_buffers_unused.pop_back();
+                break;
+            }
+        }
+        if (wait_begin == 0.0) { wait_begin = GetCurrentTimeInSeconds(); }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (wait_begin != 0.0) {
+        m_stats.addBufferWait(GetCurrentTimeInSeconds() - wait_begin);
+    }
+
+    return *ret;
+}
+
+void fcGifContext::returnTempraryVideoFrame(fcGifTaskData& v)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_buffers_unused.push_back(&v);
+}
+
+void fcGifContext::addGifFrame(fcGifTaskData& data)
+{
+    unsigned char *src = nullptr;
+    if (data.raw_pixel_format == fcPixelFormat_RGBAu8) {
+        src = (unsigned char*)&data.raw_pixels[0];
+    }
+    else {
+        // convert pixel format
+        StatsScope scope(m_stats, fcStatsStage_Convert);
+        size_t npixels = data.raw_pixels.size() / fcGetPixelSize(data.raw_pixel_format);
+        fcConvertPixelFormat(&data.rgba8_pixels[0], fcPixelFormat_RGBAu8, &data.raw_pixels[0], data.raw_pixel_format, npixels);
+        src = (unsigned char*)&data.rgba8_pixels[0];
+    }
+
+    {
+        StatsScope scope(m_stats, fcStatsStage_Encode);
+        jo_gif_frame(&m_gif, data.gif_frame, src, data.frame, data.local_palette);
+    }
+    returnTempraryVideoFrame(data);
+    m_stats.dequeue(StatsCollector::Queue::Video);
+}
+
+void fcGifContext::kickTask(fcGifTaskData& data)
+{
+    m_gif_frames.push_back(fcGifFrame());
+    data.gif_frame = &m_gif_frames.back();
+    data.gif_frame->timestamp = data.timestamp;
+    data.frame = m_frame++;
+    m_stats.enqueue(StatsCollector::Queue::Video);
+
+    if (data.frame == 0 || (m_conf.keyframe_interval > 0 && data.frame % m_conf.keyframe_interval == 0) || m_force_keyframe)
+    {
+        data.local_palette = true;
+        m_force_keyframe = false;
+    }
+    if (data.local_palette) {
+        // updating palette must be in sync
+        m_tasks.wait();
+        addGifFrame(data);
+    }
+    else
+    {
+        m_tasks.run([this, &data]() {
+            addGifFrame(data);
+        });
+    }
+}
+
+bool fcGifContext::addFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp)
+{
+    if (m_dev == nullptr) {
+        fcDebugLog("fcGifContext::addFrameTexture(): gfx device is null.");
+        return false;
+    }
+    fcGifTaskData& data = getTempraryVideoFrame();
+    data.timestamp = timestamp >= 0.0 ? timestamp : GetCurrentTimeInSeconds();
+    data.raw_pixels.resize(m_conf.width * m_conf.height * fcGetPixelSize(fmt));
+    data.raw_pixel_format = fmt;
+    bool read;
+    {
+        StatsScope scope(m_stats, fcStatsStage_Readback);
+        read = m_dev->readTexture(&data.raw_pixels[0], data.raw_pixels.size(), tex, m_conf.width, m_conf.height, fmt);
+    }
+    if (!read)
+    {
+        return false;
+    }
+
+    kickTask(data);
+    return true;
+}
+
+bool fcGifContext::addFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
+{
+    fcGifTaskData& data = getTempraryVideoFrame();
+    data.timestamp = timestamp >= 0.0 ? timestamp : GetCurrentTimeInSeconds();
+    // with a transform, crop / resize and the conversion to RGBAu8 are done together here
+    data.raw_pixel_format = m_pixel_transform.enabled() ? fcPixelFormat_RGBAu8 : fmt;
+    data.raw_pixels.resize(m_conf.width * m_conf.height * fcGetPixelSize(data.raw_pixel_format));
+    bool applied;
+    {
+        StatsScope scope(m_stats, fcStatsStage_Convert);
+        applied = m_pixel_transform.apply(&data.raw_pixels[0], data.raw_pixel_format, pixels, fmt, m_conf.width, m_conf.height);
+    }
+    if (!applied) {
+        returnTempraryVideoFrame(data);
+        return false;
+    }
+
+    kickTask(data);
+    return true;
+}
+
+void fcGifContext::forceKeyframe()
+{
+    m_force_keyframe = true;
+}
+
+void fcGifContext::setPixelTransform(const fcPixelTransform *t)
+{
+    m_pixel_transform.set(t);
+}
+
+bool fcGifContext::flush()
+{
+    m_tasks.wait();
+
+    // frames are encoded as they arrive and the whole file is written here
+    StatsScope scope(m_stats, fcStatsStage_Mux);
+    int frame = 0;
+    for(auto& os : m_streams) jo_gif_write_header(*os, &m_gif);
+    for (auto i = m_gif_frames.begin(); i != m_gif_frames.end(); ++i) {
+        auto next = i; ++next;
+        int duration = 1; // unit: centi-second
+        if (next != m_gif_frames.end()) {
+            duration = int((next->timestamp - i->timestamp) * 100.0); // seconds to centi-seconds
+        }
+        for (auto& os : m_streams) jo_gif_write_frame(*os, &m_gif, &(*i), nullptr, frame++, duration);
+    }
+    for (auto& os : m_streams) jo_gif_write_footer(*os, &m_gif);
+
+    return true;
+}
+
+
+fcIGifContext* fcGifCreateContextImpl(const fcGifConfig &conf, fcIGraphicsDevice *dev)
+{
+    return new fcGifContext(conf, dev);
+}
+
+#else // fcSupportGIF
+
+fcIGifContext* fcGifCreateContextImpl(const fcGifConfig &conf, fcIGraphicsDevice *dev)
+{
+    return nullptr;
+}
+
+#endif // fcSupportGIF
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+// timestamp-ordered interleaving of a video and an audio stream in front of the writers.
+// encoder threads only hand frames over. the writers are called from the queue's own thread, in timestamp order, so they see
+// monotonic timestamps, get audio and video in time-local runs, and the two encoder threads never contend for a writer.
+// a packet is written once the other stream has reached its timestamp or has ended, or once it is 'window' seconds older
+// than the newest packet (so a stalled stream can't hold the other back forever).
+// a video frame is one sample. audio frames carry many packets and are split so that each packet is ordered on its own.
+// VideoFrame: fcVPXFrame / fcH264Frame, AudioFrame: fcVorbisFrame / fcAACFrame.
+template<class VideoFrame, class AudioFrame>
+class fcInterleaveQueue
+{
+public:
+    using EmitVideo = std::function<void(const VideoFrame&)>;
+    using EmitAudio = std::function<void(const AudioFrame&)>;
+
+    // window <= 0: frames are written as soon as they arrive.
+    // has_video / has_audio: false if the stream doesn't exist, so that the other stream never waits for it.
+    fcInterleaveQueue(fcTime window, bool has_video, bool has_audio, const EmitVideo& emit_video, const EmitAudio& emit_audio)
+        : m_window(window)
+        , m_emit_video(emit_video)
+        , m_emit_audio(emit_audio)
+    {
+        m_video.ended = !has_video;
+        m_audio.ended = !has_audio;
+    }
+
+    ~fcInterleaveQueue()
+    {
+        endVideo();
+        endAudio();
+        m_tasks.wait();
+    }
+
+    // thread safe. takes over the content of frame (frame is left empty).
+    void addVideoFrame(VideoFrame& frame, fcTime timestamp)
+    {
+        std::shared_ptr<VideoFrame> f(new VideoFrame(std::move(frame)));
+        m_tasks.run([this, f, timestamp]() {
+            m_video.frames.push_back({ f, timestamp });
+            m_video.last = timestamp;
+            drain();
+        });
+    }
+
+    // thread safe. frame is copied.
+    void addAudioFrame(const AudioFrame& frame)
+    {
+        std::vector<Item<AudioFrame>> packets;
+        size_t pos = 0;
+        for (auto& p : frame.packets) {
+            std::shared_ptr<AudioFrame> f(new AudioFrame());
+            f->data.append(&frame.data[pos], p.size);
+            f->packets.push_back(p);
+            packets.push_back({ f, p.timestamp });
+            pos += p.size;
+        }
+        if (packets.empty()) { return; }
+
+        m_tasks.run([this, packets]() {
+            for (auto& p : packets) {
+                m_audio.frames.push_back(p);
+                m_audio.last = p.timestamp;
+            }
+            drain();
+        });
+    }
+
+    // end of stream. the other stream no longer waits for it.
+    void endVideo()
+    {
+        m_tasks.run([this]() { m_video.ended = true; drain(); });
+    }
+    void endAudio()
+    {
+        m_tasks.run([this]() { m_audio.ended = true; drain(); });
+    }
+
+    // waits until everything handed over so far is processed. frames that still wait for the other stream stay queued.
+    void wait()
+    {
+        m_tasks.wait();
+    }
+
+private:
+    template<class Frame>
+    struct Item
+    {
+        std::shared_ptr<Frame> frame;
+        fcTime timestamp;
+    };
+
+    template<class Frame>
+    struct Stream
+    {
+        std::deque<Item<Frame>> frames;
+        fcTime last = 0.0;
+        bool ended = false;
+
+        // true if nothing of this stream can arrive before t anymore
+        bool passed(fcTime t) const { return ended || !frames.empty() || last >= t; }
+    };
+
+    void drain()
+    {
+        for (;;) {
+            bool has_video = !m_video.frames.empty();
+            bool has_audio = !m_audio.frames.empty();
+            if (!has_video && !has_audio) { break; }
+
+            fcTime newest = std::max<fcTime>(m_video.last, m_audio.last);
+            bool video_first = has_video && (!has_audio || m_video.frames.front().timestamp <= m_audio.frames.front().timestamp);
+            if (video_first) {
+                fcTime t = m_video.frames.front().timestamp;
+                if (m_window > 0.0 && !m_audio.passed(t) && newest - t < m_window) { break; }
+                m_emit_video(*m_video.frames.front().frame);
+                m_video.frames.pop_front();
+            }
+            else {
+                fcTime t = m_audio.frames.front().timestamp;
+                if (m_window > 0.0 && !m_video.passed(t) && newest - t < m_window) { break; }
+                m_emit_audio(*m_audio.frames.front().frame);
+                m_audio.frames.pop_front();
+            }
+        }
+    }
+
+    fcTime m_window;
+    EmitVideo m_emit_video;
+    EmitAudio m_emit_audio;
+    Stream<VideoFrame> m_video;
+    Stream<AudioFrame> m_audio;
+    // declared last so that the thread is joined before the streams are destroyed
+    TaskQueue m_tasks;
+};
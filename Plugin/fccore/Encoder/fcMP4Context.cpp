@@ -1,362 +1,768 @@
-﻿#include "pch.h"
-#include "fcInternal.h"
-#include "Foundation/fcFoundation.h"
-#include "GraphicsDevice/fcGraphicsDevice.h"
-#include "fcMP4Internal.h"
-#include "fcMP4Context.h"
-#include "fcH264Encoder.h"
-#include "fcAACEncoder.h"
-#include "fcMP4Writer.h"
-
-#define fcMP4DefaultMaxBuffers 4
-
-
-class fcMP4Context : public fcIMP4Context
-{
-public:
-    using VideoEncoderPtr   = std::unique_ptr<fcIH264Encoder>;
-    using AudioEncoderPtr   = std::unique_ptr<fcIAACEncoder>;
-    using WriterPtr         = std::unique_ptr<fcMP4Writer>;
-    using WriterPtrs        = std::vector<WriterPtr>;
-
-    using VideoBuffer       = Buffer;
-    using VideoBufferPtr    = std::shared_ptr<VideoBuffer>;
-    using VideoBufferQueue  = ResourceQueue<VideoBufferPtr>;
-
-    using AudioBuffer       = RawVector<float>;
-    using AudioBufferPtr    = std::shared_ptr<AudioBuffer>;
-    using AudioBufferQueue  = ResourceQueue<AudioBufferPtr>;
-
-
-    fcMP4Context(fcMP4Config &conf, fcIGraphicsDevice *dev);
-    ~fcMP4Context();
-    void release() override;
-    bool isValid() const override;
-
-    const char* getVideoEncoderInfo() override;
-    const char* getAudioEncoderInfo() override;
-
-    void addOutputStream(fcStream *s) override;
-    bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp) override;
-    bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamps) override;
-    bool addVideoFramePixelsImpl(const void *pixels, fcPixelFormat fmt, fcTime timestamps);
-    void flushVideo();
-
-    bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp) override;
-    bool addAudioFrameImpl(const float *samples, int num_samples, fcTime timestamp);
-    void flushAudio();
-
-private:
-    // Body: [](WriterPtr&) -> void
-    template<class Body>
-    void eachStreams(const Body &b)
-    {
-        for (auto& s : m_writers) { b(*s); }
-    }
-
-private:
-    fcMP4Config m_conf;
-    fcIGraphicsDevice *m_dev;
-
-    WriterPtrs          m_writers;
-
-    TaskQueue           m_video_tasks;
-    VideoEncoderPtr     m_video_encoder;
-    VideoBufferQueue    m_video_buffers;
-    fcH264Frame         m_video_frame;
-
-    TaskQueue           m_audio_tasks;
-    AudioEncoderPtr     m_audio_encoder;
-    AudioBufferQueue    m_audio_buffers;
-    fcAACFrame          m_audio_frame;
-
-#ifndef fcMaster
-    std::unique_ptr<StdIOStream> m_dbg_h264_out;
-    std::unique_ptr<StdIOStream> m_dbg_aac_out;
-#endif // fcMaster
-};
-
-
-
-fcMP4Context::fcMP4Context(fcMP4Config &conf, fcIGraphicsDevice *dev)
-    : m_conf(conf)
-    , m_dev(dev)
-{
-#ifndef fcMaster
-    {
-        uint64_t now = (uint64_t)::time(nullptr);
-        char tmp_h264_filename[256];
-        char tmp_aac_filename[256];
-        sprintf(tmp_h264_filename, "%llu.h264", now);
-        sprintf(tmp_aac_filename, "%llu.aac", now);
-
-        m_dbg_h264_out.reset(new StdIOStream(new std::fstream(tmp_h264_filename, std::ios::binary | std::ios::out), true));
-        m_dbg_aac_out.reset(new StdIOStream(new std::fstream(tmp_aac_filename, std::ios::binary | std::ios::out), true));
-    }
-#endif // fcMaster
-
-
-    // create h264 encoder
-    m_video_encoder.reset();
-    if (m_conf.video) {
-        fcH264EncoderConfig h264conf;
-        h264conf.width = m_conf.video_width;
-        h264conf.height = m_conf.video_height;
-        h264conf.target_framerate = m_conf.video_target_framerate;
-        h264conf.bitrate_mode = m_conf.video_bitrate_mode;
-        h264conf.target_bitrate = m_conf.video_target_bitrate;
-
-        fcHWEncoderDeviceType hwdt = fcHWEncoderDeviceType::Unknown;
-        if (m_dev) {
-            switch (m_dev->getDeviceType()) {
-            case fcGfxDeviceType::D3D9:  hwdt = fcHWEncoderDeviceType::D3D9; break;
-            case fcGfxDeviceType::D3D10: hwdt = fcHWEncoderDeviceType::D3D10; break;
-            case fcGfxDeviceType::D3D11: hwdt = fcHWEncoderDeviceType::D3D11; break;
-            case fcGfxDeviceType::D3D12: hwdt = fcHWEncoderDeviceType::D3D12; break;
-            case fcGfxDeviceType::CUDA: hwdt = fcHWEncoderDeviceType::CUDA; break;
-            }
-        }
-
-        fcIH264Encoder *enc = nullptr;
-        if (!enc && (m_conf.video_flags & fcMP4_H264NVIDIA) != 0) {
-            // NVENC require D3D or CUDA device
-            if (m_dev) {
-                enc = fcCreateH264EncoderNVIDIA(h264conf, m_dev->getDevicePtr(), hwdt);
-            }
-        }
-        if (!enc && (m_conf.video_flags & fcMP4_H264AMD) != 0) {
-            if (m_dev) {
-                enc = fcCreateH264EncoderAMD(h264conf, m_dev->getDevicePtr(), hwdt);
-            }
-        }
-        if (!enc && (m_conf.video_flags & fcMP4_H264IntelHW) != 0) {
-            if (m_dev) {
-                enc = fcCreateH264EncoderIntelHW(h264conf, m_dev->getDevicePtr(), hwdt);
-            }
-        }
-        if (!enc && (m_conf.video_flags & fcMP4_H264IntelSW) != 0) {
-            enc = fcCreateH264EncoderIntelSW(h264conf);
-        }
-        if (!enc && (m_conf.video_flags & fcMP4_H264OpenH264) != 0) {
-            enc = fcCreateH264EncoderOpenH264(h264conf);
-        }
-
-        if (enc) {
-            m_video_encoder.reset(enc);
-            for (int i = 0; i < 4; ++i) {
-                m_video_buffers.push(VideoBufferPtr(new VideoBuffer()));
-            }
-        }
-    }
-
-    // create aac encoder
-    m_audio_encoder.reset();
-    if (m_conf.audio) {
-        fcAACEncoderConfig aacconf;
-        aacconf.sample_rate = m_conf.audio_sample_rate;
-        aacconf.num_channels = m_conf.audio_num_channels;
-        aacconf.bitrate_mode = m_conf.audio_bitrate_mode;
-        aacconf.target_bitrate = m_conf.audio_target_bitrate;
-
-        fcIAACEncoder *enc = nullptr;
-        if (!enc && (m_conf.audio_flags & fcMP4_AACIntel) != 0) {
-            enc = fcCreateAACEncoderIntel(aacconf);
-        }
-        if (!enc && (m_conf.audio_flags & fcMP4_AACFAAC) != 0) {
-            enc = fcCreateAACEncoderFAAC(aacconf);
-        }
-
-        if (enc) {
-            m_audio_encoder.reset(enc);
-            for (int i = 0; i < 4; ++i) {
-                m_audio_buffers.push(AudioBufferPtr(new AudioBuffer()));
-            }
-        }
-    }
-}
-
-fcMP4Context::~fcMP4Context()
-{
-    flushVideo();
-    flushAudio();
-    m_video_tasks.wait();
-    m_audio_tasks.wait();
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    m_video_encoder.reset();
-    m_audio_encoder.reset();
-    m_writers.clear();
-
-#ifndef fcMaster
-    m_dbg_h264_out.reset();
-    m_dbg_aac_out.reset();
-#endif // fcMaster
-}
-
-
-void fcMP4Context::release()
-{
-    delete this;
-}
-
-bool fcMP4Context::isValid() const
-{
-    return m_video_encoder || m_audio_encoder;
-}
-
-const char* fcMP4Context::getAudioEncoderInfo()
-{
-    if (!m_audio_encoder) { return ""; }
-    return m_audio_encoder->getEncoderInfo();
-}
-
-const char* fcMP4Context::getVideoEncoderInfo()
-{
-    if (!m_video_encoder) { return ""; }
-    return m_video_encoder->getEncoderInfo();
-}
-
-void fcMP4Context::addOutputStream(fcStream *s)
-{
-    auto writer = new fcMP4Writer(*s, m_conf);
-    if (m_audio_encoder) {
-        writer->setAACEncoderInfo(m_audio_encoder->getDecoderSpecificInfo());
-    }
-    m_writers.emplace_back(WriterPtr(writer));
-}
-
-bool fcMP4Context::addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp)
-{
-    if (!tex || !m_video_encoder || !m_dev) { return false; }
-
-    auto buf = m_video_buffers.pop();
-    size_t psize = fcGetPixelSize(fmt);
-    size_t size = m_conf.video_width * m_conf.video_height * psize;
-    buf->resize(size);
-    if (m_dev->readTexture(buf->data(), buf->size(), tex, m_conf.video_width, m_conf.video_height, fmt)) {
-        m_video_tasks.run([this, buf, fmt, timestamp]() {
-            addVideoFramePixelsImpl(buf->data(), fmt, timestamp);
-            m_video_buffers.push(buf);
-        });
-    }
-    else {
-        m_video_buffers.push(buf);
-        return false;
-    }
-    return true;
-}
-
-bool fcMP4Context::addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
-{
-    if (!pixels || !m_video_encoder) { return false; }
-
-    auto buf = m_video_buffers.pop();
-    size_t psize = fcGetPixelSize(fmt);
-    size_t size = m_conf.video_width * m_conf.video_height * psize;
-    buf->resize(size);
-    memcpy(buf->data(), pixels, size);
-
-    m_video_tasks.run([this, buf, fmt, timestamp]() {
-        addVideoFramePixelsImpl(buf->data(), fmt, timestamp);
-        m_video_buffers.push(buf);
-    });
-    return true;
-
-}
-
-bool fcMP4Context::addVideoFramePixelsImpl(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
-{
-    // encode!
-    if (m_video_encoder->encode(m_video_frame, pixels, fmt, timestamp)) {
-        eachStreams([this](fcMP4Writer& s) { s.addVideoFrame(m_video_frame); });
-#ifndef fcMaster
-        m_dbg_h264_out->write(m_video_frame.data.data(), m_video_frame.data.size());
-#endif // fcMaster
-        m_video_frame.clear();
-        return true;
-    }
-    return false;
-}
-
-void fcMP4Context::flushVideo()
-{
-    if (!m_video_encoder) { return; }
-
-    m_video_tasks.run([this]() {
-        if (m_video_encoder->flush(m_video_frame)) {
-            eachStreams([&](fcMP4Writer& writer) {
-                writer.addVideoFrame(m_video_frame);
-            });
-            m_video_frame.clear();
-        }
-    });
-}
-
-bool fcMP4Context::addAudioFrame(const float *samples, int num_samples, fcTime timestamp)
-{
-    if (!m_audio_encoder) {
-        fcDebugLog("fcMP4Context::addAudioFrame(): aac encoder is null.");
-        return false;
-    }
-
-    auto buf = m_audio_buffers.pop();
-    buf->assign(samples, num_samples);
-
-    m_audio_tasks.run([this, buf, timestamp]() {
-        addAudioFrameImpl(buf->data(), (int)buf->size(), timestamp);
-        m_audio_buffers.push(buf);
-    });
-    return true;
-}
-
-bool fcMP4Context::addAudioFrameImpl(const float *samples, int num_samples, fcTime timestamp)
-{
-    if (m_audio_encoder->encode(m_audio_frame, samples, num_samples, timestamp)) {
-        eachStreams([this](fcMP4Writer& s) { s.addAudioFrame(m_audio_frame); });
-#ifndef fcMaster
-        m_dbg_aac_out->write(m_audio_frame.data.data(), m_audio_frame.data.size());
-#endif // fcMaster
-        m_audio_frame.clear();
-        return true;
-    }
-    return false;
-}
-
-
-void fcMP4Context::flushAudio()
-{
-    if (!m_audio_encoder) { return; }
-
-    m_audio_tasks.run([this]() {
-        if (m_audio_encoder->flush(m_audio_frame)) {
-            eachStreams([&](fcMP4Writer& writer) {
-                writer.addAudioFrame(m_audio_frame);
-            });
-            m_audio_frame.clear();
-        }
-    });
-}
-
-namespace {
-    std::string g_module_path;
-    std::string g_faac_package_path;
-}
-
-const std::string& fcMP4GetModulePath() { return g_module_path; }
-const std::string& fcMP4GetFAACPackagePath() { return g_faac_package_path; }
-
-fcIMP4Context* fcMP4CreateContextImpl(fcMP4Config &conf, fcIGraphicsDevice *dev)
-{
-    auto ret = new fcMP4Context(conf, dev);
-    if (!ret->isValid()) {
-        delete ret;
-        ret = nullptr;
-    }
-    return ret;
-}
-
-void fcMP4SetModulePathImpl(const char *path)
-{
-    g_module_path = path;
-}
+﻿#include "pch.h"
+#include "fcInternal.h"
+#include "Foundation/fcFoundation.h"
+#include "GraphicsDevice/fcGraphicsDevice.h"
+#include "fcMP4Internal.h"
+#include "fcMP4Context.h"
+#include "fcH264Encoder.h"
+#include "fcAACEncoder.h"
+#include "fcSegmentedEncoder.h"
+#include "fcInterleaveQueue.h"
+#include "fcMP4Writer.h"
+
+#define fcMP4DefaultMaxBuffers 4
+
+
+namespace {
+
+// whether each encoder worked with the settings it was tried with.
+// filled by fcMP4ProbeEncoders() and by contexts as they try encoders, so an encoder that can't work is tried once instead of
+// on every recording start, and the probe knows which encoder a context will pick.
+// an encoder whose module or driver is missing fails for any settings. other failures are recorded for the settings they
+// happened with (e.g. a resolution the hardware doesn't support). a failure never replaces a success: once the settings
+// worked, a later failure is taken as momentary (encoder sessions used up by another process) and is retried next time.
+// cleared when the module path changes, as modules may be found then.
+class EncoderProbeCache
+{
+public:
+    enum class Result
+    {
+        Unknown,
+        Works,
+        Fails,
+    };
+
+    struct Key
+    {
+        int flag;       // one of fcMP4VideoFlags / fcMP4AudioFlags
+        void *device;   // graphics device for hardware encoders
+        int width;      // video: resolution. audio: sample rate and channels. 0 and 0: any settings
+        int height;
+
+        bool operator==(const Key& v) const
+        {
+            return flag == v.flag && device == v.device && width == v.width && height == v.height;
+        }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& v) const
+        {
+            size_t h = std::hash<void*>()(v.device);
+            h = h * 31 + (size_t)v.flag;
+            h = h * 31 + (size_t)v.width;
+            h = h * 31 + (size_t)v.height;
+            return h;
+        }
+    };
+
+    Result find(const Key& key)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto any = m_results.find(Key{ key.flag, key.device, 0, 0 });
+        if (any != m_results.end()) { return any->second; }
+        auto it = m_results.find(key);
+        return it != m_results.end() ? it->second : Result::Unknown;
+    }
+
+    // Create: [&]() -> Encoder* {}
+    // Available: [&]() -> bool {}. called when Create fails. false: the module / driver is missing
+    template<class Encoder, class Create, class Available>
+    Encoder* create(const Key& key, const Create& body, const Available& available)
+    {
+        if (find(key) == Result::Fails) { return nullptr; }
+        Encoder *ret = body();
+        if (ret) {
+            record(key, Result::Works);
+        }
+        else if (!available()) {
+            record(Key{ key.flag, key.device, 0, 0 }, Result::Fails);
+        }
+        else {
+            record(key, Result::Fails);
+        }
+        return ret;
+    }
+
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_results.clear();
+    }
+
+    void probe(const std::function<void()>& task)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_tasks) {
+            m_tasks.reset(new TaskQueue());
+        }
+        m_tasks->run(task);
+    }
+
+    // contexts wait for running probes instead of initializing the same encoders concurrently
+    void wait()
+    {
+        TaskQueue *tasks = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            tasks = m_tasks.get();
+        }
+        if (tasks) { tasks->wait(); }
+    }
+
+private:
+    void record(const Key& key, Result r)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto& dst = m_results[key];
+        if (dst != Result::Works) { dst = r; }
+    }
+
+    std::mutex m_mutex;
+    std::unordered_map<Key, Result, KeyHash> m_results;
+    std::unique_ptr<TaskQueue> m_tasks;
+};
+
+EncoderProbeCache& GetProbeCache()
+{
+    static EncoderProbeCache s_cache;
+    return s_cache;
+}
+
+const int g_h264_priority[] = { fcMP4_H264NVIDIA, fcMP4_H264AMD, fcMP4_H264IntelHW, fcMP4_H264IntelSW, fcMP4_H264OpenH264 };
+const int g_aac_priority[] = { fcMP4_AACIntel, fcMP4_AACFAAC };
+
+// hardware encoders run on the graphics device
+bool IsHardwareH264Encoder(int flag)
+{
+    return flag == fcMP4_H264NVIDIA || flag == fcMP4_H264AMD || flag == fcMP4_H264IntelHW;
+}
+
+EncoderProbeCache::Key GetH264ProbeKey(const fcH264EncoderConfig& conf, int flag, fcIGraphicsDevice *dev)
+{
+    return { flag, dev && IsHardwareH264Encoder(flag) ? dev->getDevicePtr() : nullptr, conf.width, conf.height };
+}
+
+EncoderProbeCache::Key GetAACProbeKey(const fcAACEncoderConfig& conf, int flag)
+{
+    return { flag, nullptr, conf.sample_rate, conf.num_channels };
+}
+
+fcIH264Encoder* CreateH264Encoder(const fcH264EncoderConfig& conf, int flag, fcIGraphicsDevice *dev)
+{
+    fcHWEncoderDeviceType hwdt = fcHWEncoderDeviceType::Unknown;
+    if (dev) {
+        switch (dev->getDeviceType()) {
+        case fcGfxDeviceType::D3D9:  hwdt = fcHWEncoderDeviceType::D3D9; break;
+        case fcGfxDeviceType::D3D10: hwdt = fcHWEncoderDeviceType::D3D10; break;
+        case fcGfxDeviceType::D3D11: hwdt = fcHWEncoderDeviceType::D3D11; break;
+        case fcGfxDeviceType::D3D12: hwdt = fcHWEncoderDeviceType::D3D12; break;
+        case fcGfxDeviceType::CUDA: hwdt = fcHWEncoderDeviceType::CUDA; break;
+        }
+    }
+
+    auto create = [&]() -> fcIH264Encoder* {
+        switch (flag) {
+        case fcMP4_H264NVIDIA:
+            // NVENC require D3D or CUDA device
+            return dev ? fcCreateH264EncoderNVIDIA(conf, dev->getDevicePtr(), hwdt) : nullptr;
+        case fcMP4_H264AMD:
+            return dev ? fcCreateH264EncoderAMD(conf, dev->getDevicePtr(), hwdt) : nullptr;
+        case fcMP4_H264IntelHW:
+            return dev ? fcCreateH264EncoderIntelHW(conf, dev->getDevicePtr(), hwdt) : nullptr;
+        case fcMP4_H264IntelSW:
+            return fcCreateH264EncoderIntelSW(conf);
+        case fcMP4_H264OpenH264:
+            return fcCreateH264EncoderOpenH264(conf);
+        }
+        return nullptr;
+    };
+    auto available = [&]() -> bool {
+        switch (flag) {
+        case fcMP4_H264NVIDIA:  return dev && fcLoadNVENCModule();
+        case fcMP4_H264AMD:     return dev && fcLoadAMFModule();
+        case fcMP4_H264IntelHW: return dev && fcLoadIntelMediaSDK(true);
+        case fcMP4_H264IntelSW: return fcLoadIntelMediaSDK(false);
+        case fcMP4_H264OpenH264:return fcLoadOpenH264Module();
+        }
+        return false;
+    };
+    return GetProbeCache().create<fcIH264Encoder>(GetH264ProbeKey(conf, flag, dev), create, available);
+}
+
+fcIAACEncoder* CreateAACEncoder(const fcAACEncoderConfig& conf, int flag)
+{
+    auto create = [&]() -> fcIAACEncoder* {
+        switch (flag) {
+        case fcMP4_AACIntel: return fcCreateAACEncoderIntel(conf);
+        case fcMP4_AACFAAC: return fcCreateAACEncoderFAAC(conf);
+        }
+        return nullptr;
+    };
+    auto available = [&]() -> bool {
+        switch (flag) {
+        // no separate driver check for Intel. its failures are not recorded
+        case fcMP4_AACIntel: return true;
+        case fcMP4_AACFAAC: return fcLoadFAACModule();
+        }
+        return false;
+    };
+    return GetProbeCache().create<fcIAACEncoder>(GetAACProbeKey(conf, flag), create, available);
+}
+
+// true if the encoder works with conf. a known result is returned without trying the encoder again.
+bool ProbeH264Encoder(const fcH264EncoderConfig& conf, int flag, fcIGraphicsDevice *dev)
+{
+    switch (GetProbeCache().find(GetH264ProbeKey(conf, flag, dev))) {
+    case EncoderProbeCache::Result::Works: return true;
+    case EncoderProbeCache::Result::Fails: return false;
+    default: break;
+    }
+    std::unique_ptr<fcIH264Encoder> enc(CreateH264Encoder(conf, flag, dev));
+    return enc != nullptr;
+}
+
+bool ProbeAACEncoder(const fcAACEncoderConfig& conf, int flag)
+{
+    switch (GetProbeCache().find(GetAACProbeKey(conf, flag))) {
+    case EncoderProbeCache::Result::Works: return true;
+    case EncoderProbeCache::Result::Fails: return false;
+    default: break;
+    }
+    std::unique_ptr<fcIAACEncoder> enc(CreateAACEncoder(conf, flag));
+    return enc != nullptr;
+}
+
+fcH264EncoderConfig GetH264EncoderConfig(const fcMP4Config& conf)
+{
+    fcH264EncoderConfig ret;
+    ret.width = conf.video_width;
+    ret.height = conf.video_height;
+    ret.target_framerate = conf.video_target_framerate;
+    ret.bitrate_mode = conf.video_bitrate_mode;
+    ret.target_bitrate = conf.video_target_bitrate;
+    return ret;
+}
+
+fcAACEncoderConfig GetAACEncoderConfig(const fcMP4Config& conf)
+{
+    fcAACEncoderConfig ret;
+    ret.sample_rate = conf.audio_sample_rate;
+    ret.num_channels = conf.audio_num_channels;
+    ret.bitrate_mode = conf.audio_bitrate_mode;
+    ret.target_bitrate = conf.audio_target_bitrate;
+    return ret;
+}
+
+} // namespace
+
+
+class fcMP4Context : public fcIMP4Context
+{
+public:
+    using VideoEncoderPtr   = std::unique_ptr<fcIH264Encoder>;
+    using AudioEncoderPtr   = std::unique_ptr<fcIAACEncoder>;
+    using WriterPtr         = std::unique_ptr<fcMP4Writer>;
+    using WriterPtrs        = std::vector<WriterPtr>;
+
+    // pixels: raw frame (texture readback, or a copy / transform of the pixels passed in). i420: frame handed to encodeI420().
+    // if to_i420 is set, pixels (in format) are converted into i420 by the encode task, off the calling thread.
+    // if neither is used for the frame, encoders that don't accept I420 get pixels (in format) as they are.
+    struct VideoBuffer
+    {
+        PooledBuffer pixels;
+        PooledBuffer tmp;
+        I420Image i420;
+        fcPixelFormat format = fcPixelFormat_Unknown;
+        bool to_i420 = false;
+    };
+    using VideoBufferPtr    = std::shared_ptr<VideoBuffer>;
+    using VideoBufferQueue  = ResourceQueue<VideoBufferPtr>;
+
+    using SegmentedVideoEncoder = fcSegmentedEncoder<fcIH264Encoder, fcH264Frame>;
+    using SegmentedVideoEncoderPtr = std::unique_ptr<SegmentedVideoEncoder>;
+    using VideoEncodeTask   = SegmentedVideoEncoder::EncodeTask;
+
+    using Interleaver       = fcInterleaveQueue<fcH264Frame, fcAACFrame>;
+    using InterleaverPtr    = std::unique_ptr<Interleaver>;
+
+    using AudioBuffer       = RawVector<float>;
+    using AudioBufferPtr    = std::shared_ptr<AudioBuffer>;
+    using AudioBufferQueue  = ResourceQueue<AudioBufferPtr>;
+
+
+    fcMP4Context(fcMP4Config &conf, fcIGraphicsDevice *dev);
+    ~fcMP4Context();
+    void release() override;
+    // flushes and destroys the encoders. the first step of the destructor
+    void releaseEncoders();
+    bool isValid() const override;
+
+    const char* getVideoEncoderInfo() override;
+    const char* getAudioEncoderInfo() override;
+
+    void addOutputStream(fcStream *s) override;
+    void addElementaryStreamTap(fcStream *video, fcStream *audio) override;
+    bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp) override;
+    bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamps) override;
+    void submitVideoFrame(const VideoBufferPtr& buf, fcTime timestamp);
+    void encodeVideoFrame(const VideoBufferPtr& buf, const VideoEncodeTask& task);
+    void convertVideoFrame(VideoBuffer& buf);
+    void emitVideoFrame(fcH264Frame& frame);
+    void flushVideo();
+
+    bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp) override;
+    bool addAudioFrameImpl(const float *samples, int num_samples, fcTime timestamp);
+    void emitAudioFrame();
+    void flushAudio();
+
+    void setPixelTransform(const fcPixelTransform *t) override;
+
+private:
+    // Body: [](WriterPtr&) -> void
+    template<class Body>
+    void eachStreams(const Body &b)
+    {
+        for (auto& s : m_writers) { b(*s); }
+    }
+
+private:
+    fcMP4Config m_conf;
+    fcIGraphicsDevice *m_dev;
+    PixelTransformStage m_pixel_transform;
+    // declared before everything that records into it
+    StatsCollector      m_stats;
+
+    std::vector<std::unique_ptr<StatsStream>> m_streams; // output streams wrapped for m_stats. outlive m_writers
+    WriterPtrs          m_writers;
+    InterleaverPtr      m_interleaver;
+
+    TaskQueue           m_video_tasks;
+    VideoEncoderPtr     m_video_encoder;
+    SegmentedVideoEncoderPtr m_segmented_video;
+    VideoBufferQueue    m_video_buffers;
+    fcH264Frame         m_video_frame;
+
+    TaskQueue           m_audio_tasks;
+    AudioEncoderPtr     m_audio_encoder;
+    AudioBufferQueue    m_audio_buffers;
+    fcAACFrame          m_audio_frame;
+
+    // elementary stream taps. not owned
+    std::vector<fcStream*> m_video_taps;
+    std::vector<fcStream*> m_audio_taps;
+};
+
+
+
+fcMP4Context::fcMP4Context(fcMP4Config &conf, fcIGraphicsDevice *dev)
+    : m_conf(conf)
+    , m_dev(dev)
+    , m_stats(static_cast<fcIMP4Context*>(this))
+{
+    GetProbeCache().wait();
+
+    // create h264 encoder. encoders known to fail with these settings are skipped.
+    m_video_encoder.reset();
+    if (m_conf.video) {
+        fcH264EncoderConfig h264conf = GetH264EncoderConfig(m_conf);
+
+        // parallel segments use software encoders only
+        bool parallel = m_conf.video_parallel_segments > 1;
+        int flags = m_conf.video_flags;
+        if (parallel) {
+            flags &= fcMP4_H264IntelSW | fcMP4_H264OpenH264;
+        }
+
+        fcIH264Encoder *enc = nullptr;
+        int flag = 0;
+        for (int f : g_h264_priority) {
+            if ((flags & f) != 0) {
+                enc = CreateH264Encoder(h264conf, f, m_dev);
+                if (enc) { flag = f; break; }
+            }
+        }
+
+        if (enc) {
+            m_video_encoder.reset(enc);
+
+            int num_buffers = 4;
+            if (parallel) {
+                int max_frames = SegmentedVideoEncoder::getMaxFrames(m_conf.video_max_buffered_frames,
+                    m_conf.video_segment_frames, m_conf.video_parallel_segments, (size_t)m_conf.video_width * m_conf.video_height * 4);
+                // all segments use the same kind of encoder so that their SPS / PPS match
+                m_segmented_video.reset(new SegmentedVideoEncoder(m_conf.video_segment_frames, m_conf.video_parallel_segments, max_frames,
+                    [this, h264conf, flag]() { return CreateH264Encoder(h264conf, flag, m_dev); },
+                    [this](fcH264Frame& frame) { emitVideoFrame(frame); }));
+                // raw frames waiting for the segment encoders are capped. one more is filled by the caller meanwhile.
+                num_buffers = std::max<int>(num_buffers, max_frames + 1);
+            }
+            for (int i = 0; i < num_buffers; ++i) {
+                m_video_buffers.push(VideoBufferPtr(new VideoBuffer()));
+            }
+        }
+    }
+
+    // create aac encoder
+    m_audio_encoder.reset();
+    if (m_conf.audio) {
+        fcAACEncoderConfig aacconf = GetAACEncoderConfig(m_conf);
+
+        fcIAACEncoder *enc = nullptr;
+        for (int f : g_aac_priority) {
+            if ((m_conf.audio_flags & f) != 0) {
+                enc = CreateAACEncoder(aacconf, f);
+                if (enc) { break; }
+            }
+        }
+
+        if (enc) {
+            m_audio_encoder.reset(enc);
+            for (int i = 0; i < 4; ++i) {
+                m_audio_buffers.push(AudioBufferPtr(new AudioBuffer()));
+            }
+        }
+    }
+
+    m_interleaver.reset(new Interleaver(m_conf.interleave_window, m_video_encoder != nullptr, m_audio_encoder != nullptr,
+        [this](const fcH264Frame& frame) {
+            StatsScope scope(m_stats, fcStatsStage_Mux);
+            eachStreams([&](fcMP4Writer& writer) { writer.addVideoFrame(frame); });
+        },
+        [this](const fcAACFrame& frame) {
+            StatsScope scope(m_stats, fcStatsStage_Mux);
+            eachStreams([&](fcMP4Writer& writer) { writer.addAudioFrame(frame); });
+        }));
+}
+
+fcMP4Context::~fcMP4Context()
+{
+    releaseEncoders();
+    m_interleaver.reset();
+    m_writers.clear();
+}
+
+
+void fcMP4Context::release()
+{
+    delete this;
+}
+
+void fcMP4Context::releaseEncoders()
+{
+    // flush*() are no-ops once the encoders are gone, so this can be called more than once
+    flushVideo();
+    flushAudio();
+    m_video_tasks.wait();
+    m_audio_tasks.wait();
+
+    m_segmented_video.reset();
+    m_video_encoder.reset();
+    m_audio_encoder.reset();
+}
+
+bool fcMP4Context::isValid() const
+{
+    return m_video_encoder || m_audio_encoder;
+}
+
+const char* fcMP4Context::getAudioEncoderInfo()
+{
+    if (!m_audio_encoder) { return ""; }
+    return m_audio_encoder->getEncoderInfo();
+}
+
+const char* fcMP4Context::getVideoEncoderInfo()
+{
+    if (!m_video_encoder) { return ""; }
+    return m_video_encoder->getEncoderInfo();
+}
+
+void fcMP4Context::addOutputStream(fcStream *s)
+{
+    m_streams.emplace_back(new StatsStream(*s, m_stats));
+    auto writer = new fcMP4Writer(*m_streams.back(), m_conf);
+    if (m_audio_encoder) {
+        writer->setAACEncoderInfo(m_audio_encoder->getDecoderSpecificInfo());
+    }
+    m_writers.emplace_back(WriterPtr(writer));
+}
+
+void fcMP4Context::addElementaryStreamTap(fcStream *video, fcStream *audio)
+{
+    if (video) { m_video_taps.push_back(video); }
+    if (audio) { m_audio_taps.push_back(audio); }
+}
+
+bool fcMP4Context::addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp)
+{
+    if (!tex || !m_video_encoder || !m_dev) { return false; }
+
+    auto buf = m_stats.popBuffer(m_video_buffers);
+    size_t psize = fcGetPixelSize(fmt);
+    size_t size = m_conf.video_width * m_conf.video_height * psize;
+    buf->pixels.resize(size);
+    bool read;
+    {
+        StatsScope scope(m_stats, fcStatsStage_Readback);
+        read = m_dev->readTexture(buf->pixels.data(), buf->pixels.size(), tex, m_conf.video_width, m_conf.video_height, fmt);
+    }
+    if (read) {
+        buf->format = fmt;
+        buf->to_i420 = m_video_encoder->acceptsI420();
+        submitVideoFrame(buf, timestamp);
+    }
+    else {
+        m_video_buffers.push(buf);
+        return false;
+    }
+    return true;
+}
+
+bool fcMP4Context::addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
+{
+    if (!pixels || !m_video_encoder) { return false; }
+
+    // pixels are only valid during this call, so the caller pays for one copy (or the transform, which replaces the copy).
+    // I420 input is copied straight into the encoder's planes. the RGB -> YUV conversion is left to the encode task.
+    auto buf = m_stats.popBuffer(m_video_buffers);
+    int width = m_conf.video_width;
+    int height = m_conf.video_height;
+    bool i420 = m_video_encoder->acceptsI420();
+    if (i420 && fmt == fcPixelFormat_I420 && !m_pixel_transform.enabled()) {
+        StatsScope scope(m_stats, fcStatsStage_Convert);
+        AnyToI420(buf->i420, buf->tmp, pixels, fmt, width, height,
+            fcColorSpace::BT601, fcColorRange::Limited, fcYUVCodecAlignment);
+        buf->to_i420 = false;
+    }
+    else {
+        StatsScope scope(m_stats, fcStatsStage_Convert);
+        buf->pixels.resize(fcGetImageSize(fmt, width, height));
+        if (!m_pixel_transform.apply(buf->pixels.data(), fmt, pixels, fmt, width, height)) {
+            m_video_buffers.push(buf);
+            return false;
+        }
+        buf->to_i420 = i420;
+    }
+    buf->format = fmt;
+    submitVideoFrame(buf, timestamp);
+    return true;
+}
+
+// encoders that read I420 get the pooled buf->i420 (converted by the encode task when needed).
+// hardware encoders upload buf->pixels into their own surfaces.
+void fcMP4Context::submitVideoFrame(const VideoBufferPtr& buf, fcTime timestamp)
+{
+    if (m_video_encoder->acceptsI420()) {
+        encodeVideoFrame(buf, [buf, timestamp](fcIH264Encoder& encoder, fcH264Frame& dst) {
+            return encoder.encodeI420(dst, buf->i420.data(), timestamp);
+        });
+    }
+    else {
+        encodeVideoFrame(buf, [buf, timestamp](fcIH264Encoder& encoder, fcH264Frame& dst) {
+            return encoder.encode(dst, buf->pixels.data(), buf->format, timestamp);
+        });
+    }
+}
+
+// serial: encodes with m_video_encoder on m_video_tasks.
+// parallel segments: encodes on the segment's thread and the results are emitted in stream order.
+void fcMP4Context::encodeVideoFrame(const VideoBufferPtr& buf, const VideoEncodeTask& task)
+{
+    m_stats.enqueue(StatsCollector::Queue::Video);
+    if (m_segmented_video) {
+        // the raw frame goes back to the pool even if the segment has no encoder and drops it
+        m_segmented_video->encode(
+            [this, buf, task](fcIH264Encoder& encoder, fcH264Frame& dst) {
+                convertVideoFrame(*buf);
+                StatsScope scope(m_stats, fcStatsStage_Encode);
+                return task(encoder, dst);
+            },
+            [this, buf]() {
+                m_video_buffers.push(buf);
+                m_stats.dequeue(StatsCollector::Queue::Video);
+            });
+    }
+    else {
+        m_video_tasks.run([this, buf, task]() {
+            convertVideoFrame(*buf);
+            bool ret;
+            {
+                StatsScope scope(m_stats, fcStatsStage_Encode);
+                ret = task(*m_video_encoder, m_video_frame);
+            }
+            if (ret) {
+                emitVideoFrame(m_video_frame);
+            }
+            m_video_buffers.push(buf);
+            m_stats.dequeue(StatsCollector::Queue::Video);
+        });
+    }
+}
+
+void fcMP4Context::convertVideoFrame(VideoBuffer& buf)
+{
+    if (!buf.to_i420) { return; }
+    StatsScope scope(m_stats, fcStatsStage_YUV);
+    AnyToI420(buf.i420, buf.tmp, buf.pixels.data(), buf.format, m_conf.video_width, m_conf.video_height,
+        fcColorSpace::BT601, fcColorRange::Limited, fcYUVCodecAlignment);
+}
+
+void fcMP4Context::emitVideoFrame(fcH264Frame& frame)
+{
+    // taps get the encoder's buffer before it is handed over to the interleaver
+    for (auto *s : m_video_taps) {
+        s->write(frame.data.data(), frame.data.size());
+    }
+    m_interleaver->addVideoFrame(frame, frame.timestamp);
+    frame.clear();
+}
+
+void fcMP4Context::flushVideo()
+{
+    if (!m_video_encoder) { return; }
+
+    if (m_segmented_video) {
+        m_segmented_video->flush();
+        m_interleaver->endVideo();
+        return;
+    }
+    m_video_tasks.run([this]() {
+        if (m_video_encoder->flush(m_video_frame)) {
+            emitVideoFrame(m_video_frame);
+        }
+        m_interleaver->endVideo();
+    });
+}
+
+void fcMP4Context::setPixelTransform(const fcPixelTransform *t)
+{
+    m_pixel_transform.set(t);
+}
+
+bool fcMP4Context::addAudioFrame(const float *samples, int num_samples, fcTime timestamp)
+{
+    if (!m_audio_encoder) {
+        fcDebugLog("fcMP4Context::addAudioFrame(): aac encoder is null.");
+        return false;
+    }
+
+    auto buf = m_stats.popBuffer(m_audio_buffers);
+    buf->assign(samples, num_samples);
+
+    m_stats.enqueue(StatsCollector::Queue::Audio);
+    m_audio_tasks.run([this, buf, timestamp]() {
+        addAudioFrameImpl(buf->data(), (int)buf->size(), timestamp);
+        m_audio_buffers.push(buf);
+        m_stats.dequeue(StatsCollector::Queue::Audio);
+    });
+    return true;
+}
+
+bool fcMP4Context::addAudioFrameImpl(const float *samples, int num_samples, fcTime timestamp)
+{
+    bool ret;
+    {
+        StatsScope scope(m_stats, fcStatsStage_AudioEncode);
+        ret = m_audio_encoder->encode(m_audio_frame, samples, num_samples, timestamp);
+    }
+    if (ret) {
+        emitAudioFrame();
+        return true;
+    }
+    return false;
+}
+
+void fcMP4Context::emitAudioFrame()
+{
+    for (auto *s : m_audio_taps) {
+        s->write(m_audio_frame.data.data(), m_audio_frame.data.size());
+    }
+    m_interleaver->addAudioFrame(m_audio_frame);
+    m_audio_frame.clear();
+}
+
+
+void fcMP4Context::flushAudio()
+{
+    if (!m_audio_encoder) { return; }
+
+    m_audio_tasks.run([this]() {
+        if (m_audio_encoder->flush(m_audio_frame)) {
+            emitAudioFrame();
+        }
+        m_interleaver->endAudio();
+    });
+}
+
+namespace {
+    // set from the user's thread, read by contexts and the probe thread
+    std::mutex g_path_mutex;
+    std::string g_module_path;
+    std::string g_faac_package_path;
+}
+
+std::string fcMP4GetModulePath()
+{
+    std::unique_lock<std::mutex> lock(g_path_mutex);
+    return g_module_path;
+}
+
+std::string fcMP4GetFAACPackagePath()
+{
+    std::unique_lock<std::mutex> lock(g_path_mutex);
+    return g_faac_package_path;
+}
+
+fcIMP4Context* fcMP4CreateContextImpl(fcMP4Config &conf, fcIGraphicsDevice *dev)
+{
+    auto ret = new fcMP4Context(conf, dev);
+    if (!ret->isValid()) {
+        delete ret;
+        ret = nullptr;
+    }
+    return ret;
+}
+
+void fcMP4ProbeEncodersImpl(const fcMP4Config& conf, fcIGraphicsDevice *dev)
+{
+    // stops at the first encoder that works, the one a context with the same settings will pick.
+    // hardware encoders come first and are tried here: the graphics device is only known to be alive on the calling thread.
+    // software encoders don't touch the device and load their modules (OpenH264, FAAC) off the calling thread.
+    fcMP4Config c = conf;
+    bool video_found = false;
+    if (c.video) {
+        auto h264conf = GetH264EncoderConfig(c);
+        for (int f : g_h264_priority) {
+            if ((c.video_flags & f) == 0 || !IsHardwareH264Encoder(f)) { continue; }
+            if (ProbeH264Encoder(h264conf, f, dev)) { video_found = true; break; }
+        }
+    }
+
+    GetProbeCache().probe([c, video_found]() {
+        if (c.video && !video_found) {
+            auto h264conf = GetH264EncoderConfig(c);
+            for (int f : g_h264_priority) {
+                if ((c.video_flags & f) == 0 || IsHardwareH264Encoder(f)) { continue; }
+                if (ProbeH264Encoder(h264conf, f, nullptr)) { break; }
+            }
+        }
+        if (c.audio) {
+            auto aacconf = GetAACEncoderConfig(c);
+            for (int f : g_aac_priority) {
+                if ((c.audio_flags & f) == 0) { continue; }
+                if (ProbeAACEncoder(aacconf, f)) { break; }
+            }
+        }
+    });
+}
+
+void fcMP4SetModulePathImpl(const char *path)
+{
+    {
+        std::unique_lock<std::mutex> lock(g_path_mutex);
+        g_module_path = path ? path : "";
+    }
+    // modules missing from the old path may be found in the new one
+    GetProbeCache().clear();
+}
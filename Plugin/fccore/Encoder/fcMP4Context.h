@@ -1,39 +1,48 @@
-﻿#pragma once
-
-class fcIMP4Context
-{
-public:
-    virtual void release() = 0;
-    virtual bool isValid() const = 0;
-
-    virtual const char* getVideoEncoderInfo() = 0;
-    virtual const char* getAudioEncoderInfo() = 0;
-
-    virtual void addOutputStream(fcStream *s) = 0;
-
-    // assume texture format is RGBA8.
-    // timestamp=-1 is treated as current time.
-    virtual bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp = -1) = 0;
-
-    // assume pixel format is RGBA8 or I420 (color_space indicates)
-    // timestamp=-1 is treated as current time.
-    virtual bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1) = 0;
-
-    // timestamp=-1 is treated as current time.
-    virtual bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp = -1) = 0;
-
-protected:
-    virtual ~fcIMP4Context() {}
-};
-
-#define fcMP4EachFunctions(Body)\
-    Body(fcMP4SetModulePathImpl)\
-    Body(fcMP4SetFAACPackagePathImpl)\
-    Body(fcMP4DownloadCodecBeginImpl)\
-    Body(fcMP4DownloadCodecGetStateImpl)\
-    Body(fcMP4CreateContextImpl)\
-    Body(fcMP4OSCreateContextImpl)
-
-void            fcMP4SetModulePathImpl(const char *path);
-fcIMP4Context*  fcMP4CreateContextImpl(fcMP4Config &conf, fcIGraphicsDevice*);
-fcIMP4Context*  fcMP4OSCreateContextImpl(fcMP4Config &conf, fcIGraphicsDevice *dev, const char *path);
+﻿#pragma once
+
+class fcIMP4Context
+{
+public:
+    virtual void release() = 0;
+    virtual bool isValid() const = 0;
+
+    virtual const char* getVideoEncoderInfo() = 0;
+    virtual const char* getAudioEncoderInfo() = 0;
+
+    virtual void addOutputStream(fcStream *s) = 0;
+
+    // encoded H.264 (Annex B) and AAC frames are also written to video / audio as they are. either can be null.
+    // call before adding frames.
+    virtual void addElementaryStreamTap(fcStream *video, fcStream *audio) = 0;
+
+    // assume texture format is RGBA8.
+    // timestamp=-1 is treated as current time.
+    virtual bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp = -1) = 0;
+
+    // any packed format, or fcPixelFormat_I420 / fcPixelFormat_NV12 which go to the encoder without color conversion.
+    // timestamp=-1 is treated as current time.
+    virtual bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1) = 0;
+
+    // timestamp=-1 is treated as current time.
+    virtual bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp = -1) = 0;
+
+    // crop / flip / resize applied to addVideoFramePixels() input. nullptr disables it.
+    virtual void setPixelTransform(const fcPixelTransform *t) = 0;
+
+protected:
+    virtual ~fcIMP4Context() {}
+};
+
+#define fcMP4EachFunctions(Body)\
+    Body(fcMP4SetModulePathImpl)\
+    Body(fcMP4SetFAACPackagePathImpl)\
+    Body(fcMP4DownloadCodecBeginImpl)\
+    Body(fcMP4DownloadCodecGetStateImpl)\
+    Body(fcMP4CreateContextImpl)\
+    Body(fcMP4ProbeEncodersImpl)\
+    Body(fcMP4OSCreateContextImpl)
+
+void            fcMP4SetModulePathImpl(const char *path);
+fcIMP4Context*  fcMP4CreateContextImpl(fcMP4Config &conf, fcIGraphicsDevice*);
+void            fcMP4ProbeEncodersImpl(const fcMP4Config &conf, fcIGraphicsDevice*);
+fcIMP4Context*  fcMP4OSCreateContextImpl(fcMP4Config &conf, fcIGraphicsDevice *dev, const char *path);
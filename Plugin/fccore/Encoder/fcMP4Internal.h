@@ -1,24 +1,45 @@
-#pragma once
-
-
-struct fcMP4FrameInfo
-{
-    size_t size = 0;
-    uint64_t file_offset = 0;
-    uint64_t timestamp = 0;
-};
-
-struct fcMP4OffsetValue
-{
-    uint32_t count = 0;
-    uint32_t value = 0;
-};
-
-struct fcMP4SampleToChunk
-{
-    uint32_t first_chunk_ID = 0;
-    uint32_t samples_per_chunk = 0;
-    uint32_t sample_description_ID = 0;
-};
-
-const std::string& fcMP4GetModulePath();
+#pragma once
+
+
+struct fcMP4OffsetValue
+{
+    uint32_t count = 0;
+    uint32_t value = 0;
+};
+
+struct fcMP4SampleToChunk
+{
+    uint32_t first_chunk_ID = 0;
+    uint32_t samples_per_chunk = 0;
+    uint32_t sample_description_ID = 0;
+};
+
+// sample tables of one track, built as samples are added.
+// only the size is kept per sample. decode times and samples-per-chunk are run-length encoded and chunks are runs of
+// samples that are contiguous in the file, so a constant framerate track costs 4 bytes per sample plus 8 per chunk.
+class fcMP4SampleTable
+{
+public:
+    // timestamp: decode time in the track's time scale. it is clamped so that it never goes backwards.
+    void addSample(uint64_t file_offset, uint32_t size, uint64_t timestamp);
+    // closes the last chunk and gives the last sample its duration (0: same as the sample before it).
+    // call once after the last sample. returns the duration of the track.
+    uint64_t finish(uint32_t last_duration);
+    size_t getNumSamples() const { return sizes.size(); }
+
+    RawVector<uint32_t> sizes;                      // stsz
+    RawVector<fcMP4OffsetValue> decode_times;       // stts
+    RawVector<fcMP4SampleToChunk> samples_to_chunk; // stsc
+    RawVector<uint64_t> chunks;                     // stco / co64
+
+private:
+    void addDuration(uint64_t duration);
+    void closeChunk();
+
+    uint64_t m_last_timestamp = 0;
+    uint64_t m_chunk_end = 0;
+    uint32_t m_chunk_samples = 0;
+    uint64_t m_duration = 0;
+};
+
+std::string fcMP4GetModulePath();
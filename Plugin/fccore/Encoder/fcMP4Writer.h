@@ -1,30 +1,51 @@
-#pragma once
-
-
-class fcMP4Writer
-{
-public:
-    fcMP4Writer(BinaryStream &stream, const fcMP4Config &conf);
-    virtual ~fcMP4Writer();
-    void addVideoFrame(const fcH264Frame& frame); // thread safe
-    void addAudioFrame(const fcAACFrame& frame); // thread safe
-    void setAACEncoderInfo(const Buffer& aacheader);
-
-private:
-    void mp4Begin();
-    void mp4End();
-
-private:
-    BinaryStream& m_stream;
-    fcMP4Config m_conf;
-    std::mutex m_mutex;
-    RawVector<fcMP4FrameInfo> m_video_frame_info;
-    RawVector<fcMP4FrameInfo> m_audio_frame_info;
-    RawVector<u8> m_pps;
-    RawVector<u8> m_sps;
-    RawVector<u32> m_iframe_ids;
-    RawVector<u8> m_audio_encoder_info;
-
-    size_t m_mdat_begin;
-    size_t m_mdat_end;
-};
+#pragma once
+
+
+class fcMP4Writer
+{
+public:
+    fcMP4Writer(BinaryStream &stream, const fcMP4Config &conf);
+    virtual ~fcMP4Writer();
+    void addVideoFrame(const fcH264Frame& frame); // thread safe
+    void addAudioFrame(const fcAACFrame& frame); // thread safe
+    void setAACEncoderInfo(const Buffer& aacheader);
+
+private:
+    // samples waiting to be written as one chunk (see fcMP4Config::chunk_duration)
+    struct PendingChunk
+    {
+        Buffer data;
+        BufferStream stream;
+        RawVector<u32> sizes;
+        RawVector<u64> timestamps; // in the track's time scale
+        double begin = 0.0;        // time of the first sample in seconds
+
+        PendingChunk() : stream(data) {}
+    };
+
+    void mp4Begin();
+    void mp4End();
+    // returns the stream the sample starting at time t is written to. the pending chunk is written out first if the sample
+    // doesn't belong to it anymore.
+    BinaryStream& beginSample(fcMP4SampleTable& table, PendingChunk& chunk, double t);
+    void endSample(fcMP4SampleTable& table, PendingChunk& chunk, u64 file_offset, u32 size, u64 timestamp);
+    void flushChunk(fcMP4SampleTable& table, PendingChunk& chunk);
+
+private:
+    BinaryStream& m_stream;
+    fcMP4Config m_conf;
+    std::mutex m_mutex;
+    fcMP4SampleTable m_video_samples;
+    fcMP4SampleTable m_audio_samples;
+    PendingChunk m_video_chunk;
+    PendingChunk m_audio_chunk;
+    RawVector<u8> m_pps;
+    RawVector<u8> m_sps;
+    RawVector<u32> m_iframe_ids;
+    RawVector<u8> m_audio_encoder_info;
+    u64 m_audio_clock = 0;          // samples per channel written so far (sample clock)
+    u32 m_audio_frame_duration = 0; // duration of the last audio packet in samples
+
+    size_t m_mdat_begin;
+    size_t m_mdat_end;
+};
@@ -1,94 +1,206 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "Foundation/fcFoundation.h"
-#include "fcOggContext.h"
-
-#ifdef fcSupportVorbis
-#include "vorbis/vorbisenc.h"
-#include "fcVorbisEncoder.h"
-
-class fcOggWriter
-{
-public:
-    fcOggWriter(fcStream *s);
-    ~fcOggWriter();
-    void write(ogg_packet& packet);
-    void flush();
-    void pageOut();
-
-private:
-    fcStream *m_stream = nullptr;
+#include "pch.h"
+#include "fcInternal.h"
+#include "Foundation/fcFoundation.h"
+#include "fcOggContext.h"
+
+#ifdef fcSupportVorbis
+#include "ogg/ogg.h"
+#include "fcVorbisEncoder.h"
+
+
+// Ogg container. Vorbis and Opus headers are taken from the encoder's codec private data.
+class fcOggWriter : public fcIAudioPacketSink
+{
+public:
+    fcOggWriter(fcStream *s);
+    ~fcOggWriter() override;
+    void setAudioEncoderInfo(const fcIVorbisEncoder& encoder) override;
+    void addAudioFrame(const fcVorbisFrame& frame) override;
+    void finishAudio() override;
+
+private:
+    void write(const char *data, size_t size, int64_t granule, bool bos, bool eos);
+    // the last audio packet is held back until the next one arrives so that it can be flagged as the end of the stream
+    void writePending(bool eos);
+    void flush();
+    void pageOut();
+
+    fcStream *m_stream = nullptr;
     ogg_stream_state m_ogstream;
     ogg_page         m_ogpage;
-    ogg_packet       m_ogpacket;
-
-};
-using fcOggWriterPtr = std::unique_ptr<fcOggWriter>;
-
-
-class fcOggContext : public fcIOggContext
-{
-public:
-    using AudioBuffer = RawVector<float>;
-    using AudioBufferPtr = std::shared_ptr<AudioBuffer>;
-    using AudioBufferQueue = ResourceQueue<AudioBufferPtr>;
-
-    fcOggContext(const fcOggConfig& conf);
-    virtual ~fcOggContext() override;
-    virtual void release()  override;
-    virtual void addOutputStream(fcStream *s) override;
-    virtual bool write(const float *samples, int num_samples, fcTime timestamp) override;
-
-    void pageOut();
-
-private:
-    fcOggConfig m_conf;
-    std::vector<fcOggWriterPtr> m_writers;
-
-    TaskQueue           m_tasks;
-    AudioBufferQueue    m_buffers;
-
-    vorbis_info         m_vo_info;
-    vorbis_comment      m_vo_comment;
-    vorbis_dsp_state    m_vo_dsp;
-    vorbis_block        m_vo_block;
-    ogg_packet          m_og_header;
-    ogg_packet          m_og_header_comm;
-    ogg_packet          m_og_header_code;
-};
-
-
-
-fcOggWriter::fcOggWriter(fcStream *s)
-    : m_stream(s)
-{
-    static int s_serial = 0;
-    ogg_stream_init(&m_ogstream, s_serial++);
-}
-
-fcOggWriter::~fcOggWriter()
-{
-    ogg_stream_clear(&m_ogstream);
-}
-
-void fcOggWriter::write(ogg_packet& packet)
-{
+    ogg_int64_t      m_packetno = 0;
+
+    Buffer           m_pending;
+    int64_t          m_pending_granule = 0;
+    bool             m_has_pending = false;
+};
+
+
+// raw packet stream: records of [uint32 size][int64 granule][size bytes], little endian.
+// the first record is the codec private data (Vorbis: Xiph-laced header packets, Opus: OpusHead) with granule -1.
+class fcAudioPacketWriter : public fcIAudioPacketSink
+{
+public:
+    fcAudioPacketWriter(fcStream *s);
+    void setAudioEncoderInfo(const fcIVorbisEncoder& encoder) override;
+    void addAudioFrame(const fcVorbisFrame& frame) override;
+
+private:
+    void write(const char *data, uint32_t size, int64_t granule);
+
+    fcStream *m_stream = nullptr;
+};
+
+
+class fcOggContext : public fcIOggContext
+{
+public:
+    using AudioBuffer = RawVector<float>;
+    using AudioBufferPtr = std::shared_ptr<AudioBuffer>;
+    using AudioBufferQueue = ResourceQueue<AudioBufferPtr>;
+    using EncoderPtr = std::unique_ptr<fcIVorbisEncoder>;
+    using SinkPtr = std::unique_ptr<fcIAudioPacketSink>;
+
+    fcOggContext(const fcOggConfig& conf);
+    ~fcOggContext() override;
+    void release()  override;
+    const fcOggConfig& getConfig() const override;
+    void addOutputStream(fcStream *s) override;
+    void addPacketStream(fcStream *s) override;
+    bool addPacketSink(fcIAudioPacketSink *sink) override;
+    bool write(const float *samples, int num_samples, fcTime timestamp) override;
+
+    bool isValid() const;
+    // passes packets in m_frame to all sinks
+    void emitFrame();
+
+private:
+    fcOggConfig m_conf;
+    StatsCollector m_stats;
+    EncoderPtr m_encoder;
+    fcVorbisFrame m_frame;
+
+    std::vector<std::unique_ptr<StatsStream>> m_streams; // output streams wrapped for m_stats. outlive m_writers
+    std::vector<SinkPtr> m_writers; // owned: Ogg and raw packet streams. accessed on the caller thread only
+    std::vector<fcIAudioPacketSink*> m_sinks; // all outputs. accessed on m_tasks only
+
+    TaskQueue           m_tasks;
+    AudioBufferQueue    m_buffers;
+};
+
+
+
+fcOggWriter::fcOggWriter(fcStream *s)
+    : m_stream(s)
+{
+    static int s_serial = 0;
+    ogg_stream_init(&m_ogstream, s_serial++);
+}
+
+fcOggWriter::~fcOggWriter()
+{
+    ogg_stream_clear(&m_ogstream);
+}
+
+void fcOggWriter::setAudioEncoderInfo(const fcIVorbisEncoder& encoder)
+{
+    const auto& cp = encoder.getCodecPrivate();
+    if (cp.empty()) { return; }
+    if (strcmp(encoder.getMatroskaCodecID(), "A_OPUS") == 0) {
+        // OpusHead and OpusTags. each must be on its own page (RFC 7845 section 3).
+        write(cp.data(), cp.size(), 0, true, false);
+        flush();
+
+        static const char vendor[] = "FrameCapturer";
+        uint32_t vendor_len = sizeof(vendor) - 1;
+        Buffer tags;
+        tags.append("OpusTags", 8);
+        for (int i = 0; i < 4; ++i) { tags.push_back((char)((vendor_len >> (i * 8)) & 0xff)); }
+        tags.append(vendor, vendor_len);
+        for (int i = 0; i < 4; ++i) { tags.push_back(0); } // no user comments
+        write(tags.data(), tags.size(), 0, false, false);
+        flush();
+    }
+    else {
+        // Vorbis: unlace identification, comment and setup headers.
+        // the identification header must be alone on the first page, and the setup header must end a page.
+        auto *it = (const uint8_t*)cp.data();
+        auto *end = it + cp.size();
+        int num_packets = *it++ + 1;
+        std::vector<size_t> sizes;
+        size_t laced = 0;
+        for (int i = 0; i < num_packets - 1; ++i) {
+            size_t size = 0;
+            while (it < end && *it == 255) { size += *it++; }
+            if (it < end) { size += *it++; }
+            sizes.push_back(size);
+            laced += size;
+        }
+        if (laced > size_t(end - it)) {
+            fcDebugLog("fcOggWriter::setAudioEncoderInfo(): broken codec private data\n");
+            return;
+        }
+        sizes.push_back(size_t(end - it) - laced);
+
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            write((const char*)it, sizes[i], 0, i == 0, false);
+            it += sizes[i];
+            if (i == 0 || i + 1 == sizes.size()) {
+                flush();
+            }
+        }
+    }
+}
+
+void fcOggWriter::addAudioFrame(const fcVorbisFrame& frame)
+{
+    frame.eachPackets([&](const char *data, const fcVorbisFrame::PacketInfo& pinfo) {
+        writePending(false);
+        m_pending.assign(data, pinfo.size);
+        m_pending_granule = pinfo.granule;
+        m_has_pending = true;
+    });
+    pageOut();
+}
+
+void fcOggWriter::finishAudio()
+{
+    writePending(true);
+    flush();
+}
+
+void fcOggWriter::write(const char *data, size_t size, int64_t granule, bool bos, bool eos)
+{
+    ogg_packet packet = {};
+    packet.packet = (unsigned char*)data;
+    packet.bytes = (long)size;
+    packet.b_o_s = bos ? 1 : 0;
+    packet.e_o_s = eos ? 1 : 0;
+    packet.granulepos = granule;
+    packet.packetno = m_packetno++;
     ogg_stream_packetin(&m_ogstream, &packet);
-}
-
-void fcOggWriter::flush()
-{
+}
+
+void fcOggWriter::writePending(bool eos)
+{
+    if (!m_has_pending) { return; }
+    write(m_pending.data(), m_pending.size(), m_pending_granule, false, eos);
+    m_has_pending = false;
+}
+
+void fcOggWriter::flush()
+{
     for (;;) {
         int result = ogg_stream_flush(&m_ogstream, &m_ogpage);
         if (result == 0)break;
         m_stream->write(m_ogpage.header, m_ogpage.header_len);
         m_stream->write(m_ogpage.body, m_ogpage.body_len);
     }
-}
-
-void fcOggWriter::pageOut()
-{
-    bool eos = false;
+}
+
+void fcOggWriter::pageOut()
+{
+    bool eos = false;
     while (!eos) {
         int result = ogg_stream_pageout(&m_ogstream, &m_ogpage);
         if (result == 0)break;
@@ -97,120 +209,167 @@ void fcOggWriter::pageOut()
 
         if (ogg_page_eos(&m_ogpage))eos = true;
     }
-}
-
-
-
-fcOggContext::fcOggContext(const fcOggConfig& conf)
-    : m_conf(conf)
-{
-    vorbis_info_init(&m_vo_info);
-    switch (conf.bitrate_mode) {
-    case fcCBR:
-        vorbis_encode_init(&m_vo_info, conf.num_channels, conf.sample_rate, conf.target_bitrate, conf.target_bitrate, conf.target_bitrate);
-        break;
-    case fcVBR:
-        vorbis_encode_init(&m_vo_info, conf.num_channels, conf.sample_rate, -1, conf.target_bitrate, -1);
-        break;
-    }
-    vorbis_comment_init(&m_vo_comment);
-    vorbis_analysis_init(&m_vo_dsp, &m_vo_info);
-    vorbis_block_init(&m_vo_dsp, &m_vo_block);
-    vorbis_analysis_headerout(&m_vo_dsp, &m_vo_comment, &m_og_header, &m_og_header_comm, &m_og_header_code);
-
-    for (int i = 0; i < 8; ++i) {
-        m_buffers.push(AudioBufferPtr(new AudioBuffer()));
-    }
-}
-
-
-fcOggContext::~fcOggContext()
-{
-    m_tasks.run([this]() {
-        if (vorbis_analysis_wrote(&m_vo_dsp, 0) == 0) {
-            pageOut();
-        }
-    });
-    m_tasks.wait();
-    m_writers.clear();
-
-    vorbis_block_clear(&m_vo_block);
-    vorbis_dsp_clear(&m_vo_dsp);
-    vorbis_comment_clear(&m_vo_comment);
-    vorbis_info_clear(&m_vo_info);
-}
-
-void fcOggContext::release()
-{
-    delete this;
-}
-
-void fcOggContext::addOutputStream(fcStream *s)
-{
-    auto writer = new fcOggWriter(s);
-    writer->write(m_og_header);
-    writer->write(m_og_header_comm);
-    writer->write(m_og_header_code);
-    writer->flush();
-    m_writers.emplace_back(writer);
-}
-
-bool fcOggContext::write(const float *samples, int num_samples, fcTime timestamp)
-{
-    if (!samples || num_samples == 0) { return false; }
-
-    auto buf = m_buffers.pop();
-    buf->assign(samples, num_samples);
-
-    m_tasks.run([this, buf]() {
-        int num_channels = m_conf.num_channels;
-        int num_samples = (int)buf->size();
-        const float *samples = buf->data();
-
-        int block_size = (int)num_samples / num_channels;
-        float **buffer = vorbis_analysis_buffer(&m_vo_dsp, block_size);
-        for (int bi = 0; bi < block_size; bi += num_channels) {
-            for (int ci = 0; ci < num_channels; ++ci) {
-                buffer[ci][bi] = samples[bi*num_channels + ci];
-            }
-        }
-        if (vorbis_analysis_wrote(&m_vo_dsp, block_size) == 0) {
-            pageOut();
-        }
-
-        m_buffers.push(buf);
-    });
-
-    return true;
-}
-
-void fcOggContext::pageOut()
-{
-    while (vorbis_analysis_blockout(&m_vo_dsp, &m_vo_block) == 1) {
-        vorbis_analysis(&m_vo_block, nullptr);
-        vorbis_bitrate_addblock(&m_vo_block);
-
-        ogg_packet packet;
-        while (vorbis_bitrate_flushpacket(&m_vo_dsp, &packet) == 1) {
-            for (auto& w : m_writers) {
-                w->write(packet);
-                w->pageOut();
-            }
-        }
-    }
-}
-
-
-fcIOggContext* fcOggCreateContextImpl(const fcOggConfig *conf)
-{
-    return new fcOggContext(*conf);
-}
-
-#else // fcSupportVorbis
-
-fcIOggContext* fcOggCreateContextImpl(const fcOggConfig *conf)
-{
-    return nullptr;
-}
-
-#endif // fcSupportVorbis
+}
+
+
+
+fcAudioPacketWriter::fcAudioPacketWriter(fcStream *s)
+    : m_stream(s)
+{
+}
+
+void fcAudioPacketWriter::setAudioEncoderInfo(const fcIVorbisEncoder& encoder)
+{
+    const auto& cp = encoder.getCodecPrivate();
+    write(cp.data(), (uint32_t)cp.size(), -1);
+}
+
+void fcAudioPacketWriter::addAudioFrame(const fcVorbisFrame& frame)
+{
+    frame.eachPackets([&](const char *data, const fcVorbisFrame::PacketInfo& pinfo) {
+        write(data, pinfo.size, pinfo.granule);
+    });
+}
+
+void fcAudioPacketWriter::write(const char *data, uint32_t size, int64_t granule)
+{
+    m_stream->write(&size, sizeof(size));
+    m_stream->write(&granule, sizeof(granule));
+    m_stream->write(data, size);
+}
+
+
+
+fcOggContext::fcOggContext(const fcOggConfig& conf)
+    : m_conf(conf)
+    , m_stats(static_cast<fcIOggContext*>(this))
+{
+    for (int i = 0; i < 8; ++i) {
+        m_buffers.push(AudioBufferPtr(new AudioBuffer()));
+    }
+
+    fcVorbisEncoderConfig econf;
+    econf.sample_rate = conf.sample_rate;
+    econf.num_channels = conf.num_channels;
+    econf.bitrate_mode = conf.bitrate_mode;
+    econf.target_bitrate = conf.target_bitrate;
+    switch (conf.encoder) {
+    case fcOggAudioEncoder::Vorbis:
+        m_encoder.reset(fcCreateVorbisEncoder(econf));
+        break;
+    case fcOggAudioEncoder::Opus:
+        m_encoder.reset(fcCreateOpusEncoder(econf));
+        break;
+    }
+}
+
+fcOggContext::~fcOggContext()
+{
+    if (m_encoder) {
+        m_tasks.run([this]() {
+            if (m_encoder->flush(m_frame)) {
+                emitFrame();
+            }
+            for (auto *sink : m_sinks) {
+                sink->finishAudio();
+            }
+        });
+    }
+    m_tasks.wait();
+    m_writers.clear();
+}
+
+void fcOggContext::release()
+{
+    delete this;
+}
+
+const fcOggConfig& fcOggContext::getConfig() const
+{
+    return m_conf;
+}
+
+bool fcOggContext::isValid() const
+{
+    return m_encoder != nullptr;
+}
+
+void fcOggContext::addOutputStream(fcStream *s)
+{
+    m_streams.emplace_back(new StatsStream(*s, m_stats));
+    auto *writer = new fcOggWriter(m_streams.back().get());
+    m_writers.emplace_back(writer);
+    addPacketSink(writer);
+}
+
+void fcOggContext::addPacketStream(fcStream *s)
+{
+    m_streams.emplace_back(new StatsStream(*s, m_stats));
+    auto *writer = new fcAudioPacketWriter(m_streams.back().get());
+    m_writers.emplace_back(writer);
+    addPacketSink(writer);
+}
+
+bool fcOggContext::addPacketSink(fcIAudioPacketSink *sink)
+{
+    if (!sink) { return false; }
+
+    // headers are written on the encoder thread, in order with the packets
+    m_tasks.run([this, sink]() {
+        sink->setAudioEncoderInfo(*m_encoder);
+        m_sinks.push_back(sink);
+    });
+    return true;
+}
+
+bool fcOggContext::write(const float *samples, int num_samples, fcTime timestamp)
+{
+    if (!samples || num_samples == 0) { return false; }
+
+    auto buf = m_stats.popBuffer(m_buffers);
+    buf->assign(samples, num_samples);
+
+    m_stats.enqueue(StatsCollector::Queue::Audio);
+    m_tasks.run([this, buf, timestamp]() {
+        bool ret;
+        {
+            StatsScope scope(m_stats, fcStatsStage_AudioEncode);
+            ret = m_encoder->encode(m_frame, buf->data(), buf->size(), timestamp);
+        }
+        if (ret) {
+            emitFrame();
+        }
+        m_buffers.push(buf);
+        m_stats.dequeue(StatsCollector::Queue::Audio);
+    });
+    return true;
+}
+
+void fcOggContext::emitFrame()
+{
+    StatsScope scope(m_stats, fcStatsStage_Mux);
+    for (auto *sink : m_sinks) {
+        sink->addAudioFrame(m_frame);
+    }
+    m_frame.clear();
+}
+
+
+fcIOggContext* fcOggCreateContextImpl(const fcOggConfig *conf)
+{
+    auto *ret = new fcOggContext(*conf);
+    if (!ret->isValid()) {
+        ret->release();
+        ret = nullptr;
+    }
+    return ret;
+}
+
+#else // fcSupportVorbis
+
+fcIOggContext* fcOggCreateContextImpl(const fcOggConfig *conf)
+{
+    return nullptr;
+}
+
+#endif // fcSupportVorbis
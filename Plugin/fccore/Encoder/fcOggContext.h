@@ -1,12 +1,19 @@
-#pragma once
-
-class fcIOggContext
-{
-public:
-    virtual void release() = 0;
-    virtual void addOutputStream(fcStream *s) = 0;
-    virtual bool write(const float *samples, int num_samples, fcTime timestamp = -1.0) = 0;
-protected:
-    virtual ~fcIOggContext() {}
-};
-fcIOggContext* fcOggCreateContextImpl(const fcOggConfig *conf);
+#pragma once
+
+class fcIAudioPacketSink;
+
+class fcIOggContext
+{
+public:
+    virtual void release() = 0;
+    virtual const fcOggConfig& getConfig() const = 0;
+    virtual void addOutputStream(fcStream *s) = 0;
+    // raw encoded packets (see fcOggAddPacketStream())
+    virtual void addPacketStream(fcStream *s) = 0;
+    // encoded packets also go to sink. sink is not owned and must outlive the context.
+    virtual bool addPacketSink(fcIAudioPacketSink *sink) = 0;
+    virtual bool write(const float *samples, int num_samples, fcTime timestamp = -1.0) = 0;
+protected:
+    virtual ~fcIOggContext() {}
+};
+fcIOggContext* fcOggCreateContextImpl(const fcOggConfig *conf);
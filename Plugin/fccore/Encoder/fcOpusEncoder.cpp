@@ -1,110 +1,197 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "Foundation/fcFoundation.h"
-#include "GraphicsDevice/fcGraphicsDevice.h"
-#include "fcVorbisEncoder.h"
-
-#ifdef fcSupportOpus
-
-#include "opus/opus.h"
-#ifdef _MSC_VER
-    #pragma comment(lib, "opus.lib")
-    #pragma comment(lib, "celt.lib")
-    #pragma comment(lib, "silk_common.lib")
-    #pragma comment(lib, "silk_float.lib")
-#endif // _MSC_VER
-
-
-class fcOpusEncoder : public fcIVorbisEncoder
-{
-public:
-    fcOpusEncoder(const fcOpusEncoderConfig& conf);
-    ~fcOpusEncoder() override;
-    void release() override;
-    const char* getMatroskaCodecID() const override;
-    const Buffer& getCodecPrivate() const override;
-
-    bool encode(fcVorbisFrame& dst, const float *samples, size_t num_samples) override;
-    bool flush(fcVorbisFrame& dst) override;
-
-private:
-    fcOpusEncoderConfig m_conf;
-    Buffer m_codec_private;
-    RawVector<float> m_samples;
-    Buffer m_buf_encoded;
-
-    OpusEncoder *m_op_encoder = nullptr;
-};
-
-
-fcOpusEncoder::fcOpusEncoder(const fcOpusEncoderConfig& conf)
-    : m_conf(conf)
-{
-    int err;
-    m_op_encoder = opus_encoder_create(conf.sample_rate, conf.num_channels, OPUS_APPLICATION_RESTRICTED_LOWDELAY, &err);
-    opus_encoder_ctl(m_op_encoder, OPUS_SET_BITRATE(conf.target_bitrate));
-}
-
-fcOpusEncoder::~fcOpusEncoder()
-{
-    opus_encoder_destroy(m_op_encoder);
-}
-
-void fcOpusEncoder::release()
-{
-    delete this;
-}
-
-const char* fcOpusEncoder::getMatroskaCodecID() const
-{
-    return "A_OPUS";
-}
-
-const Buffer& fcOpusEncoder::getCodecPrivate() const
-{
-    return m_codec_private;
-}
-
-bool fcOpusEncoder::encode(fcVorbisFrame& dst, const float *samples, size_t num_samples)
-{
-    if (!m_op_encoder || !samples) { return false; }
-
-    return false;
-    // todo: implement
-
-    //m_samples.append(samples, num_samples);
-
-    //int block_size = m_conf.sample_rate * m_conf.num_channels / 10;
-    //int processed_size = 0;
-    //m_buf_encoded.resize(block_size);
-    //while (processed_size + block_size <= num_samples) {
-    //    auto n = opus_encode_float(m_op_encoder,
-    //        m_samples.data() + processed_size, block_size / m_conf.num_channels,
-    //        (uint8_t*)m_buf_encoded.data(), (int)m_buf_encoded.size());
-    //    if (n > 0) {
-    //        m_buf_encoded.resize(n);
-    //        dst.data.append(m_buf_encoded.data(), m_buf_encoded.size());
-    //    }
-    //    else if (n == 0) {
-    //        break;
-    //    }
-    //    else {
-    //        return false;
-    //    }
-    //}
-    //return true;
-}
-
-bool fcOpusEncoder::flush(fcVorbisFrame& dst)
-{
-    return true;
-}
-
-
-fcIVorbisEncoder* fcCreateOpusEncoder(const fcOpusEncoderConfig& conf) { return new fcOpusEncoder(conf); }
-
-#else // fcSupportOpus
-
-fcIVorbisEncoder* fcCreateOpusEncoder(const fcOpusEncoderConfig& conf) { return nullptr; }
-
-#endif // fcSupportOpus
+#include "pch.h"
+#include "fcInternal.h"
+#include "Foundation/fcFoundation.h"
+#include "GraphicsDevice/fcGraphicsDevice.h"
+#include "fcVorbisEncoder.h"
+
+#ifdef fcSupportOpus
+
+#include "opus/opus.h"
+#ifdef _MSC_VER
+    #pragma comment(lib, "opus.lib")
+    #pragma comment(lib, "celt.lib")
+    #pragma comment(lib, "silk_common.lib")
+    #pragma comment(lib, "silk_float.lib")
+#endif // _MSC_VER
+
+
+class fcOpusEncoder : public fcIVorbisEncoder
+{
+public:
+    fcOpusEncoder(const fcOpusEncoderConfig& conf);
+    ~fcOpusEncoder() override;
+    void release() override;
+    const char* getMatroskaCodecID() const override;
+    const Buffer& getCodecPrivate() const override;
+    uint64_t getCodecDelay() const override;
+
+    bool encode(fcVorbisFrame& dst, const float *samples, size_t num_samples, fcTime timestamp) override;
+    bool flush(fcVorbisFrame& dst) override;
+
+    bool isValid() const { return m_op_encoder != nullptr; }
+
+private:
+    bool encodeFrames(fcVorbisFrame& dst);
+
+    fcOpusEncoderConfig m_conf;
+    Buffer m_codec_private;
+    std::unique_ptr<AudioReframer<float>> m_reframer;
+    Buffer m_buf_encoded;
+
+    OpusEncoder *m_op_encoder = nullptr;
+    int m_frame_size = 0;       // samples per channel of one 20 ms frame
+    int m_pre_skip = 0;         // encoder look-ahead in 48 kHz samples
+    uint64_t m_input_samples = 0;   // samples per channel given to encode()
+};
+
+
+// Opus always runs its granule clock at 48 kHz regardless of the input rate
+static const int OpusGranuleRate = 48000;
+// 20 ms frames: the best tradeoff between latency and compression recommended by the Opus documentation
+static const int OpusFramesPerSecond = 50;
+// max size of one encoded packet (recommended by opus_encode())
+static const int OpusMaxPacketSize = 4000;
+
+fcOpusEncoder::fcOpusEncoder(const fcOpusEncoderConfig& conf)
+    : m_conf(conf)
+{
+    switch (conf.sample_rate) {
+    case 8000: case 12000: case 16000: case 24000: case 48000: break;
+    default:
+        fcDebugLog("fcOpusEncoder::fcOpusEncoder(): unsupported sample rate %d (must be 8000, 12000, 16000, 24000 or 48000)\n", conf.sample_rate);
+        return;
+    }
+    if (conf.num_channels < 1 || conf.num_channels > 2) {
+        fcDebugLog("fcOpusEncoder::fcOpusEncoder(): unsupported channel count %d (must be 1 or 2)\n", conf.num_channels);
+        return;
+    }
+
+    int err;
+    m_op_encoder = opus_encoder_create(conf.sample_rate, conf.num_channels, OPUS_APPLICATION_AUDIO, &err);
+    if (err != OPUS_OK || !m_op_encoder) {
+        fcDebugLog("fcOpusEncoder::fcOpusEncoder(): opus_encoder_create() failed (%d)\n", err);
+        m_op_encoder = nullptr;
+        return;
+    }
+    opus_encoder_ctl(m_op_encoder, OPUS_SET_BITRATE(conf.target_bitrate));
+    opus_encoder_ctl(m_op_encoder, OPUS_SET_VBR(conf.bitrate_mode == fcVBR ? 1 : 0));
+
+    m_frame_size = conf.sample_rate / OpusFramesPerSecond;
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(m_op_encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    m_pre_skip = (int)lookahead * (OpusGranuleRate / conf.sample_rate);
+    m_buf_encoded.resize(OpusMaxPacketSize);
+    m_reframer.reset(new AudioReframer<float>(conf.num_channels, m_frame_size,
+        [](float *dst, const float *src, size_t num) { memcpy(dst, src, sizeof(float) * num); }));
+
+    {
+        // OpusHead (RFC 7845 section 5.1). used as Matroska CodecPrivate and as the first Ogg packet.
+        m_codec_private.resize(19);
+        auto *p = (uint8_t*)m_codec_private.data();
+        memcpy(p, "OpusHead", 8);
+        p[8] = 1; // version
+        p[9] = (uint8_t)conf.num_channels;
+        p[10] = (uint8_t)(m_pre_skip & 0xff);
+        p[11] = (uint8_t)((m_pre_skip >> 8) & 0xff);
+        uint32_t rate = (uint32_t)conf.sample_rate;
+        p[12] = (uint8_t)(rate & 0xff);
+        p[13] = (uint8_t)((rate >> 8) & 0xff);
+        p[14] = (uint8_t)((rate >> 16) & 0xff);
+        p[15] = (uint8_t)((rate >> 24) & 0xff);
+        p[16] = p[17] = 0; // output gain
+        p[18] = 0; // channel mapping family 0: mono / stereo
+    }
+}
+
+fcOpusEncoder::~fcOpusEncoder()
+{
+    if (m_op_encoder) {
+        opus_encoder_destroy(m_op_encoder);
+    }
+}
+
+void fcOpusEncoder::release()
+{
+    delete this;
+}
+
+const char* fcOpusEncoder::getMatroskaCodecID() const
+{
+    return "A_OPUS";
+}
+
+const Buffer& fcOpusEncoder::getCodecPrivate() const
+{
+    return m_codec_private;
+}
+
+uint64_t fcOpusEncoder::getCodecDelay() const
+{
+    return (uint64_t)m_pre_skip * 1000000000 / OpusGranuleRate;
+}
+
+// encodes all complete frames in m_reframer
+bool fcOpusEncoder::encodeFrames(fcVorbisFrame& dst)
+{
+    int granule_scale = OpusGranuleRate / m_conf.sample_rate;
+    double duration = (double)m_frame_size / (double)m_conf.sample_rate;
+
+    bool ret = true;
+    m_reframer->eachFrames([&](const float *frame, uint64_t position) {
+        auto n = opus_encode_float(m_op_encoder, frame, m_frame_size,
+            (unsigned char*)m_buf_encoded.data(), (opus_int32)m_buf_encoded.size());
+        if (n < 0) {
+            fcDebugLog("fcOpusEncoder::encodeFrames(): opus_encode_float() failed (%d)\n", n);
+            ret = false;
+            return false;
+        }
+        double timestamp = (double)position / (double)m_conf.sample_rate;
+        uint64_t encoded_samples = position + m_frame_size; // including flush padding
+
+        // granule position counts 48 kHz samples decoded so far including pre-skip.
+        // it never exceeds the actual input so that decoders trim the padding of the last frame.
+        int64_t granule = (int64_t)std::min<uint64_t>(encoded_samples * granule_scale, m_input_samples * granule_scale + m_pre_skip);
+        dst.data.append(m_buf_encoded.data(), n);
+        dst.packets.push_back({ (uint32_t)n, duration, timestamp, granule });
+        return true;
+    });
+    return ret;
+}
+
+bool fcOpusEncoder::encode(fcVorbisFrame& dst, const float *samples, size_t num_samples, fcTime /*timestamp*/)
+{
+    if (!m_op_encoder || !samples || num_samples == 0) { return false; }
+
+    // packet timestamps are derived from the sample count like Vorbis granule positions
+    m_reframer->push(samples, num_samples);
+    m_input_samples += num_samples / m_conf.num_channels;
+    return encodeFrames(dst);
+}
+
+bool fcOpusEncoder::flush(fcVorbisFrame& dst)
+{
+    if (!m_op_encoder) { return false; }
+
+    // pad with silence so that the samples still in the encoder's look-ahead come out too
+    size_t pending = m_reframer->getNumPendingSamples() + m_pre_skip / (OpusGranuleRate / m_conf.sample_rate);
+    size_t frames = std::max<size_t>(ceildiv<size_t>(pending, m_frame_size), 1);
+    m_reframer->pad(frames * m_frame_size - m_reframer->getNumPendingSamples());
+    return encodeFrames(dst);
+}
+
+
+fcIVorbisEncoder* fcCreateOpusEncoder(const fcOpusEncoderConfig& conf)
+{
+    auto *ret = new fcOpusEncoder(conf);
+    if (!ret->isValid()) {
+        delete ret;
+        ret = nullptr;
+    }
+    return ret;
+}
+
+#else // fcSupportOpus
+
+fcIVorbisEncoder* fcCreateOpusEncoder(const fcOpusEncoderConfig& conf) { return nullptr; }
+
+#endif // fcSupportOpus
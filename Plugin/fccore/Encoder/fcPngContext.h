@@ -1,13 +1,14 @@
-#pragma once
-
-class fcIPngContext
-{
-public:
-    virtual void release() = 0;
-    virtual bool exportTexture(const char *path, void *tex, int width, int height, fcPixelFormat fmt, int num_channels) = 0;
-    virtual bool exportPixels(const char *path, const void *pixels, int width, int height, fcPixelFormat fmt, int num_channels) = 0;
-protected:
-    virtual ~fcIPngContext() {}
-};
-
+#pragma once
+
+class fcIPngContext
+{
+public:
+    virtual void release() = 0;
+    virtual bool exportTexture(const char *path, void *tex, int width, int height, fcPixelFormat fmt, int num_channels) = 0;
+    virtual bool exportPixels(const char *path, const void *pixels, int width, int height, fcPixelFormat fmt, int num_channels) = 0;
+    virtual void setPixelTransform(const fcPixelTransform *t) = 0;
+protected:
+    virtual ~fcIPngContext() {}
+};
+
 fcIPngContext* fcPngCreateContextImpl(const fcPngConfig *conf, fcIGraphicsDevice *dev);
\ No newline at end of file
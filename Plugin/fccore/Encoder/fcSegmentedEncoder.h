@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Foundation/TaskQueue.h"
+
+
+// parallel encoding for offline (non-realtime) capture.
+// the video stream is split into fixed-length segments and each segment is encoded by its own encoder instance on its own thread.
+// a fresh encoder always starts with a keyframe, so every segment is a closed GOP and the segments can be muxed back to back.
+// encoded frames keep the timestamps the encode tasks give to the encoder and are emitted in stream order by a writer thread.
+// Encoder: fcIVPXEncoder / fcIH264Encoder, Frame: fcVPXFrame / fcH264Frame.
+template<class Encoder, class Frame>
+class fcSegmentedEncoder
+{
+public:
+    using EncoderPtr = std::unique_ptr<Encoder>;
+    using FramePtr = std::unique_ptr<Frame>;
+    // creates the encoder of a new segment. returning nullptr drops the frames of that segment.
+    using CreateEncoder = std::function<Encoder*()>;
+    // receives encoded frames in stream order. called on the writer thread.
+    using EmitFrame = std::function<void(Frame&)>;
+    // encodes one frame into dst. called on the segment's thread.
+    using EncodeTask = std::function<bool(Encoder& encoder, Frame& dst)>;
+    // called on the segment's thread once the frame is done with, whether it was encoded or dropped.
+    using ReleaseTask = std::function<void()>;
+
+    // max_frames: raw frames handed to encode() and not yet encoded. encode() waits for an encoder to take one beyond that.
+    fcSegmentedEncoder(int segment_frames, int max_segments, int max_frames, const CreateEncoder& create, const EmitFrame& emit)
+        : m_segment_frames(std::max<int>(segment_frames, 1))
+        , m_max_segments(std::max<int>(max_segments, 1))
+        , m_max_frames(std::max<int>(max_frames, 1))
+        , m_create(create)
+        , m_emit(emit)
+    {}
+
+    ~fcSegmentedEncoder()
+    {
+        flush();
+    }
+
+    // max_frames for 0 (auto): what fits in MaxBufferedBytes, at least a frame per segment and no more than all segments can hold.
+    static int getMaxFrames(int max_frames, int segment_frames, int max_segments, size_t frame_size)
+    {
+        static const size_t MaxBufferedBytes = 1024 * 1024 * 1024;
+        int all = std::max<int>(segment_frames, 1) * std::max<int>(max_segments, 1);
+        if (max_frames > 0) { return std::min<int>(max_frames, all); }
+        int fit = (int)std::min<size_t>(MaxBufferedBytes / std::max<size_t>(frame_size, 1), (size_t)all);
+        return std::max<int>(fit, std::max<int>(max_segments, 1));
+    }
+
+    void encode(const EncodeTask& task, const ReleaseTask& release)
+    {
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_cond.wait(l, [this]() { return m_buffered_frames < m_max_frames; });
+            ++m_buffered_frames;
+        }
+
+        if (!m_current || m_current_frames == m_segment_frames) {
+            beginSegment();
+        }
+        ++m_current_frames;
+
+        auto *seg = m_current;
+        seg->tasks.run([this, seg, task, release]() {
+            if (seg->encoder) {
+                FramePtr f(new Frame());
+                if (task(*seg->encoder, *f)) {
+                    seg->frames.push_back(std::move(f));
+                }
+            }
+            release();
+            {
+                std::unique_lock<std::mutex> l(m_mutex);
+                --m_buffered_frames;
+            }
+            m_cond.notify_all();
+        });
+    }
+
+    // closes the current segment and waits all segments. all frames are emitted on return. ends the stream.
+    void flush()
+    {
+        endSegment();
+        m_writer.wait();
+    }
+
+private:
+    struct Segment
+    {
+        EncoderPtr encoder;
+        std::vector<FramePtr> frames;
+        // declared last so that the thread is joined before the encoder is destroyed
+        TaskQueue tasks;
+    };
+    using SegmentPtr = std::unique_ptr<Segment>;
+
+    void beginSegment()
+    {
+        endSegment();
+        {
+            // limit the number of segments in flight (= encoder instances and threads). the writer retires them.
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_cond.wait(l, [this]() { return m_segments.size() < (size_t)m_max_segments; });
+            m_segments.emplace_back(new Segment());
+            m_current = m_segments.back().get();
+        }
+        m_current_frames = 0;
+
+        auto *seg = m_current;
+        auto create = m_create;
+        seg->tasks.run([seg, create]() {
+            seg->encoder.reset(create());
+        });
+    }
+
+    // queues the encoder flush, and the emission of the segment on the writer. segments are emitted in the order they end.
+    void endSegment()
+    {
+        if (!m_current) { return; }
+
+        auto *seg = m_current;
+        seg->tasks.run([seg]() {
+            if (seg->encoder) {
+                FramePtr f(new Frame());
+                if (seg->encoder->flush(*f)) {
+                    seg->frames.push_back(std::move(f));
+                }
+            }
+        });
+        m_current = nullptr;
+
+        m_writer.run([this, seg]() {
+            seg->tasks.wait();
+            for (auto& f : seg->frames) {
+                m_emit(*f);
+            }
+
+            SegmentPtr done;
+            {
+                std::unique_lock<std::mutex> l(m_mutex);
+                done = std::move(m_segments.front());
+                m_segments.pop_front();
+            }
+            m_cond.notify_all();
+        });
+    }
+
+    int m_segment_frames;
+    int m_max_segments;
+    int m_max_frames;
+    CreateEncoder m_create;
+    EmitFrame m_emit;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<SegmentPtr> m_segments;
+    int m_buffered_frames = 0;
+
+    Segment *m_current = nullptr;
+    int m_current_frames = 0;
+
+    // declared last so that the writer is stopped before the segments are destroyed
+    TaskQueue m_writer;
+};
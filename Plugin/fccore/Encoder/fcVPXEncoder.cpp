@@ -1,158 +1,203 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "Foundation/fcFoundation.h"
-#include "GraphicsDevice/fcGraphicsDevice.h"
-#include "fcVPXEncoder.h"
-
-#ifdef fcSupportVPX
-#include "vpx/vpx_encoder.h"
-#include "vpx/vp8cx.h"
-#ifdef _MSC_VER
-    #pragma comment(lib, "vpxmt.lib")
-#endif // _MSC_VER
-
-
-class fcVPXEncoder : public fcIVPXEncoder
-{
-public:
-    fcVPXEncoder(const fcVPXEncoderConfig& conf, fcWebMVideoEncoder encoder);
-    ~fcVPXEncoder() override;
-    void release() override;
-    const char* getMatroskaCodecID() const override;
-
-    bool encode(fcVPXFrame& dst, const void *image, fcPixelFormat fmt, fcTime timestamp, bool force_keyframe) override;
-    bool flush(fcVPXFrame& dst) override;
-
-private:
-    void gatherFrameData(fcVPXFrame& dst);
-
-    fcVPXEncoderConfig  m_conf = {};
-    vpx_codec_iface_t   *m_vpx_iface = nullptr;
-    vpx_codec_ctx_t     m_vpx_ctx = {};
-    vpx_image_t         m_vpx_img = {};
-    const char*         m_matroska_codec_id = nullptr;
-
-    Buffer m_rgba_image;
-    I420Image m_i420_image;
-};
-
-
-fcVPXEncoder::fcVPXEncoder(const fcVPXEncoderConfig& conf, fcWebMVideoEncoder encoder)
-    : m_conf(conf)
-{
-    switch (encoder) {
-    case fcWebMVideoEncoder::VP8:
-        m_matroska_codec_id = "V_VP8";
-        m_vpx_iface = vpx_codec_vp8_cx();
-        break;
-    case fcWebMVideoEncoder::VP9:
-    case fcWebMVideoEncoder::VP9LossLess:
-        m_matroska_codec_id = "V_VP9";
-        m_vpx_iface = vpx_codec_vp9_cx();
-        break;
-    }
-
-    vpx_codec_enc_cfg_t vpx_config;
-    vpx_codec_enc_config_default(m_vpx_iface, &vpx_config, 0);
-    vpx_config.g_w = m_conf.width;
-    vpx_config.g_h = m_conf.height;
-    vpx_config.g_timebase.num = 1;
-    vpx_config.g_timebase.den = 1000000000; // nsec
-    vpx_config.rc_target_bitrate = m_conf.target_bitrate;
-
-    if (encoder != fcWebMVideoEncoder::VP9LossLess) {
-        switch (conf.bitrate_mode) {
-        case fcCBR:
-            vpx_config.rc_end_usage = VPX_CBR;
-            break;
-        case fcVBR:
-            vpx_config.rc_end_usage = VPX_VBR;
-            break;
-        }
-    }
-    vpx_codec_enc_init(&m_vpx_ctx, m_vpx_iface, &vpx_config, 0);
-    if (encoder == fcWebMVideoEncoder::VP9LossLess) {
-        vpx_codec_control_(&m_vpx_ctx, VP9E_SET_LOSSLESS, 1);
-    }
-
-    vpx_img_wrap(&m_vpx_img, VPX_IMG_FMT_I420, m_conf.width, m_conf.height, 2, nullptr);
-}
-
-fcVPXEncoder::~fcVPXEncoder()
-{
-    vpx_codec_destroy(&m_vpx_ctx);
-}
-
-void fcVPXEncoder::release()
-{
-    delete this;
-}
-
-const char* fcVPXEncoder::getMatroskaCodecID() const
-{
-    return m_matroska_codec_id;
-}
-
-
-bool fcVPXEncoder::encode(fcVPXFrame& dst, const void *image, fcPixelFormat fmt, fcTime timestamp, bool force_keyframe)
-{
-    AnyToI420(m_i420_image, m_rgba_image, image, fmt, m_conf.width, m_conf.height);
-    auto data = m_i420_image.data();
-
-    vpx_codec_pts_t vpx_time = to_nsec(timestamp);
-    vpx_enc_frame_flags_t vpx_flags = 0;
-    uint32_t duration = 1000000000 / m_conf.target_framerate;
-    if (force_keyframe) {
-        vpx_flags |= VPX_EFLAG_FORCE_KF;
-    }
-
-    m_vpx_img.planes[VPX_PLANE_Y] = (uint8_t*)data.y;
-    m_vpx_img.planes[VPX_PLANE_U] = (uint8_t*)data.u;
-    m_vpx_img.planes[VPX_PLANE_V] = (uint8_t*)data.v;
-
-    auto res = vpx_codec_encode(&m_vpx_ctx, &m_vpx_img, vpx_time, duration, vpx_flags, 0);
-    if (res != VPX_CODEC_OK) {
-        return false;
-    }
-    gatherFrameData(dst);
-
-    return true;
-}
-
-bool fcVPXEncoder::flush(fcVPXFrame& dst)
-{
-    auto res = vpx_codec_encode(&m_vpx_ctx, nullptr, -1, 0, 0, 0);
-    if (res != VPX_CODEC_OK) {
-        return false;
-    }
-    gatherFrameData(dst);
-
-    return true;
-}
-
-void fcVPXEncoder::gatherFrameData(fcVPXFrame& dst)
-{
-    vpx_codec_iter_t iter = nullptr;
-    const vpx_codec_cx_pkt_t *pkt = nullptr;
-    while ((pkt = vpx_codec_get_cx_data(&m_vpx_ctx, &iter)) != nullptr) {
-        if (pkt->kind == VPX_CODEC_CX_FRAME_PKT) {
-            dst.data.append((char*)pkt->data.frame.buf, pkt->data.frame.sz);
-
-            double timestamp = nsec_to_sec(pkt->data.frame.pts);
-            dst.packets.push_back({
-                (int)pkt->data.frame.sz, timestamp, pkt->data.frame.flags & VPX_FRAME_IS_KEY });
-        }
-    }
-}
-
-
-fcIVPXEncoder* fcCreateVP8EncoderLibVPX(const fcVPXEncoderConfig& conf) { return new fcVPXEncoder(conf, fcWebMVideoEncoder::VP8); }
-fcIVPXEncoder* fcCreateVP9EncoderLibVPX(const fcVPXEncoderConfig& conf) { return new fcVPXEncoder(conf, fcWebMVideoEncoder::VP9); }
-fcIVPXEncoder* fcCreateVP9LossLessEncoderLibVPX(const fcVPXEncoderConfig& conf) { return new fcVPXEncoder(conf, fcWebMVideoEncoder::VP9LossLess); }
-
-#else // fcSupportVPX
-
-fcIVPXEncoder* fcCreateVP8EncoderLibVPX(const fcVPXEncoderConfig& conf) { return nullptr; }
-fcIVPXEncoder* fcCreateVP9EncoderLibVPX(const fcVPXEncoderConfig& conf) { return nullptr; }
-
-#endif // fcSupportVPX
+#include "pch.h"
+#include "fcInternal.h"
+#include "Foundation/fcFoundation.h"
+#include "GraphicsDevice/fcGraphicsDevice.h"
+#include "fcVPXEncoder.h"
+
+#ifdef fcSupportVPX
+#include "vpx/vpx_encoder.h"
+#include "vpx/vp8cx.h"
+#ifdef _MSC_VER
+    #pragma comment(lib, "vpxmt.lib")
+#endif // _MSC_VER
+
+
+class fcVPXEncoder : public fcIVPXEncoder
+{
+public:
+    fcVPXEncoder(const fcVPXEncoderConfig& conf, fcWebMVideoEncoder encoder);
+    ~fcVPXEncoder() override;
+    void release() override;
+    const char* getMatroskaCodecID() const override;
+
+    bool encodeI420(fcVPXFrame& dst, const I420Data& image, fcTime timestamp, bool force_keyframe) override;
+    bool flush(fcVPXFrame& dst) override;
+
+private:
+    void gatherFrameData(fcVPXFrame& dst);
+
+    fcVPXEncoderConfig  m_conf = {};
+    vpx_codec_iface_t   *m_vpx_iface = nullptr;
+    vpx_codec_ctx_t     m_vpx_ctx = {};
+    vpx_image_t         m_vpx_img = {};
+    const char*         m_matroska_codec_id = nullptr;
+    unsigned long       m_deadline = VPX_DL_REALTIME;
+};
+
+
+fcVPXEncoder::fcVPXEncoder(const fcVPXEncoderConfig& conf, fcWebMVideoEncoder encoder)
+    : m_conf(conf)
+{
+    switch (encoder) {
+    case fcWebMVideoEncoder::VP8:
+        m_matroska_codec_id = "V_VP8";
+        m_vpx_iface = vpx_codec_vp8_cx();
+        break;
+    case fcWebMVideoEncoder::VP9:
+    case fcWebMVideoEncoder::VP9LossLess:
+        m_matroska_codec_id = "V_VP9";
+        m_vpx_iface = vpx_codec_vp9_cx();
+        break;
+    }
+
+    bool vp9 = encoder != fcWebMVideoEncoder::VP8;
+    int threads = m_conf.threads > 0 ? m_conf.threads : std::max<int>(std::thread::hardware_concurrency(), 1);
+
+    switch (m_conf.deadline) {
+    case fcVPXDeadline::Realtime:
+        m_deadline = VPX_DL_REALTIME;
+        // look-ahead makes no sense with realtime deadline and only adds latency
+        m_conf.lag_in_frames = 0;
+        break;
+    case fcVPXDeadline::Good:
+        m_deadline = VPX_DL_GOOD_QUALITY;
+        break;
+    case fcVPXDeadline::Best:
+        m_deadline = VPX_DL_BEST_QUALITY;
+        break;
+    }
+
+    vpx_codec_enc_cfg_t vpx_config;
+    vpx_codec_enc_config_default(m_vpx_iface, &vpx_config, 0);
+    vpx_config.g_w = m_conf.width;
+    vpx_config.g_h = m_conf.height;
+    vpx_config.g_timebase.num = 1;
+    vpx_config.g_timebase.den = 1000000000; // nsec
+    vpx_config.g_threads = threads;
+    vpx_config.g_lag_in_frames = std::max<int>(m_conf.lag_in_frames, 0);
+    vpx_config.g_pass = VPX_RC_ONE_PASS;
+    vpx_config.rc_target_bitrate = m_conf.target_bitrate;
+    if (m_conf.keyframe_interval > 0) {
+        vpx_config.kf_mode = VPX_KF_AUTO;
+        vpx_config.kf_max_dist = m_conf.keyframe_interval;
+    }
+
+    if (encoder != fcWebMVideoEncoder::VP9LossLess) {
+        switch (conf.bitrate_mode) {
+        case fcCBR:
+            vpx_config.rc_end_usage = VPX_CBR;
+            break;
+        case fcVBR:
+            vpx_config.rc_end_usage = VPX_VBR;
+            break;
+        }
+    }
+    vpx_codec_enc_init(&m_vpx_ctx, m_vpx_iface, &vpx_config, 0);
+    if (encoder == fcWebMVideoEncoder::VP9LossLess) {
+        vpx_codec_control_(&m_vpx_ctx, VP9E_SET_LOSSLESS, 1);
+    }
+
+    if (vp9) {
+        vpx_codec_control_(&m_vpx_ctx, VP8E_SET_CPUUSED, std::min<int>(std::max<int>(m_conf.cpu_used, 0), 9));
+
+        // VP9 tiles must be at least 256 pixels wide. use as many as threads can fill, up to 64 (log2 = 6).
+        int tile_columns = m_conf.tile_columns;
+        if (tile_columns < 0) {
+            int max_tiles = std::max<int>(std::min<int>(threads, m_conf.width / 256), 1);
+            tile_columns = 0;
+            while (tile_columns < 6 && (2 << tile_columns) <= max_tiles) { ++tile_columns; }
+        }
+        vpx_codec_control_(&m_vpx_ctx, VP9E_SET_TILE_COLUMNS, tile_columns);
+        vpx_codec_control_(&m_vpx_ctx, VP9E_SET_ROW_MT, m_conf.row_mt ? 1 : 0);
+        vpx_codec_control_(&m_vpx_ctx, VP9E_SET_FRAME_PARALLEL_DECODING, 1);
+    }
+    else {
+        vpx_codec_control_(&m_vpx_ctx, VP8E_SET_CPUUSED, std::min<int>(std::max<int>(m_conf.cpu_used, 0), 16));
+        // VP8 encodes token partitions in parallel. 8 partitions (log2 = 3) at most.
+        int partitions = 0;
+        while (partitions < 3 && (2 << partitions) <= threads) { ++partitions; }
+        vpx_codec_control_(&m_vpx_ctx, VP8E_SET_TOKEN_PARTITIONS, partitions);
+    }
+
+    vpx_img_wrap(&m_vpx_img, VPX_IMG_FMT_I420, m_conf.width, m_conf.height, 2, nullptr);
+}
+
+fcVPXEncoder::~fcVPXEncoder()
+{
+    vpx_codec_destroy(&m_vpx_ctx);
+}
+
+void fcVPXEncoder::release()
+{
+    delete this;
+}
+
+const char* fcVPXEncoder::getMatroskaCodecID() const
+{
+    return m_matroska_codec_id;
+}
+
+
+bool fcVPXEncoder::encodeI420(fcVPXFrame& dst, const I420Data& data, fcTime timestamp, bool force_keyframe)
+{
+    vpx_codec_pts_t vpx_time = to_nsec(timestamp);
+    vpx_enc_frame_flags_t vpx_flags = 0;
+    uint32_t duration = 1000000000 / m_conf.target_framerate;
+    if (force_keyframe) {
+        vpx_flags |= VPX_EFLAG_FORCE_KF;
+    }
+
+    m_vpx_img.planes[VPX_PLANE_Y] = (uint8_t*)data.y;
+    m_vpx_img.planes[VPX_PLANE_U] = (uint8_t*)data.u;
+    m_vpx_img.planes[VPX_PLANE_V] = (uint8_t*)data.v;
+    // vpx_img_wrap() assumed its own stride alignment. use the actual pitches so that padded or odd width planes are read correctly.
+    m_vpx_img.stride[VPX_PLANE_Y] = data.pitch_y;
+    m_vpx_img.stride[VPX_PLANE_U] = data.pitch_u;
+    m_vpx_img.stride[VPX_PLANE_V] = data.pitch_v;
+
+    auto res = vpx_codec_encode(&m_vpx_ctx, &m_vpx_img, vpx_time, duration, vpx_flags, m_deadline);
+    if (res != VPX_CODEC_OK) {
+        return false;
+    }
+    gatherFrameData(dst);
+
+    return true;
+}
+
+bool fcVPXEncoder::flush(fcVPXFrame& dst)
+{
+    auto res = vpx_codec_encode(&m_vpx_ctx, nullptr, -1, 0, 0, m_deadline);
+    if (res != VPX_CODEC_OK) {
+        return false;
+    }
+    gatherFrameData(dst);
+
+    return true;
+}
+
+void fcVPXEncoder::gatherFrameData(fcVPXFrame& dst)
+{
+    vpx_codec_iter_t iter = nullptr;
+    const vpx_codec_cx_pkt_t *pkt = nullptr;
+    while ((pkt = vpx_codec_get_cx_data(&m_vpx_ctx, &iter)) != nullptr) {
+        if (pkt->kind == VPX_CODEC_CX_FRAME_PKT) {
+            dst.data.append((char*)pkt->data.frame.buf, pkt->data.frame.sz);
+
+            double timestamp = nsec_to_sec(pkt->data.frame.pts);
+            dst.packets.push_back({
+                (int)pkt->data.frame.sz, timestamp, pkt->data.frame.flags & VPX_FRAME_IS_KEY });
+        }
+    }
+}
+
+
+fcIVPXEncoder* fcCreateVP8EncoderLibVPX(const fcVPXEncoderConfig& conf) { return new fcVPXEncoder(conf, fcWebMVideoEncoder::VP8); }
+fcIVPXEncoder* fcCreateVP9EncoderLibVPX(const fcVPXEncoderConfig& conf) { return new fcVPXEncoder(conf, fcWebMVideoEncoder::VP9); }
+fcIVPXEncoder* fcCreateVP9LossLessEncoderLibVPX(const fcVPXEncoderConfig& conf) { return new fcVPXEncoder(conf, fcWebMVideoEncoder::VP9LossLess); }
+
+#else // fcSupportVPX
+
+fcIVPXEncoder* fcCreateVP8EncoderLibVPX(const fcVPXEncoderConfig& conf) { return nullptr; }
+fcIVPXEncoder* fcCreateVP9EncoderLibVPX(const fcVPXEncoderConfig& conf) { return nullptr; }
+
+#endif // fcSupportVPX
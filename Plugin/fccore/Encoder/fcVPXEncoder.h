@@ -1,62 +1,71 @@
-#pragma once
-
-struct fcVPXEncoderConfig
-{
-    int width;
-    int height;
-    int target_framerate;
-    fcBitrateMode bitrate_mode;
-    int target_bitrate;
-};
-
-struct fcVPXFrame
-{
-    struct PacketInfo
-    {
-        int size;
-        double timestamp;
-        uint32_t keyframe : 1;
-    };
-    using Packets = RawVector<PacketInfo>;
-
-
-    Buffer data;
-    Packets packets;
-
-    void clear()
-    {
-        data.clear();
-        packets.clear();
-    }
-
-    // Body: [](const char *data, const fcVPXFrame::PacketInfo& pinfo) {}
-    template<class Body>
-    void eachPackets(const Body& body) const
-    {
-        int pos = 0;
-        for (auto& p : packets) {
-            body(&data[pos], p);
-            pos += p.size;
-        }
-    }
-};
-
-
-class fcIVPXEncoder
-{
-public:
-    virtual ~fcIVPXEncoder() {}
-    virtual void release() = 0;
-    virtual const char* getMatroskaCodecID() const = 0;
-
-    virtual bool encode(fcVPXFrame& dst, const void *image, fcPixelFormat fmt, fcTime timestamp, bool force_keyframe = false) = 0;
-    virtual bool flush(fcVPXFrame& dst) = 0;
-};
-
-fcIVPXEncoder* fcCreateVP8EncoderLibVPX(const fcVPXEncoderConfig& conf);
-fcIVPXEncoder* fcCreateVP9EncoderLibVPX(const fcVPXEncoderConfig& conf);
-fcIVPXEncoder* fcCreateVP9LossLessEncoderLibVPX(const fcVPXEncoderConfig& conf);
-
-using fcWebMVideoEncoderConfig = fcVPXEncoderConfig;
-using fcWebMVideoFrame = fcVPXFrame;
-using fcIWebMVideoEncoder = fcIVPXEncoder;
+#pragma once
+
+struct fcVPXEncoderConfig
+{
+    int width;
+    int height;
+    int target_framerate;
+    fcBitrateMode bitrate_mode;
+    int target_bitrate;
+    fcVPXDeadline deadline;
+    int cpu_used;
+    int threads;        // 0: hardware threads
+    int tile_columns;   // log2. -1: auto
+    bool row_mt;
+    int lag_in_frames;
+    int keyframe_interval; // max frames between keyframes. 0: libvpx default
+};
+
+struct fcVPXFrame
+{
+    struct PacketInfo
+    {
+        int size;
+        double timestamp;
+        uint32_t keyframe : 1;
+    };
+    using Packets = RawVector<PacketInfo>;
+
+
+    Buffer data;
+    Packets packets;
+
+    void clear()
+    {
+        data.reset();
+        packets.reset();
+    }
+
+    // Body: [](const char *data, const fcVPXFrame::PacketInfo& pinfo) {}
+    template<class Body>
+    void eachPackets(const Body& body) const
+    {
+        int pos = 0;
+        for (auto& p : packets) {
+            body(&data[pos], p);
+            pos += p.size;
+        }
+    }
+};
+
+
+class fcIVPXEncoder
+{
+public:
+    virtual ~fcIVPXEncoder() {}
+    virtual void release() = 0;
+    virtual const char* getMatroskaCodecID() const = 0;
+
+    // takes prepared planes as they are (no copy). any pitch is accepted; fcYUVCodecAlignment is preferable.
+    // the caller converts other formats (fcWebMContext does it into its pooled frame buffers).
+    virtual bool encodeI420(fcVPXFrame& dst, const I420Data& image, fcTime timestamp, bool force_keyframe = false) = 0;
+    virtual bool flush(fcVPXFrame& dst) = 0;
+};
+
+fcIVPXEncoder* fcCreateVP8EncoderLibVPX(const fcVPXEncoderConfig& conf);
+fcIVPXEncoder* fcCreateVP9EncoderLibVPX(const fcVPXEncoderConfig& conf);
+fcIVPXEncoder* fcCreateVP9LossLessEncoderLibVPX(const fcVPXEncoderConfig& conf);
+
+using fcWebMVideoEncoderConfig = fcVPXEncoderConfig;
+using fcWebMVideoFrame = fcVPXFrame;
+using fcIWebMVideoEncoder = fcIVPXEncoder;
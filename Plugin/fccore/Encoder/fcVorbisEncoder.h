@@ -1,62 +1,80 @@
-#pragma once
-
-
-struct fcVorbisEncoderConfig
-{
-    int sample_rate;
-    int num_channels;
-    fcBitrateMode bitrate_mode;
-    int target_bitrate;
-};
-using fcOpusEncoderConfig = fcVorbisEncoderConfig;
-
-struct fcVorbisFrame
-{
-    struct PacketInfo
-    {
-        uint32_t size;
-        double duration;
-        double timestamp;
-    };
-    using Packets = RawVector<PacketInfo>;
-
-    Buffer data;
-    Packets packets;
-
-    void clear()
-    {
-        data.clear();
-        packets.clear();
-    }
-
-    // Body: [](const char *data, const fcVorbisFrame::PacketInfo& pinfo) {}
-    template<class Body>
-    void eachPackets(const Body& body) const
-    {
-        int pos = 0;
-        for (auto& s : packets) {
-            body(&data[pos], s);
-            pos += s.size;
-        }
-    }
-};
-
-class fcIVorbisEncoder
-{
-public:
-    virtual ~fcIVorbisEncoder() {}
-    virtual void release() = 0;
-    virtual const char* getMatroskaCodecID() const = 0;
-    virtual const Buffer& getCodecPrivate() const = 0;
-
-    virtual bool encode(fcVorbisFrame& dst, const float *samples, size_t num_samples, fcTime timestamp) = 0;
-    virtual bool flush(fcVorbisFrame& dst) = 0;
-};
-
-
-fcIVorbisEncoder* fcCreateVorbisEncoder(const fcVorbisEncoderConfig& conf);
-fcIVorbisEncoder* fcCreateOpusEncoder(const fcOpusEncoderConfig& conf);
-
-using fcWebMAudioEncoderConfig = fcVorbisEncoderConfig;
-using fcWebMAudioFrame = fcVorbisFrame;
-using fcIWebMAudioEncoder = fcIVorbisEncoder;
+#pragma once
+
+
+struct fcVorbisEncoderConfig
+{
+    int sample_rate;
+    int num_channels;
+    fcBitrateMode bitrate_mode;
+    int target_bitrate;
+};
+using fcOpusEncoderConfig = fcVorbisEncoderConfig;
+
+struct fcVorbisFrame
+{
+    struct PacketInfo
+    {
+        uint32_t size;
+        double duration;
+        double timestamp;
+        int64_t granule; // Ogg granule position of the packet's end. Vorbis: sample count, Opus: 48 kHz sample count including pre-skip
+    };
+    using Packets = RawVector<PacketInfo>;
+
+    Buffer data;
+    Packets packets;
+
+    void clear()
+    {
+        data.reset();
+        packets.reset();
+    }
+
+    // Body: [](const char *data, const fcVorbisFrame::PacketInfo& pinfo) {}
+    template<class Body>
+    void eachPackets(const Body& body) const
+    {
+        int pos = 0;
+        for (auto& s : packets) {
+            body(&data[pos], s);
+            pos += s.size;
+        }
+    }
+};
+
+class fcIVorbisEncoder
+{
+public:
+    virtual ~fcIVorbisEncoder() {}
+    virtual void release() = 0;
+    virtual const char* getMatroskaCodecID() const = 0;
+    virtual const Buffer& getCodecPrivate() const = 0;
+    // samples the decoder must discard at the beginning (Opus pre-skip) in nanoseconds. 0 for Vorbis.
+    virtual uint64_t getCodecDelay() const = 0;
+
+    virtual bool encode(fcVorbisFrame& dst, const float *samples, size_t num_samples, fcTime timestamp) = 0;
+    virtual bool flush(fcVorbisFrame& dst) = 0;
+};
+
+
+// receives the output of one fcIVorbisEncoder.
+// lets a single encoder feed several containers (Ogg, WebM, raw packet streams) without encoding the audio twice.
+class fcIAudioPacketSink
+{
+public:
+    virtual ~fcIAudioPacketSink() {}
+    // codec id and codec private (headers). called before the first frame, on the encoder's thread.
+    // encoder is only guaranteed to be alive during the call. sinks that need its info later must copy it.
+    virtual void setAudioEncoderInfo(const fcIVorbisEncoder& encoder) = 0;
+    virtual void addAudioFrame(const fcVorbisFrame& frame) = 0;
+    // called once after the encoder is flushed. the last packet passed to addAudioFrame() ends the stream.
+    virtual void finishAudio() {}
+};
+
+
+fcIVorbisEncoder* fcCreateVorbisEncoder(const fcVorbisEncoderConfig& conf);
+fcIVorbisEncoder* fcCreateOpusEncoder(const fcOpusEncoderConfig& conf);
+
+using fcWebMAudioEncoderConfig = fcVorbisEncoderConfig;
+using fcWebMAudioFrame = fcVorbisFrame;
+using fcIWebMAudioEncoder = fcIVorbisEncoder;
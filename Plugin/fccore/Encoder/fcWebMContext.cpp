@@ -1,252 +1,453 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "Foundation/fcFoundation.h"
-#include "GraphicsDevice/fcGraphicsDevice.h"
-#include "fcWebMContext.h"
-#include "fcVorbisEncoder.h"
-#include "fcVPXEncoder.h"
-#include "fcWebMWriter.h"
-
-#ifdef fcSupportWebM
-
-class fcWebMContext : public fcIWebMContext
-{
-public:
-    using VideoEncoderPtr   = std::unique_ptr<fcIWebMVideoEncoder>;
-    using AudioEncoderPtr   = std::unique_ptr<fcIWebMAudioEncoder>;
-    using WriterPtr         = std::unique_ptr<fcIWebMWriter>;
-    using WriterPtrs        = std::vector<WriterPtr>;
-
-    using VideoBuffer       = Buffer;
-    using VideoBufferPtr    = std::shared_ptr<VideoBuffer>;
-    using VideoBufferQueue  = ResourceQueue<VideoBufferPtr>;
-
-    using AudioBuffer       = RawVector<float>;
-    using AudioBufferPtr    = std::shared_ptr<AudioBuffer>;
-    using AudioBufferQueue  = ResourceQueue<AudioBufferPtr>;
-
-
-    fcWebMContext(fcWebMConfig &conf, fcIGraphicsDevice *gd);
-    ~fcWebMContext() override;
-    void release() override;
-
-    void addOutputStream(fcStream *s) override;
-
-    bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp) override;
-    bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp) override;
-    bool addVideoFramePixelsImpl(const void *pixels, fcPixelFormat fmt, fcTime timestamp);
-    void flushVideo();
-
-    bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp) override;
-    void flushAudio();
-
-
-    // Body: [](fcIWebMWriter& writer) {}
-    template<class Body>
-    void eachStreams(const Body &b)
-    {
-        for (auto& s : m_writers) { b(*s); }
-    }
-
-private:
-    fcWebMConfig        m_conf;
-    fcIGraphicsDevice   *m_gdev = nullptr;
-
-    WriterPtrs          m_writers;
-
-    TaskQueue           m_video_tasks;
-    VideoEncoderPtr     m_video_encoder;
-    VideoBufferQueue    m_video_buffers;
-    fcWebMVideoFrame    m_video_frame;
-
-    TaskQueue           m_audio_tasks;
-    AudioEncoderPtr     m_audio_encoder;
-    AudioBufferQueue    m_audio_buffers;
-    fcWebMAudioFrame    m_audio_frame;
-};
-
-
-fcWebMContext::fcWebMContext(fcWebMConfig &conf, fcIGraphicsDevice *gd)
-    : m_conf(conf)
-    , m_gdev(gd)
-{
-    if (conf.video) {
-        fcVPXEncoderConfig econf;
-        econf.width = conf.video_width;
-        econf.height = conf.video_height;
-        econf.target_framerate = conf.video_target_framerate;
-        econf.bitrate_mode = conf.video_bitrate_mode;
-        econf.target_bitrate = conf.video_target_bitrate;
-
-        switch (conf.video_encoder) {
-        case fcWebMVideoEncoder::VP8:
-            m_video_encoder.reset(fcCreateVP8EncoderLibVPX(econf));
-            break;
-        case fcWebMVideoEncoder::VP9:
-            m_video_encoder.reset(fcCreateVP9EncoderLibVPX(econf));
-            break;
-        case fcWebMVideoEncoder::VP9LossLess:
-            m_video_encoder.reset(fcCreateVP9LossLessEncoderLibVPX(econf));
-            break;
-        }
-
-        for (int i = 0; i < 4; ++i) {
-            m_video_buffers.push(VideoBufferPtr(new VideoBuffer()));
-        }
-    }
-
-    if (conf.audio) {
-        fcVorbisEncoderConfig econf;
-        econf.sample_rate = conf.audio_sample_rate;
-        econf.num_channels = conf.audio_num_channels;
-        econf.bitrate_mode = conf.audio_bitrate_mode;
-        econf.target_bitrate = conf.audio_target_bitrate;
-
-        switch (conf.audio_encoder) {
-        case fcWebMAudioEncoder::Vorbis:
-            m_audio_encoder.reset(fcCreateVorbisEncoder(econf));
-            break;
-        case fcWebMAudioEncoder::Opus:
-            m_audio_encoder.reset(fcCreateOpusEncoder(econf));
-            break;
-        }
-
-        for (int i = 0; i < 4; ++i) {
-            m_audio_buffers.push(AudioBufferPtr(new AudioBuffer()));
-        }
-    }
-}
-
-fcWebMContext::~fcWebMContext()
-{
-    flushVideo();
-    flushAudio();
-    m_video_tasks.wait();
-    m_audio_tasks.wait();
-
-    m_video_encoder.reset();
-    m_audio_encoder.reset();
-    m_writers.clear();
-}
-
-void fcWebMContext::release()
-{
-    delete this;
-}
-
-void fcWebMContext::addOutputStream(fcStream *s)
-{
-    auto *writer = fcCreateWebMWriter(*s, m_conf);
-    if (m_video_encoder) { writer->setVideoEncoderInfo(*m_video_encoder); }
-    if (m_audio_encoder) { writer->setAudioEncoderInfo(*m_audio_encoder); }
-    m_writers.emplace_back(writer);
-}
-
-
-bool fcWebMContext::addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp)
-{
-    if (!tex || !m_video_encoder || !m_gdev) { return false; }
-
-    auto buf = m_video_buffers.pop();
-    size_t psize = fcGetPixelSize(fmt);
-    size_t size = m_conf.video_width * m_conf.video_height * psize;
-    buf->resize(size);
-    if (m_gdev->readTexture(buf->data(), buf->size(), tex, m_conf.video_width, m_conf.video_height, fmt)) {
-        m_video_tasks.run([this, buf, fmt, timestamp]() {
-            addVideoFramePixelsImpl(buf->data(), fmt, timestamp);
-            m_video_buffers.push(buf);
-        });
-    }
-    else {
-        m_video_buffers.push(buf);
-        return false;
-    }
-    return true;
-}
-
-bool fcWebMContext::addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
-{
-    if (!pixels || !m_video_encoder) { return false; }
-
-    auto buf = m_video_buffers.pop();
-    size_t psize = fcGetPixelSize(fmt);
-    size_t size = m_conf.video_width * m_conf.video_height * psize;
-    buf->resize(size);
-    memcpy(buf->data(), pixels, size);
-
-    m_video_tasks.run([this, buf, fmt, timestamp]() {
-        addVideoFramePixelsImpl(buf->data(), fmt, timestamp);
-        m_video_buffers.push(buf);
-    });
-    return true;
-}
-
-bool fcWebMContext::addVideoFramePixelsImpl(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
-{
-    // encode!
-    if (m_video_encoder->encode(m_video_frame, pixels, fmt, timestamp)) {
-        eachStreams([&](fcIWebMWriter& writer) {
-            writer.addVideoFrame(m_video_frame);
-        });
-        m_video_frame.clear();
-    }
-
-    return true;
-}
-
-void fcWebMContext::flushVideo()
-{
-    if (!m_video_encoder) { return; }
-
-    m_video_tasks.run([this]() {
-        if (m_video_encoder->flush(m_video_frame)) {
-            eachStreams([&](fcIWebMWriter& writer) {
-                writer.addVideoFrame(m_video_frame);
-            });
-            m_video_frame.clear();
-        }
-    });
-}
-
-
-bool fcWebMContext::addAudioFrame(const float *samples, int num_samples, fcTime timestamp)
-{
-    if (!samples || !m_audio_encoder) { return false; }
-
-    auto buf = m_audio_buffers.pop();
-    buf->assign(samples, num_samples);
-
-    m_audio_tasks.run([this, buf, timestamp]() {
-        if (m_audio_encoder->encode(m_audio_frame, buf->data(), buf->size(), timestamp)) {
-            eachStreams([&](fcIWebMWriter& writer) {
-                writer.addAudioFrame(m_audio_frame);
-            });
-            m_audio_frame.clear();
-        }
-        m_audio_buffers.push(buf);
-    });
-    return true;
-}
-
-void fcWebMContext::flushAudio()
-{
-    if (!m_audio_encoder) { return; }
-
-    m_audio_tasks.run([this]() {
-        if (m_audio_encoder->flush(m_audio_frame)) {
-            eachStreams([&](fcIWebMWriter& writer) {
-                writer.addAudioFrame(m_audio_frame);
-            });
-            m_audio_frame.clear();
-        }
-    });
-}
-
-
-fcIWebMContext* fcWebMCreateContextImpl(fcWebMConfig &conf, fcIGraphicsDevice *gd) { return new fcWebMContext(conf, gd); }
-
-#else  // fcSupportWebM
-
-fcIWebMContext* fcWebMCreateContextImpl(fcWebMConfig &conf, fcIGraphicsDevice *gd) { return nullptr; }
-
-#endif // fcSupportWebM
+#include "pch.h"
+#include "fcInternal.h"
+#include "Foundation/fcFoundation.h"
+#include "GraphicsDevice/fcGraphicsDevice.h"
+#include "fcWebMContext.h"
+#include "fcVorbisEncoder.h"
+#include "fcVPXEncoder.h"
+#include "fcSegmentedEncoder.h"
+#include "fcInterleaveQueue.h"
+#include "fcWebMWriter.h"
+
+#ifdef fcSupportWebM
+
+class fcWebMContext : public fcIWebMContext, public fcIAudioPacketSink
+{
+public:
+    using VideoEncoderPtr   = std::unique_ptr<fcIWebMVideoEncoder>;
+    using AudioEncoderPtr   = std::unique_ptr<fcIWebMAudioEncoder>;
+    using WriterPtr         = std::unique_ptr<fcIWebMWriter>;
+    using WriterPtrs        = std::vector<WriterPtr>;
+
+    // pixels: raw frame (texture readback, or a copy / transform of the pixels passed in). i420: frame handed to the encoder.
+    // if to_i420 is set, pixels (in format) are converted into i420 by the encode task, off the calling thread.
+    // otherwise i420 was filled directly by the caller (I420 input that needs no transform).
+    struct VideoBuffer
+    {
+        PooledBuffer pixels;
+        PooledBuffer tmp;
+        I420Image i420;
+        fcPixelFormat format = fcPixelFormat_Unknown;
+        bool to_i420 = false;
+    };
+    using VideoBufferPtr    = std::shared_ptr<VideoBuffer>;
+    using VideoBufferQueue  = ResourceQueue<VideoBufferPtr>;
+
+    using SegmentedVideoEncoder = fcSegmentedEncoder<fcIWebMVideoEncoder, fcWebMVideoFrame>;
+    using SegmentedVideoEncoderPtr = std::unique_ptr<SegmentedVideoEncoder>;
+    using VideoEncodeTask   = SegmentedVideoEncoder::EncodeTask;
+
+    using Interleaver       = fcInterleaveQueue<fcWebMVideoFrame, fcWebMAudioFrame>;
+    using InterleaverPtr    = std::unique_ptr<Interleaver>;
+
+    using AudioBuffer       = RawVector<float>;
+    using AudioBufferPtr    = std::shared_ptr<AudioBuffer>;
+    using AudioBufferQueue  = ResourceQueue<AudioBufferPtr>;
+
+
+    fcWebMContext(fcWebMConfig &conf, fcIGraphicsDevice *gd);
+    ~fcWebMContext() override;
+    void release() override;
+    // flushes and destroys the encoders. the first step of the destructor
+    void releaseEncoders();
+    const fcWebMConfig& getConfig() const override;
+
+    void addOutputStream(fcStream *s) override;
+
+    bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp) override;
+    bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp) override;
+    void submitVideoFrame(const VideoBufferPtr& buf, fcTime timestamp);
+    void encodeVideoFrame(const VideoBufferPtr& buf, const VideoEncodeTask& task);
+    void convertVideoFrame(VideoBuffer& buf);
+    void emitVideoFrame(fcWebMVideoFrame& frame);
+    void flushVideo();
+
+    bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp) override;
+    void flushAudio();
+
+    void setPixelTransform(const fcPixelTransform *t) override;
+
+    fcIAudioPacketSink* getAudioPacketSink() override;
+    void setAudioEncoderInfo(const fcIWebMAudioEncoder& encoder) override;
+    void addAudioFrame(const fcWebMAudioFrame& frame) override;
+    void finishAudio() override;
+
+
+    // Body: [](fcIWebMWriter& writer) {}
+    template<class Body>
+    void eachStreams(const Body &b)
+    {
+        for (auto& s : m_writers) { b(*s); }
+    }
+
+private:
+    fcWebMConfig        m_conf;
+    fcIGraphicsDevice   *m_gdev = nullptr;
+    PixelTransformStage m_pixel_transform;
+    // declared before everything that records into it
+    StatsCollector      m_stats;
+
+    std::vector<std::unique_ptr<StatsStream>> m_streams; // output streams wrapped for m_stats. outlive m_writers
+    WriterPtrs          m_writers;
+    InterleaverPtr      m_interleaver;
+
+    TaskQueue           m_video_tasks;
+    VideoEncoderPtr     m_video_encoder;
+    SegmentedVideoEncoderPtr m_segmented_video;
+    VideoBufferQueue    m_video_buffers;
+    fcWebMVideoFrame    m_video_frame;
+
+    TaskQueue           m_audio_tasks;
+    AudioEncoderPtr     m_audio_encoder;
+    // codec of the audio track: m_audio_encoder or the external encoder that feeds the track.
+    // the external one calls setAudioEncoderInfo() from its own thread, so this and m_writers are guarded by m_audio_info_mutex.
+    std::mutex          m_audio_info_mutex;
+    fcWebMAudioTrackInfo m_audio_info;
+    AudioBufferQueue    m_audio_buffers;
+    fcWebMAudioFrame    m_audio_frame;
+};
+
+
+fcWebMContext::fcWebMContext(fcWebMConfig &conf, fcIGraphicsDevice *gd)
+    : m_conf(conf)
+    , m_gdev(gd)
+    , m_stats(static_cast<fcIWebMContext*>(this))
+{
+    if (conf.video) {
+        fcVPXEncoderConfig econf;
+        econf.width = conf.video_width;
+        econf.height = conf.video_height;
+        econf.target_framerate = conf.video_target_framerate;
+        econf.bitrate_mode = conf.video_bitrate_mode;
+        econf.target_bitrate = conf.video_target_bitrate;
+        econf.deadline = conf.video_deadline;
+        econf.cpu_used = conf.video_cpu_used;
+        econf.threads = conf.video_threads;
+        econf.tile_columns = conf.video_tile_columns;
+        econf.row_mt = conf.video_row_mt;
+        econf.lag_in_frames = conf.video_lag_in_frames;
+        econf.keyframe_interval = conf.cue_interval > 0.0 ?
+            std::max<int>((int)(conf.cue_interval * conf.video_target_framerate), 1) : 0;
+
+        auto create = [](fcWebMVideoEncoder type, const fcVPXEncoderConfig& c) -> fcIWebMVideoEncoder* {
+            switch (type) {
+            case fcWebMVideoEncoder::VP8: return fcCreateVP8EncoderLibVPX(c);
+            case fcWebMVideoEncoder::VP9: return fcCreateVP9EncoderLibVPX(c);
+            case fcWebMVideoEncoder::VP9LossLess: return fcCreateVP9LossLessEncoderLibVPX(c);
+            }
+            return nullptr;
+        };
+        m_video_encoder.reset(create(conf.video_encoder, econf));
+
+        int num_buffers = 4;
+        if (m_video_encoder && conf.video_parallel_segments > 1) {
+            // segment encoders share the cores
+            auto sconf = econf;
+            if (sconf.threads <= 0) {
+                sconf.threads = std::max<int>(std::thread::hardware_concurrency() / conf.video_parallel_segments, 1);
+            }
+            auto type = conf.video_encoder;
+            int max_frames = SegmentedVideoEncoder::getMaxFrames(conf.video_max_buffered_frames,
+                conf.video_segment_frames, conf.video_parallel_segments, (size_t)conf.video_width * conf.video_height * 4);
+            m_segmented_video.reset(new SegmentedVideoEncoder(conf.video_segment_frames, conf.video_parallel_segments, max_frames,
+                [create, type, sconf]() { return create(type, sconf); },
+                [this](fcWebMVideoFrame& frame) { emitVideoFrame(frame); }));
+            // raw frames waiting for the segment encoders are capped. one more is filled by the caller meanwhile.
+            num_buffers = std::max<int>(num_buffers, max_frames + 1);
+        }
+        for (int i = 0; i < num_buffers; ++i) {
+            m_video_buffers.push(VideoBufferPtr(new VideoBuffer()));
+        }
+    }
+
+    if (conf.audio) {
+        fcVorbisEncoderConfig econf;
+        econf.sample_rate = conf.audio_sample_rate;
+        econf.num_channels = conf.audio_num_channels;
+        econf.bitrate_mode = conf.audio_bitrate_mode;
+        econf.target_bitrate = conf.audio_target_bitrate;
+
+        switch (conf.audio_encoder) {
+        case fcWebMAudioEncoder::Vorbis:
+            m_audio_encoder.reset(fcCreateVorbisEncoder(econf));
+            break;
+        case fcWebMAudioEncoder::Opus:
+            m_audio_encoder.reset(fcCreateOpusEncoder(econf));
+            break;
+        }
+        if (!m_audio_encoder) {
+            fcDebugLog("fcWebMContext::fcWebMContext(): audio encoder is not available\n");
+        }
+        if (m_audio_encoder) {
+            m_audio_info = fcWebMAudioTrackInfo(*m_audio_encoder);
+        }
+
+        for (int i = 0; i < 4; ++i) {
+            m_audio_buffers.push(AudioBufferPtr(new AudioBuffer()));
+        }
+    }
+
+    m_interleaver.reset(new Interleaver(conf.interleave_window, m_video_encoder != nullptr, m_audio_encoder != nullptr,
+        [this](const fcWebMVideoFrame& frame) {
+            StatsScope scope(m_stats, fcStatsStage_Mux);
+            eachStreams([&](fcIWebMWriter& writer) { writer.addVideoFrame(frame); });
+        },
+        [this](const fcWebMAudioFrame& frame) {
+            StatsScope scope(m_stats, fcStatsStage_Mux);
+            eachStreams([&](fcIWebMWriter& writer) { writer.addAudioFrame(frame); });
+        }));
+}
+
+fcWebMContext::~fcWebMContext()
+{
+    releaseEncoders();
+    m_interleaver.reset();
+    m_writers.clear();
+}
+
+void fcWebMContext::release()
+{
+    delete this;
+}
+
+void fcWebMContext::releaseEncoders()
+{
+    // flush*() are no-ops once the encoders are gone, so this can be called more than once
+    flushVideo();
+    flushAudio();
+    m_video_tasks.wait();
+    m_audio_tasks.wait();
+
+    m_segmented_video.reset();
+    m_video_encoder.reset();
+    m_audio_encoder.reset();
+}
+
+const fcWebMConfig& fcWebMContext::getConfig() const
+{
+    return m_conf;
+}
+
+void fcWebMContext::addOutputStream(fcStream *s)
+{
+    std::unique_lock<std::mutex> lock(m_audio_info_mutex);
+    m_streams.emplace_back(new StatsStream(*s, m_stats));
+    auto *writer = fcCreateWebMWriter(*m_streams.back(), m_conf);
+    if (m_video_encoder) { writer->setVideoEncoderInfo(*m_video_encoder); }
+    if (!m_audio_info.codec_id.empty()) { writer->setAudioEncoderInfo(m_audio_info); }
+    m_writers.emplace_back(writer);
+}
+
+
+bool fcWebMContext::addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp)
+{
+    if (!tex || !m_video_encoder || !m_gdev) { return false; }
+
+    auto buf = m_stats.popBuffer(m_video_buffers);
+    size_t psize = fcGetPixelSize(fmt);
+    size_t size = m_conf.video_width * m_conf.video_height * psize;
+    buf->pixels.resize(size);
+    bool read;
+    {
+        StatsScope scope(m_stats, fcStatsStage_Readback);
+        read = m_gdev->readTexture(buf->pixels.data(), buf->pixels.size(), tex, m_conf.video_width, m_conf.video_height, fmt);
+    }
+    if (read) {
+        buf->format = fmt;
+        buf->to_i420 = true;
+        submitVideoFrame(buf, timestamp);
+    }
+    else {
+        m_video_buffers.push(buf);
+        return false;
+    }
+    return true;
+}
+
+bool fcWebMContext::addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp)
+{
+    if (!pixels || !m_video_encoder) { return false; }
+
+    // pixels are only valid during this call, so the caller pays for one copy (or the transform, which replaces the copy).
+    // I420 input is copied straight into the encoder's planes. the RGB -> YUV conversion is left to the encode task.
+    auto buf = m_stats.popBuffer(m_video_buffers);
+    int width = m_conf.video_width;
+    int height = m_conf.video_height;
+    if (fmt == fcPixelFormat_I420 && !m_pixel_transform.enabled()) {
+        StatsScope scope(m_stats, fcStatsStage_Convert);
+        AnyToI420(buf->i420, buf->tmp, pixels, fmt, width, height,
+            fcColorSpace::BT601, fcColorRange::Limited, fcYUVCodecAlignment);
+        buf->to_i420 = false;
+    }
+    else {
+        StatsScope scope(m_stats, fcStatsStage_Convert);
+        buf->pixels.resize(fcGetImageSize(fmt, width, height));
+        if (!m_pixel_transform.apply(buf->pixels.data(), fmt, pixels, fmt, width, height)) {
+            m_video_buffers.push(buf);
+            return false;
+        }
+        buf->to_i420 = true;
+    }
+    buf->format = fmt;
+    submitVideoFrame(buf, timestamp);
+    return true;
+}
+
+// VPX reads I420 only: both the texture and the pixels path end up in the pooled buf->i420.
+void fcWebMContext::submitVideoFrame(const VideoBufferPtr& buf, fcTime timestamp)
+{
+    encodeVideoFrame(buf, [buf, timestamp](fcIWebMVideoEncoder& encoder, fcWebMVideoFrame& dst) {
+        return encoder.encodeI420(dst, buf->i420.data(), timestamp);
+    });
+}
+
+// serial: encodes with m_video_encoder on m_video_tasks.
+// parallel segments: encodes on the segment's thread and the results are emitted in stream order.
+void fcWebMContext::encodeVideoFrame(const VideoBufferPtr& buf, const VideoEncodeTask& task)
+{
+    m_stats.enqueue(StatsCollector::Queue::Video);
+    if (m_segmented_video) {
+        // the raw frame goes back to the pool even if the segment has no encoder and drops it
+        m_segmented_video->encode(
+            [this, buf, task](fcIWebMVideoEncoder& encoder, fcWebMVideoFrame& dst) {
+                convertVideoFrame(*buf);
+                StatsScope scope(m_stats, fcStatsStage_Encode);
+                return task(encoder, dst);
+            },
+            [this, buf]() {
+                m_video_buffers.push(buf);
+                m_stats.dequeue(StatsCollector::Queue::Video);
+            });
+    }
+    else {
+        m_video_tasks.run([this, buf, task]() {
+            convertVideoFrame(*buf);
+            bool ret;
+            {
+                StatsScope scope(m_stats, fcStatsStage_Encode);
+                ret = task(*m_video_encoder, m_video_frame);
+            }
+            if (ret) {
+                emitVideoFrame(m_video_frame);
+            }
+            m_video_buffers.push(buf);
+            m_stats.dequeue(StatsCollector::Queue::Video);
+        });
+    }
+}
+
+void fcWebMContext::convertVideoFrame(VideoBuffer& buf)
+{
+    if (!buf.to_i420) { return; }
+    StatsScope scope(m_stats, fcStatsStage_YUV);
+    AnyToI420(buf.i420, buf.tmp, buf.pixels.data(), buf.format, m_conf.video_width, m_conf.video_height,
+        fcColorSpace::BT601, fcColorRange::Limited, fcYUVCodecAlignment);
+}
+
+void fcWebMContext::emitVideoFrame(fcWebMVideoFrame& frame)
+{
+    if (!frame.packets.empty()) {
+        m_interleaver->addVideoFrame(frame, frame.packets.front().timestamp);
+    }
+    frame.clear();
+}
+
+void fcWebMContext::flushVideo()
+{
+    if (!m_video_encoder) { return; }
+
+    if (m_segmented_video) {
+        m_segmented_video->flush();
+        m_interleaver->endVideo();
+        return;
+    }
+    m_video_tasks.run([this]() {
+        if (m_video_encoder->flush(m_video_frame)) {
+            emitVideoFrame(m_video_frame);
+        }
+        m_interleaver->endVideo();
+    });
+}
+
+
+void fcWebMContext::setPixelTransform(const fcPixelTransform *t)
+{
+    m_pixel_transform.set(t);
+}
+
+bool fcWebMContext::addAudioFrame(const float *samples, int num_samples, fcTime timestamp)
+{
+    if (!samples || !m_audio_encoder) { return false; }
+
+    auto buf = m_stats.popBuffer(m_audio_buffers);
+    buf->assign(samples, num_samples);
+
+    m_stats.enqueue(StatsCollector::Queue::Audio);
+    m_audio_tasks.run([this, buf, timestamp]() {
+        bool ret;
+        {
+            StatsScope scope(m_stats, fcStatsStage_AudioEncode);
+            ret = m_audio_encoder->encode(m_audio_frame, buf->data(), buf->size(), timestamp);
+        }
+        if (ret) {
+            addAudioFrame(m_audio_frame);
+            m_audio_frame.clear();
+        }
+        m_audio_buffers.push(buf);
+        m_stats.dequeue(StatsCollector::Queue::Audio);
+    });
+    return true;
+}
+
+void fcWebMContext::flushAudio()
+{
+    if (!m_audio_encoder) { return; }
+
+    m_audio_tasks.run([this]() {
+        if (m_audio_encoder->flush(m_audio_frame)) {
+            addAudioFrame(m_audio_frame);
+            m_audio_frame.clear();
+        }
+        m_interleaver->endAudio();
+    });
+}
+
+fcIAudioPacketSink* fcWebMContext::getAudioPacketSink()
+{
+    if (!m_conf.audio) { return nullptr; }
+
+    m_audio_tasks.wait();
+    m_audio_encoder.reset();
+    std::unique_lock<std::mutex> lock(m_audio_info_mutex);
+    m_audio_info = fcWebMAudioTrackInfo();
+    return this;
+}
+
+// called on the thread of the context that owns encoder. encoder is only valid during this call, so its info is copied.
+void fcWebMContext::setAudioEncoderInfo(const fcIWebMAudioEncoder& encoder)
+{
+    std::unique_lock<std::mutex> lock(m_audio_info_mutex);
+    m_audio_info = fcWebMAudioTrackInfo(encoder);
+    eachStreams([&](fcIWebMWriter& writer) {
+        writer.setAudioEncoderInfo(m_audio_info);
+    });
+}
+
+void fcWebMContext::addAudioFrame(const fcWebMAudioFrame& frame)
+{
+    m_interleaver->addAudioFrame(frame);
+}
+
+void fcWebMContext::finishAudio()
+{
+    m_interleaver->endAudio();
+}
+
+
+fcIWebMContext* fcWebMCreateContextImpl(fcWebMConfig &conf, fcIGraphicsDevice *gd) { return new fcWebMContext(conf, gd); }
+
+#else  // fcSupportWebM
+
+fcIWebMContext* fcWebMCreateContextImpl(fcWebMConfig &conf, fcIGraphicsDevice *gd) { return nullptr; }
+
+#endif // fcSupportWebM
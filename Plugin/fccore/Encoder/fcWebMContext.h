@@ -1,24 +1,35 @@
-#pragma once
-
-class fcIWebMContext
-{
-public:
-    virtual void release() = 0;
-
-    virtual void addOutputStream(fcStream *s) = 0;
-
-    // timestamp=-1 is treated as current time.
-    virtual bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0) = 0;
-
-    // timestamp=-1 is treated as current time.
-    virtual bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0) = 0;
-
-    // timestamp=-1 is treated as current time.
-    virtual bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp = -1.0) = 0;
-
-protected:
-    virtual ~fcIWebMContext() {}
-};
-
-
-fcIWebMContext* fcWebMCreateContextImpl(fcWebMConfig &conf, fcIGraphicsDevice*);
+#pragma once
+
+class fcIAudioPacketSink;
+
+class fcIWebMContext
+{
+public:
+    virtual void release() = 0;
+    virtual const fcWebMConfig& getConfig() const = 0;
+
+    virtual void addOutputStream(fcStream *s) = 0;
+
+    // timestamp=-1 is treated as current time.
+    virtual bool addVideoFrameTexture(void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0) = 0;
+
+    // any packed format, or fcPixelFormat_I420 / fcPixelFormat_NV12 which go to the encoder without color conversion.
+    // timestamp=-1 is treated as current time.
+    virtual bool addVideoFramePixels(const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0) = 0;
+
+    // timestamp=-1 is treated as current time.
+    virtual bool addAudioFrame(const float *samples, int num_samples, fcTime timestamp = -1.0) = 0;
+
+    // crop / flip / resize applied to addVideoFramePixels() input. nullptr disables it.
+    virtual void setPixelTransform(const fcPixelTransform *t) = 0;
+
+    // makes the audio track take packets from another context's encoder (see fcOggAddWebMOutput()).
+    // the context's own audio encoder is discarded and addAudioFrame() fails from then on. nullptr if audio is disabled.
+    virtual fcIAudioPacketSink* getAudioPacketSink() = 0;
+
+protected:
+    virtual ~fcIWebMContext() {}
+};
+
+
+fcIWebMContext* fcWebMCreateContextImpl(fcWebMConfig &conf, fcIGraphicsDevice*);
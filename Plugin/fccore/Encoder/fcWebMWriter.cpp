@@ -1,124 +1,153 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "Foundation/fcFoundation.h"
-#include "GraphicsDevice/fcGraphicsDevice.h"
-#include "fcVorbisEncoder.h"
-#include "fcVPXEncoder.h"
-#include "fcWebMWriter.h"
-
-#ifdef fcSupportWebM
-#include "mkvmuxer.hpp"
-#ifdef _MSC_VER
-    #pragma comment(lib, "libwebm.lib")
-#endif // _MSC_VER
-
-
-class fcMkvStream : public mkvmuxer::IMkvWriter
-{
-public:
-    fcMkvStream(BinaryStream &stream) : m_stream(stream) {}
-    int32_t Write(const void* buf, uint32_t len) override { m_stream.write(buf, len); return 0; }
-    mkvmuxer::int64 Position() const override { return m_stream.tellp(); }
-    mkvmuxer::int32 Position(mkvmuxer::int64 position) override { m_stream.seekp((size_t)position); return 0; }
-    bool Seekable() const override { return true; }
-    void ElementStartNotify(mkvmuxer::uint64 element_id, mkvmuxer::int64 position) override {}
-private:
-    BinaryStream &m_stream;
-};
-
-
-class fcWebMWriter : public fcIWebMWriter
-{
-public:
-    fcWebMWriter(BinaryStream &stream, const fcWebMConfig &conf);
-    ~fcWebMWriter() override;
-    void setVideoEncoderInfo(const fcIWebMVideoEncoder& encoder) override;
-    void setAudioEncoderInfo(const fcIWebMAudioEncoder& encoder) override;
-
-    void addVideoFrame(const fcWebMVideoFrame& buf) override;
-    void addAudioFrame(const fcWebMAudioFrame& buf) override;
-
-private:
-    using StreamPtr = std::unique_ptr<fcMkvStream>;
-
-    fcWebMConfig m_conf;
-    StreamPtr m_stream;
-    std::mutex m_mutex;
-
-    mkvmuxer::Segment m_segment;
-    uint64_t m_video_track_id = 0;
-    uint64_t m_audio_track_id = 0;
-};
-
-
-fcWebMWriter::fcWebMWriter(BinaryStream &stream, const fcWebMConfig &conf)
-    : m_conf(conf)
-    , m_stream(new fcMkvStream(stream))
-{
-    m_segment.Init(m_stream.get());
-    m_segment.set_mode(mkvmuxer::Segment::kLive);
-    if (conf.video) {
-        m_video_track_id = m_segment.AddVideoTrack(conf.video_width, conf.video_height, 0);
-    }
-    if(conf.audio) {
-        m_audio_track_id = m_segment.AddAudioTrack(conf.audio_sample_rate, conf.audio_num_channels, 0);
-    }
-
-    auto info = m_segment.GetSegmentInfo();
-    info->set_writing_app("Unity WebM Recorder");
-}
-
-fcWebMWriter::~fcWebMWriter()
-{
-    m_segment.Finalize();
-}
-
-void fcWebMWriter::setVideoEncoderInfo(const fcIWebMVideoEncoder& encoder)
-{
-    auto track = dynamic_cast<mkvmuxer::VideoTrack*>(m_segment.GetTrackByNumber(m_video_track_id));
-    if (track) {
-        track->set_codec_id(encoder.getMatroskaCodecID());
-    }
-}
-
-void fcWebMWriter::setAudioEncoderInfo(const fcIWebMAudioEncoder& encoder)
-{
-    auto track = dynamic_cast<mkvmuxer::AudioTrack*>(m_segment.GetTrackByNumber(m_audio_track_id));
-    if (track) {
-        track->set_codec_id(encoder.getMatroskaCodecID());
-
-        const auto& cp = encoder.getCodecPrivate();
-        track->SetCodecPrivate((const uint8_t*)cp.data(), cp.size());
-    }
-}
-
-void fcWebMWriter::addVideoFrame(const fcWebMVideoFrame& frame)
-{
-    if (m_video_track_id == 0 || frame.data.empty()) { return; }
-
-    std::unique_lock<std::mutex> lock(m_mutex);
-    frame.eachPackets([&](const char *data, const fcVPXFrame::PacketInfo& pinfo) {
-        uint64_t timestamp_ns = to_nsec(pinfo.timestamp);
-        m_segment.AddFrame((const uint8_t*)data, pinfo.size, m_video_track_id, timestamp_ns, pinfo.keyframe);
-    });
-}
-
-void fcWebMWriter::addAudioFrame(const fcWebMAudioFrame& frame)
-{
-    if (m_audio_track_id == 0 || frame.data.empty()) { return; }
-
-    std::unique_lock<std::mutex> lock(m_mutex);
-    frame.eachPackets([&](const char *data, const fcVorbisFrame::PacketInfo& pinfo) {
-        uint64_t timestamp_ns = to_nsec(pinfo.timestamp);
-        m_segment.AddFrame((const uint8_t*)data, pinfo.size, m_audio_track_id, timestamp_ns, true);
-    });
-}
-
-
-fcIWebMWriter* fcCreateWebMWriter(BinaryStream &stream, const fcWebMConfig &conf) { return new fcWebMWriter(stream, conf); }
-
-#else  // fcSupportWebM
-
-fcIWebMWriter* fcCreateWebMWriter(BinaryStream &stream, const fcWebMConfig &conf) { return nullptr; }
-
-#endif // fcSupportWebM
+#include "pch.h"
+#include "fcInternal.h"
+#include "Foundation/fcFoundation.h"
+#include "GraphicsDevice/fcGraphicsDevice.h"
+#include "fcVorbisEncoder.h"
+#include "fcVPXEncoder.h"
+#include "fcWebMWriter.h"
+
+#ifdef fcSupportWebM
+#include "mkvmuxer.hpp"
+#ifdef _MSC_VER
+    #pragma comment(lib, "libwebm.lib")
+#endif // _MSC_VER
+
+
+class fcMkvStream : public mkvmuxer::IMkvWriter
+{
+public:
+    fcMkvStream(BinaryStream &stream) : m_stream(stream) {}
+    int32_t Write(const void* buf, uint32_t len) override { m_stream.write(buf, len); return 0; }
+    mkvmuxer::int64 Position() const override { return m_stream.tellp(); }
+    mkvmuxer::int32 Position(mkvmuxer::int64 position) override { m_stream.seekp((size_t)position); return 0; }
+    bool Seekable() const override { return true; }
+    void ElementStartNotify(mkvmuxer::uint64 element_id, mkvmuxer::int64 position) override {}
+private:
+    BinaryStream &m_stream;
+};
+
+
+class fcWebMWriter : public fcIWebMWriter
+{
+public:
+    fcWebMWriter(BinaryStream &stream, const fcWebMConfig &conf);
+    ~fcWebMWriter() override;
+    void setVideoEncoderInfo(const fcIWebMVideoEncoder& encoder) override;
+    void setAudioEncoderInfo(const fcWebMAudioTrackInfo& info) override;
+
+    void addVideoFrame(const fcWebMVideoFrame& buf) override;
+    void addAudioFrame(const fcWebMAudioFrame& buf) override;
+
+private:
+    using StreamPtr = std::unique_ptr<fcMkvStream>;
+
+    fcWebMConfig m_conf;
+    StreamPtr m_stream;
+    std::mutex m_mutex;
+
+    mkvmuxer::Segment m_segment;
+    uint64_t m_video_track_id = 0;
+    uint64_t m_audio_track_id = 0;
+};
+
+
+fcWebMWriter::fcWebMWriter(BinaryStream &stream, const fcWebMConfig &conf)
+    : m_conf(conf)
+    , m_stream(new fcMkvStream(stream))
+{
+    m_segment.Init(m_stream.get());
+    m_segment.set_mode(conf.live ? mkvmuxer::Segment::kLive : mkvmuxer::Segment::kFile);
+    if (conf.video) {
+        m_video_track_id = m_segment.AddVideoTrack(conf.video_width, conf.video_height, 0);
+    }
+    if(conf.audio) {
+        m_audio_track_id = m_segment.AddAudioTrack(conf.audio_sample_rate, conf.audio_num_channels, 0);
+    }
+
+    // cue points are added at the first frame of the cues track in each new cluster.
+    // video keyframes always start a new cluster, so video files get one cue per keyframe.
+    if (!conf.live) {
+        m_segment.OutputCues(true);
+        uint64_t cues_track = m_video_track_id != 0 ? m_video_track_id : m_audio_track_id;
+        if (cues_track != 0) {
+            m_segment.CuesTrack(cues_track);
+        }
+    }
+    fcTime cluster_duration = conf.max_cluster_duration;
+    if (m_video_track_id == 0 && conf.cue_interval > 0.0) {
+        cluster_duration = cluster_duration > 0.0 ? std::min<fcTime>(cluster_duration, conf.cue_interval) : conf.cue_interval;
+    }
+    if (cluster_duration > 0.0) {
+        m_segment.set_max_cluster_duration(to_nsec(cluster_duration));
+    }
+    if (conf.max_cluster_size > 0) {
+        m_segment.set_max_cluster_size(conf.max_cluster_size);
+    }
+
+    auto info = m_segment.GetSegmentInfo();
+    info->set_writing_app("Unity WebM Recorder");
+}
+
+fcWebMWriter::~fcWebMWriter()
+{
+    m_segment.Finalize();
+}
+
+void fcWebMWriter::setVideoEncoderInfo(const fcIWebMVideoEncoder& encoder)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto track = dynamic_cast<mkvmuxer::VideoTrack*>(m_segment.GetTrackByNumber(m_video_track_id));
+    if (track) {
+        track->set_codec_id(encoder.getMatroskaCodecID());
+    }
+}
+
+// may be called from the thread of another context (fcOggAddWebMOutput()) while frames are added
+void fcWebMWriter::setAudioEncoderInfo(const fcWebMAudioTrackInfo& info)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto track = dynamic_cast<mkvmuxer::AudioTrack*>(m_segment.GetTrackByNumber(m_audio_track_id));
+    if (track) {
+        track->set_codec_id(info.codec_id.c_str());
+
+        const auto& cp = info.codec_private;
+        track->SetCodecPrivate((const uint8_t*)cp.data(), cp.size());
+
+        if (info.codec_delay > 0) {
+            track->set_codec_delay(info.codec_delay);
+            // 80 ms: the pre-roll Opus decoders need to converge after a seek (RFC 7845)
+            track->set_seek_pre_roll(80000000);
+        }
+    }
+}
+
+void fcWebMWriter::addVideoFrame(const fcWebMVideoFrame& frame)
+{
+    if (m_video_track_id == 0 || frame.data.empty()) { return; }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    frame.eachPackets([&](const char *data, const fcVPXFrame::PacketInfo& pinfo) {
+        uint64_t timestamp_ns = to_nsec(pinfo.timestamp);
+        m_segment.AddFrame((const uint8_t*)data, pinfo.size, m_video_track_id, timestamp_ns, pinfo.keyframe);
+    });
+}
+
+void fcWebMWriter::addAudioFrame(const fcWebMAudioFrame& frame)
+{
+    if (m_audio_track_id == 0 || frame.data.empty()) { return; }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    frame.eachPackets([&](const char *data, const fcVorbisFrame::PacketInfo& pinfo) {
+        uint64_t timestamp_ns = to_nsec(pinfo.timestamp);
+        m_segment.AddFrame((const uint8_t*)data, pinfo.size, m_audio_track_id, timestamp_ns, true);
+    });
+}
+
+
+fcIWebMWriter* fcCreateWebMWriter(BinaryStream &stream, const fcWebMConfig &conf) { return new fcWebMWriter(stream, conf); }
+
+#else  // fcSupportWebM
+
+fcIWebMWriter* fcCreateWebMWriter(BinaryStream &stream, const fcWebMConfig &conf) { return nullptr; }
+
+#endif // fcSupportWebM
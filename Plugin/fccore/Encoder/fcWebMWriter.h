@@ -1,14 +1,30 @@
-#pragma once
-
-class fcIWebMWriter
-{
-public:
-    virtual ~fcIWebMWriter() {}
-    virtual void setVideoEncoderInfo(const fcIWebMVideoEncoder& encoder) = 0;
-    virtual void setAudioEncoderInfo(const fcIWebMAudioEncoder& encoder) = 0;
-
-    virtual void addVideoFrame(const fcWebMVideoFrame& buf) = 0;
-    virtual void addAudioFrame(const fcWebMAudioFrame& buf) = 0;
-};
-
-fcIWebMWriter* fcCreateWebMWriter(BinaryStream &stream, const fcWebMConfig &conf);
+#pragma once
+
+// audio track parameters, copied out of the encoder. the encoder may belong to another context (see fcOggAddWebMOutput())
+// and is only guaranteed to be alive during fcIAudioPacketSink::setAudioEncoderInfo().
+struct fcWebMAudioTrackInfo
+{
+    std::string codec_id;   // empty: no encoder info yet
+    Buffer codec_private;
+    uint64_t codec_delay = 0;
+
+    fcWebMAudioTrackInfo() {}
+    explicit fcWebMAudioTrackInfo(const fcIWebMAudioEncoder& encoder)
+        : codec_id(encoder.getMatroskaCodecID())
+        , codec_private(encoder.getCodecPrivate().data(), encoder.getCodecPrivate().size())
+        , codec_delay(encoder.getCodecDelay())
+    {}
+};
+
+class fcIWebMWriter
+{
+public:
+    virtual ~fcIWebMWriter() {}
+    virtual void setVideoEncoderInfo(const fcIWebMVideoEncoder& encoder) = 0;
+    virtual void setAudioEncoderInfo(const fcWebMAudioTrackInfo& info) = 0;
+
+    virtual void addVideoFrame(const fcWebMVideoFrame& buf) = 0;
+    virtual void addAudioFrame(const fcWebMAudioFrame& buf) = 0;
+};
+
+fcIWebMWriter* fcCreateWebMWriter(BinaryStream &stream, const fcWebMConfig &conf);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+
+
+// cuts interleaved float input of any length into fixed-size frames for encoders that take a fixed number of samples per call.
+// input is converted into T (the encoder's input layout) once, as it is pushed, into a ring buffer whose capacity is a multiple
+// of the frame size. frames always start at a multiple of the frame size, so each complete frame is contiguous and is passed
+// to the encoder without another copy, and consumed samples are never moved.
+// positions are counted in samples per channel from the first pushed sample, so timestamps derived from them are exact.
+template<class T>
+class AudioReframer
+{
+public:
+    // converts num interleaved float samples into dst
+    using Convert = std::function<void(T *dst, const float *src, size_t num)>;
+
+    // frame_size: samples per channel of one frame
+    AudioReframer(int num_channels, size_t frame_size, const Convert& convert)
+        : m_num_channels(num_channels)
+        , m_frame_size(frame_size)
+        , m_frame_elements(frame_size * num_channels)
+        , m_convert(convert)
+    {
+        m_ring.resize(m_frame_elements * 2);
+    }
+
+    int getNumChannels() const { return m_num_channels; }
+    size_t getFrameSize() const { return m_frame_size; }
+    // samples per channel waiting for a complete frame
+    size_t getNumPendingSamples() const { return m_size / m_num_channels; }
+    // samples per channel pushed so far, including padding
+    uint64_t getNumPushedSamples() const { return m_position + getNumPendingSamples(); }
+
+    // appends interleaved samples
+    void push(const float *samples, size_t num)
+    {
+        reserve(m_size + num);
+        size_t cap = m_ring.size();
+        size_t wpos = (m_read + m_size) % cap;
+        size_t first = std::min<size_t>(num, cap - wpos);
+        m_convert(&m_ring[wpos], samples, first);
+        if (num > first) {
+            m_convert(&m_ring[0], samples + first, num - first);
+        }
+        m_size += num;
+    }
+
+    // appends num_samples samples per channel of silence
+    void pad(size_t num_samples)
+    {
+        size_t num = num_samples * m_num_channels;
+        reserve(m_size + num);
+        size_t cap = m_ring.size();
+        size_t wpos = (m_read + m_size) % cap;
+        size_t first = std::min<size_t>(num, cap - wpos);
+        std::fill(&m_ring[wpos], &m_ring[wpos] + first, T());
+        std::fill(&m_ring[0], &m_ring[0] + (num - first), T());
+        m_size += num;
+    }
+
+    // Body: [](const T *frame, uint64_t position) -> bool
+    // called for each complete frame. position is the frame's first sample. returning false stops and keeps the frame.
+    template<class Body>
+    void eachFrames(const Body& body)
+    {
+        while (m_size >= m_frame_elements) {
+            if (!body(&m_ring[m_read], m_position)) { break; }
+            consume(m_frame_elements);
+        }
+    }
+
+    // Body: [](const T *data, size_t num_samples, uint64_t position) -> void
+    // passes all pending samples (less than a frame after eachFrames()) as one contiguous block and consumes them.
+    template<class Body>
+    void flush(const Body& body)
+    {
+        if (m_size == 0) { return; }
+        if (m_read + m_size > m_ring.size()) {
+            realloc(m_ring.size());
+        }
+        body(&m_ring[m_read], getNumPendingSamples(), m_position);
+        consume(m_size);
+    }
+
+private:
+    void consume(size_t num)
+    {
+        m_read = (m_read + num) % m_ring.size();
+        m_size -= num;
+        m_position += num / m_num_channels;
+        if (m_size == 0) {
+            m_read = 0; // keeps m_read aligned to the frame size even after a partial flush
+        }
+    }
+
+    void reserve(size_t num)
+    {
+        if (num <= m_ring.size()) { return; }
+        realloc(std::max<size_t>(num, m_ring.size() * 2));
+    }
+
+    // moves pending samples to the beginning of a ring of at least capacity elements
+    void realloc(size_t capacity)
+    {
+        capacity = ceildiv(capacity, m_frame_elements) * m_frame_elements;
+        RawVector<T> tmp(capacity);
+        size_t cap = m_ring.size();
+        size_t first = std::min<size_t>(m_size, cap - m_read);
+        memcpy(tmp.data(), &m_ring[m_read], sizeof(T) * first);
+        memcpy(tmp.data() + first, m_ring.data(), sizeof(T) * (m_size - first));
+        m_ring = std::move(tmp);
+        m_read = 0;
+    }
+
+    int m_num_channels;
+    size_t m_frame_size;
+    size_t m_frame_elements;
+    Convert m_convert;
+
+    RawVector<T> m_ring;
+    size_t m_read = 0;      // index of the first pending element
+    size_t m_size = 0;      // number of pending elements
+    uint64_t m_position = 0; // samples per channel consumed so far
+};
@@ -1,25 +1,366 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "Buffer.h"
-
-fcAPI void* AlignedAlloc(size_t size, size_t alignment)
-{
-    size_t mask = alignment - 1;
-    size = (size + mask) & (~mask);
-#ifdef __APPLE__
-    void *ret;
-    posix_memalign(&ret, alignment, size);
-    return ret;
-#else
-    return _mm_malloc(size, alignment);
-#endif
-}
-
-fcAPI void AlignedFree(void *addr)
-{
-#ifdef __APPLE__
-    free(addr);
-#else
-    _mm_free(addr);
-#endif
-}
+#include "pch.h"
+#include "fcInternal.h"
+#include "Buffer.h"
+
+#if defined(fcWindows)
+    #include <windows.h>
+#elif defined(fcLinux)
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#if defined(fcWindows) || defined(fcLinux)
+    #define fcEnableLargeAlloc
+#endif
+
+
+// large allocations (frame buffers etc) bypass the heap and are mapped directly with huge pages if possible.
+// they are always aligned to LargeBlockAlignment. AlignedFree() uses that to skip the block table lookup for most pointers.
+namespace {
+
+#ifdef fcWindows
+const size_t LargeBlockAlignment = 64 * 1024; // VirtualAlloc() granularity
+#else
+const size_t LargeBlockAlignment = 2 * 1024 * 1024;
+#endif
+const size_t HugePageSize = 2 * 1024 * 1024;
+
+enum class LargeBlockType
+{
+    Pages,
+    HugePages,
+};
+
+struct LargeBlock
+{
+    void *base;
+    size_t mapped_size;
+    LargeBlockType type;
+    bool numa_bound;
+};
+
+struct AllocatorState
+{
+    std::mutex mutex;
+    std::map<void*, LargeBlock> large_blocks;
+
+    std::atomic<size_t> large_alloc_threshold = { fcAllocatorConfig().large_alloc_threshold };
+    std::atomic<bool> use_huge_pages = { fcAllocatorConfig().use_huge_pages };
+    std::atomic<bool> numa_local = { fcAllocatorConfig().numa_local };
+
+    std::atomic<uint64_t> heap_bytes = { 0 };
+    std::atomic<uint64_t> large_bytes = { 0 };
+    std::atomic<uint64_t> huge_page_bytes = { 0 };
+    std::atomic<uint64_t> numa_bound_bytes = { 0 };
+    std::atomic<int> num_large_blocks = { 0 };
+};
+
+AllocatorState& GetAllocatorState()
+{
+    // intentionally never destroyed. buffers may be released during static destruction.
+    static AllocatorState *s_state = new AllocatorState();
+    return *s_state;
+}
+
+size_t RoundUp(size_t v, size_t align)
+{
+    return (v + align - 1) & ~(align - 1);
+}
+
+
+void* HeapAlignedAlloc(size_t size, size_t alignment)
+{
+#ifdef fcWindows
+    return _aligned_malloc(size, alignment);
+#else
+    void *ret = nullptr;
+    if (posix_memalign(&ret, alignment, size) != 0) {
+        return nullptr;
+    }
+    return ret;
+#endif
+}
+
+void HeapAlignedFree(void *addr)
+{
+#ifdef fcWindows
+    _aligned_free(addr);
+#else
+    free(addr);
+#endif
+}
+
+
+#ifdef fcEnableLargeAlloc
+
+#ifdef fcLinux
+// bind pages to the NUMA node of the calling thread, which is the thread that allocates (usually the one that adds frames),
+// not necessarily the worker that touches the memory later. no libnuma dependency.
+bool BindToCurrentNode(void *addr, size_t size)
+{
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= 64) {
+        return false;
+    }
+    const int MPOL_PREFERRED_ = 1;
+    unsigned long nodemask = 1ul << node;
+    // the kernel reads maxnode - 1 bits of the mask
+    return syscall(SYS_mbind, addr, size, MPOL_PREFERRED_, &nodemask, sizeof(nodemask) * 8 + 1, 0) == 0;
+}
+#endif
+
+void* LargeAlloc(size_t size, bool use_huge_pages, bool numa_local)
+{
+    auto& state = GetAllocatorState();
+    LargeBlock block = {};
+    void *ret = nullptr;
+    bool numa_bound = false;
+
+#if defined(fcWindows)
+    size = RoundUp(size, LargeBlockAlignment);
+    DWORD flags = MEM_RESERVE | MEM_COMMIT;
+    UCHAR node = 0;
+    bool numa = numa_local && GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &node);
+    auto valloc = [&](size_t s, DWORD f) -> void* {
+        return numa ?
+            VirtualAllocExNuma(GetCurrentProcess(), nullptr, s, f, PAGE_READWRITE, node) :
+            VirtualAlloc(nullptr, s, f, PAGE_READWRITE);
+    };
+
+    // MEM_LARGE_PAGES requires SeLockMemoryPrivilege. fall back to regular pages if it fails.
+    size_t large_page_size = GetLargePageMinimum();
+    if (use_huge_pages && large_page_size > 0) {
+        size_t s = RoundUp(size, large_page_size);
+        ret = valloc(s, flags | MEM_LARGE_PAGES);
+        if (ret) {
+            block = { ret, s, LargeBlockType::HugePages };
+        }
+    }
+    if (!ret) {
+        ret = valloc(size, flags);
+        if (ret) {
+            block = { ret, size, LargeBlockType::Pages };
+        }
+    }
+    numa_bound = ret && numa;
+
+#elif defined(fcLinux)
+    size = RoundUp(size, HugePageSize);
+    if (use_huge_pages) {
+        // explicit huge pages. fails unless the system has reserved them (vm.nr_hugepages).
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            ret = p;
+            block = { ret, size, LargeBlockType::HugePages };
+        }
+    }
+    if (!ret) {
+        // over-allocate to align to 2MB, then trim both ends so that THP can back the whole range.
+        size_t mapped_size = size + LargeBlockAlignment;
+        char *p = (char*)mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == (char*)MAP_FAILED) {
+            return nullptr;
+        }
+        char *aligned = (char*)RoundUp((size_t)p, LargeBlockAlignment);
+        if (aligned > p) {
+            munmap(p, aligned - p);
+        }
+        size_t tail = (p + mapped_size) - (aligned + size);
+        if (tail > 0) {
+            munmap(aligned + size, tail);
+        }
+        ret = aligned;
+        block = { ret, size, LargeBlockType::Pages };
+        if (use_huge_pages) {
+            madvise(ret, size, MADV_HUGEPAGE);
+        }
+    }
+    if (numa_local) {
+        numa_bound = BindToCurrentNode(ret, size);
+    }
+#endif
+
+    if (!ret) { return nullptr; }
+
+    if (block.type == LargeBlockType::HugePages) {
+        state.huge_page_bytes += block.mapped_size;
+    }
+    else {
+        state.large_bytes += block.mapped_size;
+    }
+    if (numa_bound) {
+        state.numa_bound_bytes += block.mapped_size;
+    }
+    block.numa_bound = numa_bound;
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.large_blocks[ret] = block;
+    }
+    ++state.num_large_blocks;
+    return ret;
+}
+
+// return false if addr is not a large block
+bool LargeFree(void *addr)
+{
+    auto& state = GetAllocatorState();
+    if (state.num_large_blocks == 0 || ((size_t)addr & (LargeBlockAlignment - 1)) != 0) {
+        return false;
+    }
+
+    LargeBlock block;
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        auto it = state.large_blocks.find(addr);
+        if (it == state.large_blocks.end()) {
+            return false;
+        }
+        block = it->second;
+        state.large_blocks.erase(it);
+    }
+    --state.num_large_blocks;
+
+    if (block.type == LargeBlockType::HugePages) {
+        state.huge_page_bytes -= block.mapped_size;
+    }
+    else {
+        state.large_bytes -= block.mapped_size;
+    }
+    if (block.numa_bound) {
+        state.numa_bound_bytes -= block.mapped_size;
+    }
+
+#if defined(fcWindows)
+    VirtualFree(block.base, 0, MEM_RELEASE);
+#elif defined(fcLinux)
+    munmap(block.base, block.mapped_size);
+#endif
+    return true;
+}
+
+// mapped size of addr or 0 if addr is not a large block
+size_t LargeBlockSize(void *addr)
+{
+    auto& state = GetAllocatorState();
+    if (state.num_large_blocks == 0 || ((size_t)addr & (LargeBlockAlignment - 1)) != 0) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(state.mutex);
+    auto it = state.large_blocks.find(addr);
+    return it != state.large_blocks.end() ? it->second.mapped_size : 0;
+}
+
+#endif // fcEnableLargeAlloc
+
+} // namespace
+
+
+fcAPI void* AlignedAlloc(size_t size, size_t alignment)
+{
+    auto& state = GetAllocatorState();
+    size_t mask = alignment - 1;
+    size_t aligned_size = (size + mask) & (~mask);
+
+#ifdef fcEnableLargeAlloc
+    if (aligned_size >= state.large_alloc_threshold && alignment <= LargeBlockAlignment) {
+        if (void *ret = LargeAlloc(aligned_size, state.use_huge_pages, state.numa_local)) {
+            return ret;
+        }
+    }
+#endif
+    // heap blocks are accounted with the requested size, which is what AlignedFree() gets back
+    void *ret = HeapAlignedAlloc(aligned_size, alignment);
+    if (ret) {
+        state.heap_bytes += size;
+    }
+    return ret;
+}
+
+void* AlignedAllocLarge(size_t size, size_t alignment, bool use_huge_pages)
+{
+#ifdef fcEnableLargeAlloc
+    if (alignment <= LargeBlockAlignment) {
+        size_t mask = alignment - 1;
+        if (void *ret = LargeAlloc((size + mask) & (~mask), use_huge_pages, GetAllocatorState().numa_local)) {
+            return ret;
+        }
+    }
+#endif
+    return AlignedAlloc(size, alignment);
+}
+
+fcAPI void* AlignedRealloc(void *addr, size_t oldsize, size_t size, size_t alignment)
+{
+    if (!addr) { return AlignedAlloc(size, alignment); }
+
+    auto& state = GetAllocatorState();
+    size_t mask = alignment - 1;
+    size_t aligned_size = (size + mask) & (~mask);
+
+#ifdef fcEnableLargeAlloc
+    // large blocks and blocks that are about to become large are moved by alloc + copy.
+    // realloc() can't handle both sides of that.
+    size_t large_size = LargeBlockSize(addr);
+    if (large_size > 0 && aligned_size <= large_size) {
+        return addr;
+    }
+    if (large_size > 0 || aligned_size >= state.large_alloc_threshold) {
+        void *ret = AlignedAlloc(size, alignment);
+        if (ret) {
+            memcpy(ret, addr, std::min<size_t>(oldsize, size));
+            AlignedFree(addr, oldsize);
+        }
+        return ret;
+    }
+#endif
+
+#ifdef fcWindows
+    void *ret = _aligned_realloc(addr, aligned_size, alignment);
+#else
+    // realloc() may extend the block in place (or mremap() large blocks) but doesn't guarantee alignment.
+    // fall back to aligned allocation + copy if the result is misaligned.
+    void *ret = realloc(addr, aligned_size);
+    if (ret && ((size_t)ret & mask) != 0) {
+        void *aligned = HeapAlignedAlloc(aligned_size, alignment);
+        if (aligned) {
+            memcpy(aligned, ret, aligned_size);
+        }
+        free(ret);
+        ret = aligned;
+    }
+#endif
+    if (ret) {
+        state.heap_bytes += size;
+        state.heap_bytes -= oldsize;
+    }
+    return ret;
+}
+
+fcAPI void AlignedFree(void *addr, size_t size)
+{
+    if (!addr) { return; }
+#ifdef fcEnableLargeAlloc
+    if (LargeFree(addr)) { return; }
+#endif
+    HeapAlignedFree(addr);
+    GetAllocatorState().heap_bytes -= size;
+}
+
+
+void AllocatorSetConfig(const fcAllocatorConfig& conf)
+{
+    auto& state = GetAllocatorState();
+    state.large_alloc_threshold = conf.large_alloc_threshold;
+    state.use_huge_pages = conf.use_huge_pages;
+    state.numa_local = conf.numa_local;
+}
+
+void AllocatorGetStats(fcAllocatorStats& dst)
+{
+    auto& state = GetAllocatorState();
+    dst.heap_bytes = state.heap_bytes;
+    dst.large_bytes = state.large_bytes;
+    dst.huge_page_bytes = state.huge_page_bytes;
+    dst.numa_bound_bytes = state.numa_bound_bytes;
+}
@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "fcInternal.h"
+#include "Buffer.h"
+#include "BufferPool.h"
+
+
+BufferPool& BufferPool::getInstance()
+{
+    // intentionally never destroyed. pooled buffers may be released during static destruction.
+    static BufferPool *s_instance = new BufferPool();
+    return *s_instance;
+}
+
+BufferPool::BufferPool()
+{
+}
+
+size_t BufferPool::roundSize(size_t size)
+{
+    if (size < MinPooledSize) { return size; }
+
+    // 4 size classes per power of two. wastes 25% at worst.
+    size_t step = MinPooledSize / 4;
+    while (step * 8 <= size) { step *= 2; }
+    return (size + step - 1) / step * step;
+}
+
+void* BufferPool::allocate(size_t size)
+{
+    if (size == 0) { return nullptr; }
+    if (size < MinPooledSize) {
+        return AlignedAlloc(size, AlignedAllocator::alignment);
+    }
+
+    size = roundSize(size);
+    bool huge = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        huge = m_conf.use_huge_pages && size >= HugePageSize;
+        ++m_allocations;
+        auto it = m_free_blocks.find(size);
+        if (it != m_free_blocks.end() && !it->second.empty()) {
+            void *ret = it->second.back();
+            it->second.pop_back();
+            m_cached_bytes -= size;
+            ++m_reuses;
+            return ret;
+        }
+    }
+    return allocateBlock(size, huge);
+}
+
+void BufferPool::deallocate(void *addr, size_t size)
+{
+    if (!addr) { return; }
+    if (size < MinPooledSize) {
+        AlignedFree(addr, size);
+        return;
+    }
+
+    size = roundSize(size);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_cached_bytes + size <= m_conf.max_cached_bytes) {
+            m_free_blocks[size].push_back(addr);
+            m_cached_bytes += size;
+            return;
+        }
+    }
+    freeBlock(addr, size);
+}
+
+void BufferPool::setConfig(const fcBufferPoolConfig& conf)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_conf = conf;
+    }
+    releaseCache();
+}
+
+void BufferPool::releaseCache()
+{
+    std::map<size_t, std::vector<void*>> blocks;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        blocks.swap(m_free_blocks);
+        m_cached_bytes = 0;
+    }
+    for (auto& kvp : blocks) {
+        for (auto p : kvp.second) { freeBlock(p, kvp.first); }
+    }
+}
+
+void BufferPool::getStats(fcBufferPoolStats& dst)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    dst.allocations = m_allocations;
+    dst.reuses = m_reuses;
+    dst.cached_bytes = m_cached_bytes;
+}
+
+void* BufferPool::allocateBlock(size_t size, bool huge)
+{
+    // other blocks still get huge pages from AlignedAlloc() if fcAllocatorConfig asks for them
+    if (huge) {
+        return AlignedAllocLarge(size, AlignedAllocator::alignment, true);
+    }
+    return AlignedAlloc(size, AlignedAllocator::alignment);
+}
+
+void BufferPool::freeBlock(void *addr, size_t size)
+{
+    AlignedFree(addr, size);
+}
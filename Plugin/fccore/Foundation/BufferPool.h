@@ -0,0 +1,63 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include "Buffer.h"
+
+// size-classed pool for large per-frame scratch memory (frame copies, conversion buffers etc).
+// released blocks are cached per size class and handed out again on the next request of the same class,
+// so encoders that allocate a frame-sized buffer every frame don't hit the heap (and page faults) each time.
+// thread safe.
+class BufferPool
+{
+public:
+    static BufferPool& getInstance();
+
+    void*   allocate(size_t size);
+    void    deallocate(void *addr, size_t size);
+
+    void    setConfig(const fcBufferPoolConfig& conf);
+    void    releaseCache();
+    void    getStats(fcBufferPoolStats& dst);
+
+    // size of the block actually allocated for size. blocks smaller than MinPooledSize are not pooled.
+    static size_t roundSize(size_t size);
+
+    static const size_t MinPooledSize = 64 * 1024;
+    static const size_t HugePageSize = 2 * 1024 * 1024;
+
+private:
+    BufferPool();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    void* allocateBlock(size_t size, bool huge);
+    void  freeBlock(void *addr, size_t size);
+
+    std::mutex m_mutex;
+    std::map<size_t, std::vector<void*>> m_free_blocks;
+    fcBufferPoolConfig m_conf;
+    size_t m_cached_bytes = 0;
+    uint64_t m_allocations = 0;
+    uint64_t m_reuses = 0;
+};
+
+// RawVector<> allocator policy that draws memory from BufferPool
+struct PooledAllocator
+{
+    static void* allocate(size_t size) { return BufferPool::getInstance().allocate(size); }
+    static void* reallocate(void *addr, size_t oldsize, size_t newsize)
+    {
+        if (BufferPool::roundSize(oldsize) == BufferPool::roundSize(newsize)) {
+            return addr;
+        }
+        void *ret = allocate(newsize);
+        memcpy(ret, addr, std::min<size_t>(oldsize, newsize));
+        deallocate(addr, oldsize);
+        return ret;
+    }
+    static void  deallocate(void *addr, size_t size) { BufferPool::getInstance().deallocate(addr, size); }
+};
+
+typedef RawVector<char, PooledAllocator> PooledBuffer;
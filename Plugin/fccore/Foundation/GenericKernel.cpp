@@ -0,0 +1,418 @@
+#include "pch.h"
+#include "fcInternal.h"
+#include "GenericKernel.h"
+
+namespace generic {
+
+namespace {
+
+// element types. i16 is the 0-255 scaled integer format of the ISPC kernels, F16 holds raw half bits.
+struct F16 { uint16_t bits; };
+
+inline float HalfToFloat(uint16_t h)
+{
+    union { uint32_t u; float f; } o, magic = { 113 << 23 };
+    const uint32_t shifted_exp = 0x7c00 << 13;
+    o.u = (h & 0x7fff) << 13;
+    uint32_t exp = shifted_exp & o.u;
+    o.u += (127 - 15) << 23;
+    if (exp == shifted_exp) { // inf / nan
+        o.u += (128 - 16) << 23;
+    }
+    else if (exp == 0) { // denormal
+        o.u += 1 << 23;
+        o.f -= magic.f;
+    }
+    o.u |= (uint32_t)(h & 0x8000) << 16;
+    return o.f;
+}
+
+// round to nearest even, same as ISPC's float_to_half()
+inline uint16_t FloatToHalf(float f)
+{
+    union { uint32_t u; float f; } v,
+        f32infty = { 255 << 23 },
+        f16max = { (127 + 16) << 23 },
+        denorm_magic = { ((127 - 15) + (23 - 10) + 1) << 23 };
+    v.f = f;
+    uint32_t sign = v.u & 0x80000000u;
+    v.u ^= sign;
+
+    uint16_t o;
+    if (v.u >= f16max.u) {
+        o = v.u > f32infty.u ? 0x7e00 : 0x7c00;
+    }
+    else if (v.u < (113 << 23)) {
+        v.f += denorm_magic.f;
+        o = (uint16_t)(v.u - denorm_magic.u);
+    }
+    else {
+        uint32_t mant_odd = (v.u >> 13) & 1;
+        v.u += ((uint32_t)(15 - 127) << 23) + 0xfff;
+        v.u += mant_odd;
+        o = (uint16_t)(v.u >> 13);
+    }
+    return o | (uint16_t)(sign >> 16);
+}
+
+inline uint16_t SignBit16(float v) { return v < 0.0f ? 0x8000 : 0; }
+
+// cvt(dst, src): element conversions. mirror to_u8() / to_i16() / to_i32() / to_f16() / to_f32() in ConvertKernel.ispc.
+inline void cvt(uint8_t& d, uint8_t s)   { d = s; }
+inline void cvt(uint8_t& d, uint16_t s)  { d = s & 0xff; }
+inline void cvt(uint8_t& d, F16 s)       { d = (int)(HalfToFloat(s.bits) * 255.0f) & 0xff; }
+inline void cvt(uint8_t& d, float s)     { d = (int)(s * 255.0f) & 0xff; }
+inline void cvt(uint8_t& d, int32_t s)   { d = s & 0xff; }
+
+inline void cvt(uint16_t& d, uint8_t s)  { d = s; }
+inline void cvt(uint16_t& d, uint16_t s) { d = s; }
+inline void cvt(uint16_t& d, float s)    { d = (uint16_t)((int)(s * 255.0f) | SignBit16(s)); }
+inline void cvt(uint16_t& d, F16 s)      { cvt(d, HalfToFloat(s.bits)); }
+inline void cvt(uint16_t& d, int32_t s)  { d = (uint16_t)s; }
+
+// i32 uses the same 0-255 scale as i16
+inline void cvt(int32_t& d, uint8_t s)   { d = s; }
+inline void cvt(int32_t& d, uint16_t s)  { d = s; }
+inline void cvt(int32_t& d, int32_t s)   { d = s; }
+inline void cvt(int32_t& d, F16 s)       { d = (int)(HalfToFloat(s.bits) * 255.0f); }
+inline void cvt(int32_t& d, float s)     { d = (int)(s * 255.0f); }
+
+inline void cvt(F16& d, uint8_t s)       { d.bits = FloatToHalf((float)s / 255.0f); }
+inline void cvt(F16& d, uint16_t s)      { d.bits = FloatToHalf((float)s / 255.0f); }
+inline void cvt(F16& d, F16 s)           { d = s; }
+inline void cvt(F16& d, float s)         { d.bits = FloatToHalf(s); }
+inline void cvt(F16& d, int32_t s)       { d.bits = FloatToHalf((float)s / 255.0f); }
+
+inline void cvt(float& d, uint8_t s)     { d = (float)s / 255.0f; }
+inline void cvt(float& d, uint16_t s)    { d = (float)s / 255.0f; }
+inline void cvt(float& d, F16 s)         { d = HalfToFloat(s.bits); }
+inline void cvt(float& d, float s)       { d = s; }
+inline void cvt(float& d, int32_t s)     { d = (float)s / 255.0f; }
+
+// missing channels are filled the same way as the ISPC kernels:
+// R -> RGB(A) replicates R, other missing color channels are 0 and missing alpha is 1.
+template<class D, class S, int DN, int SN>
+void ConvertPixels(D *dst, const S *src, size_t size)
+{
+    D zero, one;
+    cvt(zero, 0.0f);
+    cvt(one, 1.0f);
+    for (size_t i = 0; i < size; ++i) {
+        D *d = dst + i * DN;
+        const S *s = src + i * SN;
+        for (int c = 0; c < DN; ++c) {
+            if (c < SN)                     { cvt(d[c], s[c]); }
+            else if (c == 3)                { d[c] = one; }
+            else if (SN == 1 && DN >= 3)    { cvt(d[c], s[0]); }
+            else                            { d[c] = zero; }
+        }
+    }
+}
+
+template<class D, class S, int SN>
+bool ConvertDN(void *dst, int dn, const void *src, size_t size)
+{
+    switch (dn) {
+    case 1: ConvertPixels<D, S, 1, SN>((D*)dst, (const S*)src, size); return true;
+    case 2: ConvertPixels<D, S, 2, SN>((D*)dst, (const S*)src, size); return true;
+    case 3: ConvertPixels<D, S, 3, SN>((D*)dst, (const S*)src, size); return true;
+    case 4: ConvertPixels<D, S, 4, SN>((D*)dst, (const S*)src, size); return true;
+    }
+    return false;
+}
+
+template<class D, class S>
+bool ConvertSN(void *dst, int dn, const void *src, int sn, size_t size)
+{
+    switch (sn) {
+    case 1: return ConvertDN<D, S, 1>(dst, dn, src, size);
+    case 2: return ConvertDN<D, S, 2>(dst, dn, src, size);
+    case 3: return ConvertDN<D, S, 3>(dst, dn, src, size);
+    case 4: return ConvertDN<D, S, 4>(dst, dn, src, size);
+    }
+    return false;
+}
+
+template<class D>
+bool ConvertST(void *dst, int dn, const void *src, int stype, int sn, size_t size)
+{
+    switch (stype) {
+    case fcPixelFormat_Type_u8:  return ConvertSN<D, uint8_t>(dst, dn, src, sn, size);
+    case fcPixelFormat_Type_i16: return ConvertSN<D, uint16_t>(dst, dn, src, sn, size);
+    case fcPixelFormat_Type_i32: return ConvertSN<D, int32_t>(dst, dn, src, sn, size);
+    case fcPixelFormat_Type_f16: return ConvertSN<D, F16>(dst, dn, src, sn, size);
+    case fcPixelFormat_Type_f32: return ConvertSN<D, float>(dst, dn, src, sn, size);
+    }
+    return false;
+}
+
+
+inline float Load(const uint8_t *src, int i) { return (float)src[i] * (1.0f / 255.0f); }
+inline float Load(const int16_t *src, int i) { return std::min<float>(std::max<float>(HalfToFloat((uint16_t)src[i]), 0.0f), 1.0f); }
+inline float Load(const float *src, int i)   { return std::min<float>(std::max<float>(src[i], 0.0f), 1.0f); }
+
+inline uint8_t ToYUV8(float v) { return (uint8_t)std::min<int>(std::max<int>((int)(v + 0.5f), 0), 255); }
+
+inline float Dot3(const float *m, int row, float r, float g, float b)
+{
+    return m[row * 4 + 0] * r + m[row * 4 + 1] * g + m[row * 4 + 2] * b + m[row * 4 + 3];
+}
+
+// see YUVKernel.ispc. writes luma of a 2x2 block and returns its average RGB.
+template<class T>
+inline void YUVBlock(uint8_t *dst_y, int oy0, int oy1, const T *src, int i0, int i1, int x, int width, const float *m,
+    float& ra, float& ga, float& ba)
+{
+    int x0 = x * 2;
+    int x1 = std::min<int>(x0 + 1, width - 1);
+    float r00 = Load(src, i0 + x0 * 4 + 0), g00 = Load(src, i0 + x0 * 4 + 1), b00 = Load(src, i0 + x0 * 4 + 2);
+    float r01 = Load(src, i0 + x1 * 4 + 0), g01 = Load(src, i0 + x1 * 4 + 1), b01 = Load(src, i0 + x1 * 4 + 2);
+    float r10 = Load(src, i1 + x0 * 4 + 0), g10 = Load(src, i1 + x0 * 4 + 1), b10 = Load(src, i1 + x0 * 4 + 2);
+    float r11 = Load(src, i1 + x1 * 4 + 0), g11 = Load(src, i1 + x1 * 4 + 1), b11 = Load(src, i1 + x1 * 4 + 2);
+    dst_y[oy0 + x0] = ToYUV8(Dot3(m, 0, r00, g00, b00));
+    dst_y[oy0 + x1] = ToYUV8(Dot3(m, 0, r01, g01, b01));
+    dst_y[oy1 + x0] = ToYUV8(Dot3(m, 0, r10, g10, b10));
+    dst_y[oy1 + x1] = ToYUV8(Dot3(m, 0, r11, g11, b11));
+    ra = (r00 + r01 + r10 + r11) * 0.25f;
+    ga = (g00 + g01 + g10 + g11) * 0.25f;
+    ba = (b00 + b01 + b10 + b11) * 0.25f;
+}
+
+template<class T>
+void ToI420(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int pitch_y, int pitch_u, int pitch_v,
+    const T *src, int src_pitch, int width, int height, const float *m)
+{
+    for (int y = 0; y < height; y += 2) {
+        int i0 = src_pitch * y;
+        int i1 = src_pitch * std::min<int>(y + 1, height - 1);
+        int oy0 = pitch_y * y;
+        int oy1 = pitch_y * std::min<int>(y + 1, height - 1);
+        int ou = pitch_u * (y / 2);
+        int ov = pitch_v * (y / 2);
+        for (int x = 0; x < (width + 1) / 2; ++x) {
+            float ra, ga, ba;
+            YUVBlock(dst_y, oy0, oy1, src, i0, i1, x, width, m, ra, ga, ba);
+            dst_u[ou + x] = ToYUV8(Dot3(m, 1, ra, ga, ba));
+            dst_v[ov + x] = ToYUV8(Dot3(m, 2, ra, ga, ba));
+        }
+    }
+}
+
+template<class T>
+void ToNV12(uint8_t *dst_y, uint8_t *dst_uv, int pitch_y, int pitch_uv,
+    const T *src, int src_pitch, int width, int height, const float *m)
+{
+    for (int y = 0; y < height; y += 2) {
+        int i0 = src_pitch * y;
+        int i1 = src_pitch * std::min<int>(y + 1, height - 1);
+        int oy0 = pitch_y * y;
+        int oy1 = pitch_y * std::min<int>(y + 1, height - 1);
+        int ouv = pitch_uv * (y / 2);
+        for (int x = 0; x < (width + 1) / 2; ++x) {
+            float ra, ga, ba;
+            YUVBlock(dst_y, oy0, oy1, src, i0, i1, x, width, m, ra, ga, ba);
+            dst_uv[ouv + x * 2 + 0] = ToYUV8(Dot3(m, 1, ra, ga, ba));
+            dst_uv[ouv + x * 2 + 1] = ToYUV8(Dot3(m, 2, ra, ga, ba));
+        }
+    }
+}
+
+
+// TransformKernel.ispc equivalents. int16_t is f16 bits and uint16_t is the 0-255 scaled i16 format.
+inline float Fetch(const uint8_t *src, int i)  { return (float)src[i] * (1.0f / 255.0f); }
+inline float Fetch(const uint16_t *src, int i) { return (float)src[i] * (1.0f / 255.0f); }
+inline float Fetch(const int16_t *src, int i)  { return HalfToFloat((uint16_t)src[i]); }
+inline float Fetch(const float *src, int i)    { return src[i]; }
+
+inline void Put(uint8_t *dst, int i, float v)  { dst[i] = (uint8_t)std::min<int>(std::max<int>((int)(v * 255.0f + 0.5f), 0), 255); }
+inline void Put(uint16_t *dst, int i, float v) { dst[i] = (uint16_t)std::min<int>(std::max<int>((int)(v * 255.0f + 0.5f), 0), 65535); }
+inline void Put(int16_t *dst, int i, float v)  { dst[i] = (int16_t)FloatToHalf(v); }
+inline void Put(float *dst, int i, float v)    { dst[i] = v; }
+
+template<class S>
+inline void FetchPixel(float *c, const S *src, int i, int channels, float w)
+{
+    for (int ci = 0; ci < channels; ++ci) { c[ci] += Fetch(src, i + ci) * w; }
+}
+
+template<class D>
+inline void PutPixel(D *dst, int i, int dst_channels, const float *c, int src_channels)
+{
+    float fill = (src_channels == 1 && dst_channels > 2) ? c[0] : 0.0f;
+    for (int ci = 0; ci < dst_channels; ++ci) {
+        float v = ci < src_channels ? c[ci] : (ci == 3 ? 1.0f : fill);
+        Put(dst, i + ci, v);
+    }
+}
+
+template<class D, class S>
+void Transform(D *dst, int dst_pitch, int dst_channels, int dst_width, int dst_height,
+    const S *src, int src_pitch, int src_channels, int src_width, int src_height,
+    int bilinear, int y_begin, int y_end)
+{
+    if (bilinear) {
+        float rx = (float)src_width / (float)dst_width;
+        float ry = (float)src_height / (float)dst_height;
+        for (int y = y_begin; y < y_end; ++y) {
+            float fy = std::min<float>(std::max<float>(((float)y + 0.5f) * ry - 0.5f, 0.0f), (float)(src_height - 1));
+            int sy0 = (int)fy;
+            int sy1 = std::min<int>(sy0 + 1, src_height - 1);
+            float ty = fy - (float)sy0;
+            for (int x = 0; x < dst_width; ++x) {
+                float fx = std::min<float>(std::max<float>(((float)x + 0.5f) * rx - 0.5f, 0.0f), (float)(src_width - 1));
+                int sx0 = (int)fx;
+                int sx1 = std::min<int>(sx0 + 1, src_width - 1);
+                float tx = fx - (float)sx0;
+                float c[4] = {};
+                FetchPixel(c, src, src_pitch * sy0 + sx0 * src_channels, src_channels, (1.0f - tx) * (1.0f - ty));
+                FetchPixel(c, src, src_pitch * sy0 + sx1 * src_channels, src_channels, tx * (1.0f - ty));
+                FetchPixel(c, src, src_pitch * sy1 + sx0 * src_channels, src_channels, (1.0f - tx) * ty);
+                FetchPixel(c, src, src_pitch * sy1 + sx1 * src_channels, src_channels, tx * ty);
+                PutPixel(dst, dst_pitch * y + x * dst_channels, dst_channels, c, src_channels);
+            }
+        }
+    }
+    else {
+        for (int y = y_begin; y < y_end; ++y) {
+            int sy0 = (int)((int64_t)y * src_height / dst_height);
+            int sy1 = std::max<int>((int)((int64_t)(y + 1) * src_height / dst_height), sy0 + 1);
+            for (int x = 0; x < dst_width; ++x) {
+                int sx0 = (int)((int64_t)x * src_width / dst_width);
+                int sx1 = std::max<int>((int)((int64_t)(x + 1) * src_width / dst_width), sx0 + 1);
+                float w = 1.0f / (float)((sx1 - sx0) * (sy1 - sy0));
+                float c[4] = {};
+                for (int sy = sy0; sy < sy1; ++sy) {
+                    for (int sx = sx0; sx < sx1; ++sx) {
+                        FetchPixel(c, src, src_pitch * sy + sx * src_channels, src_channels, w);
+                    }
+                }
+                PutPixel(dst, dst_pitch * y + x * dst_channels, dst_channels, c, src_channels);
+            }
+        }
+    }
+}
+
+} // namespace
+
+
+void ScaleU8(uint8_t *data, uint32_t size, float scale)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        data[i] = (uint8_t)std::min<int>((int)((float)data[i] * scale), 0xff);
+    }
+}
+void ScaleI16(uint16_t *data, uint32_t size, float scale)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        float t = (float)data[i] * scale;
+        data[i] = (uint16_t)(((int)t & 0x7fff) | SignBit16(t));
+    }
+}
+void ScaleI32(int32_t *data, uint32_t size, float scale)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        data[i] = (int32_t)((float)data[i] * scale);
+    }
+}
+void ScaleF16(int16_t *data, uint32_t size, float scale)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        data[i] = (int16_t)FloatToHalf(HalfToFloat((uint16_t)data[i]) * scale);
+    }
+}
+void ScaleF32(float *data, uint32_t size, float scale)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        data[i] *= scale;
+    }
+}
+
+const void* ConvertPixelFormat(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size)
+{
+    if (dstfmt == srcfmt) { return src; }
+
+    int dn = dstfmt & fcPixelFormat_ChannelMask;
+    int sn = srcfmt & fcPixelFormat_ChannelMask;
+    int stype = srcfmt & fcPixelFormat_TypeMask;
+    switch (dstfmt & fcPixelFormat_TypeMask) {
+    case fcPixelFormat_Type_u8:  ConvertST<uint8_t>(dst, dn, src, stype, sn, size); break;
+    case fcPixelFormat_Type_i16: ConvertST<uint16_t>(dst, dn, src, stype, sn, size); break;
+    case fcPixelFormat_Type_i32: ConvertST<int32_t>(dst, dn, src, stype, sn, size); break;
+    case fcPixelFormat_Type_f16: ConvertST<F16>(dst, dn, src, stype, sn, size); break;
+    case fcPixelFormat_Type_f32: ConvertST<float>(dst, dn, src, stype, sn, size); break;
+    }
+    return dst;
+}
+
+
+void F32ToU8Samples(uint8_t *dst, const float *src, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; ++i) { dst[i] = (uint8_t)((src[i] * 0.5f + 0.5f) * 255.0f); }
+}
+void F32ToI16Samples(int16_t *dst, const float *src, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; ++i) { dst[i] = (int16_t)(src[i] * 32767.0f); }
+}
+void F32ToI24Samples(uint8_t *dst, const float *src, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        int32_t v = (int32_t)(src[i] * 8388608.0f);
+        dst[i * 3 + 0] = (v & 0x0000FF) >> 0;
+        dst[i * 3 + 1] = (v & 0x00FF00) >> 8;
+        dst[i * 3 + 2] = (v & 0xFF0000) >> 16;
+    }
+}
+void F32ToI32Samples(int32_t *dst, const float *src, uint32_t size, float scale)
+{
+    for (uint32_t i = 0; i < size; ++i) { dst[i] = (int32_t)(src[i] * scale); }
+}
+void F32DeinterleaveSamples(float *dst, const float *src, uint32_t num_frames, int num_channels, int channel)
+{
+    src += channel;
+    for (uint32_t i = 0; i < num_frames; ++i) { dst[i] = src[(size_t)i * num_channels]; }
+}
+
+
+void RGBAu8ToI420(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int pitch_y, int pitch_u, int pitch_v,
+    const uint8_t *src, int src_pitch, int width, int height, const float *m)
+{
+    ToI420(dst_y, dst_u, dst_v, pitch_y, pitch_u, pitch_v, src, src_pitch, width, height, m);
+}
+void RGBAf16ToI420(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int pitch_y, int pitch_u, int pitch_v,
+    const int16_t *src, int src_pitch, int width, int height, const float *m)
+{
+    ToI420(dst_y, dst_u, dst_v, pitch_y, pitch_u, pitch_v, src, src_pitch, width, height, m);
+}
+void RGBAf32ToI420(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int pitch_y, int pitch_u, int pitch_v,
+    const float *src, int src_pitch, int width, int height, const float *m)
+{
+    ToI420(dst_y, dst_u, dst_v, pitch_y, pitch_u, pitch_v, src, src_pitch, width, height, m);
+}
+
+void RGBAu8ToNV12(uint8_t *dst_y, uint8_t *dst_uv, int pitch_y, int pitch_uv,
+    const uint8_t *src, int src_pitch, int width, int height, const float *m)
+{
+    ToNV12(dst_y, dst_uv, pitch_y, pitch_uv, src, src_pitch, width, height, m);
+}
+void RGBAf16ToNV12(uint8_t *dst_y, uint8_t *dst_uv, int pitch_y, int pitch_uv,
+    const int16_t *src, int src_pitch, int width, int height, const float *m)
+{
+    ToNV12(dst_y, dst_uv, pitch_y, pitch_uv, src, src_pitch, width, height, m);
+}
+void RGBAf32ToNV12(uint8_t *dst_y, uint8_t *dst_uv, int pitch_y, int pitch_uv,
+    const float *src, int src_pitch, int width, int height, const float *m)
+{
+    ToNV12(dst_y, dst_uv, pitch_y, pitch_uv, src, src_pitch, width, height, m);
+}
+
+
+#define DefTransform(Src, ST, Dst, DT)\
+void Transform##Src##To##Dst(DT *dst, int dst_pitch, int dst_channels, int dst_width, int dst_height,\
+    const ST *src, int src_pitch, int src_channels, int src_width, int src_height, int bilinear, int y_begin, int y_end)\
+{\
+    Transform(dst, dst_pitch, dst_channels, dst_width, dst_height, src, src_pitch, src_channels, src_width, src_height, bilinear, y_begin, y_end);\
+}
+fcEachTransformPair(DefTransform)
+#undef DefTransform
+
+} // namespace generic
@@ -0,0 +1,67 @@
+#pragma once
+
+// ISPC kernels are always built by the VS projects. CMake builds define fcEnableISPC only when ISPC is available.
+#if defined(fcEnableISPC) || defined(_MSC_VER)
+    #define fcEnableISPCKernel
+#endif
+
+
+// portable C++ equivalents of ConvertKernel.ispc, YUVKernel.ispc and TransformKernel.ispc.
+// used when ISPC is not available (e.g. ARM builds without ISPC) or when scalar kernels are forced by fcForceScalarKernels().
+// signatures match the ispc:: ones so that call sites can switch with fcKernelCall().
+namespace generic {
+
+void ScaleU8(uint8_t *data, uint32_t size, float scale);
+void ScaleI16(uint16_t *data, uint32_t size, float scale);
+void ScaleI32(int32_t *data, uint32_t size, float scale);
+void ScaleF16(int16_t *data, uint32_t size, float scale);
+void ScaleF32(float *data, uint32_t size, float scale);
+
+// same contract as fcConvertPixelFormat(): returns src if the formats are identical, otherwise dst.
+const void* ConvertPixelFormat(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size);
+
+void F32ToU8Samples(uint8_t *dst, const float *src, uint32_t size);
+void F32ToI16Samples(int16_t *dst, const float *src, uint32_t size);
+void F32ToI24Samples(uint8_t *dst, const float *src, uint32_t size);
+void F32ToI32Samples(int32_t *dst, const float *src, uint32_t size, float scale);
+void F32DeinterleaveSamples(float *dst, const float *src, uint32_t num_frames, int num_channels, int channel);
+
+void RGBAu8ToI420(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int pitch_y, int pitch_u, int pitch_v,
+    const uint8_t *src, int src_pitch, int width, int height, const float *m);
+void RGBAf16ToI420(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int pitch_y, int pitch_u, int pitch_v,
+    const int16_t *src, int src_pitch, int width, int height, const float *m);
+void RGBAf32ToI420(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int pitch_y, int pitch_u, int pitch_v,
+    const float *src, int src_pitch, int width, int height, const float *m);
+void RGBAu8ToNV12(uint8_t *dst_y, uint8_t *dst_uv, int pitch_y, int pitch_uv,
+    const uint8_t *src, int src_pitch, int width, int height, const float *m);
+void RGBAf16ToNV12(uint8_t *dst_y, uint8_t *dst_uv, int pitch_y, int pitch_uv,
+    const int16_t *src, int src_pitch, int width, int height, const float *m);
+void RGBAf32ToNV12(uint8_t *dst_y, uint8_t *dst_uv, int pitch_y, int pitch_uv,
+    const float *src, int src_pitch, int width, int height, const float *m);
+
+
+// Src / Dst are the ISPC name suffixes, ST / DT the element types. I16 is uint16_t (0-255 scaled) and F16 is int16_t (half bits).
+#define fcEachTransformPair(Body)\
+    Body(U8, uint8_t, U8, uint8_t)    Body(U8, uint8_t, I16, uint16_t)    Body(U8, uint8_t, F16, int16_t)    Body(U8, uint8_t, F32, float)\
+    Body(I16, uint16_t, U8, uint8_t)  Body(I16, uint16_t, I16, uint16_t)  Body(I16, uint16_t, F16, int16_t)  Body(I16, uint16_t, F32, float)\
+    Body(F16, int16_t, U8, uint8_t)   Body(F16, int16_t, I16, uint16_t)   Body(F16, int16_t, F16, int16_t)   Body(F16, int16_t, F32, float)\
+    Body(F32, float, U8, uint8_t)     Body(F32, float, I16, uint16_t)     Body(F32, float, F16, int16_t)     Body(F32, float, F32, float)
+
+// TransformKernel.ispc: processes destination rows [y_begin, y_end). pitches are in elements and src_pitch may be negative.
+#define DeclTransform(Src, ST, Dst, DT)\
+    void Transform##Src##To##Dst(DT *dst, int dst_pitch, int dst_channels, int dst_width, int dst_height,\
+        const ST *src, int src_pitch, int src_channels, int src_width, int src_height, int bilinear, int y_begin, int y_end);
+fcEachTransformPair(DeclTransform)
+#undef DeclTransform
+
+} // namespace generic
+
+
+// false if ISPC is not built in or scalar kernels are forced
+bool fcISPCKernelsEnabled();
+
+#ifdef fcEnableISPCKernel
+    #define fcKernelCall(Func, ...) (fcISPCKernelsEnabled() ? ispc::Func(__VA_ARGS__) : generic::Func(__VA_ARGS__))
+#else
+    #define fcKernelCall(Func, ...) generic::Func(__VA_ARGS__)
+#endif
@@ -1,321 +1,321 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "Buffer.h"
-#include "PixelFormat.h"
-
-#define fcEnableISPCKernel
-
-
-int fcGetPixelSize(fcPixelFormat format)
-{
-    switch (format)
-    {
-    case fcPixelFormat_RGBAu8:  return 4;
-    case fcPixelFormat_RGBu8:   return 3;
-    case fcPixelFormat_RGu8:    return 2;
-    case fcPixelFormat_Ru8:     return 1;
-
-    case fcPixelFormat_RGBAf16:
-    case fcPixelFormat_RGBAi16: return 8;
-    case fcPixelFormat_RGBf16:
-    case fcPixelFormat_RGBi16:  return 6;
-    case fcPixelFormat_RGf16:
-    case fcPixelFormat_RGi16:   return 4;
-    case fcPixelFormat_Rf16:
-    case fcPixelFormat_Ri16:    return 2;
-
-    case fcPixelFormat_RGBAf32:
-    case fcPixelFormat_RGBAi32: return 16;
-    case fcPixelFormat_RGBf32:
-    case fcPixelFormat_RGBi32:  return 12;
-    case fcPixelFormat_RGf32:
-    case fcPixelFormat_RGi32:   return 8;
-    case fcPixelFormat_Rf32:
-    case fcPixelFormat_Ri32:    return 4;
-    }
-    return 0;
-}
-
-
-void fcImageFlipY(void *image_, int width, int height, fcPixelFormat fmt)
-{
-    size_t pitch = width * fcGetPixelSize(fmt);
-    Buffer buf_((size_t)pitch);
-    char *image = (char*)image_;
-    char *buf = &buf_[0];
-
-    for (int y = 0; y < height / 2; ++y) {
-        int iy = height - y - 1;
-        memcpy(buf, image + (pitch*y), pitch);
-        memcpy(image + (pitch*y), image + (pitch*iy), pitch);
-        memcpy(image + (pitch*iy), buf, pitch);
-    }
-}
-
-
-#ifdef fcEnableISPCKernel
-#include "ConvertKernel_ispc.h"
-
-void fcScaleArray(uint8_t *data, size_t size, float scale)  { ispc::ScaleU8(data, (uint32_t)size, scale); }
-void fcScaleArray(uint16_t *data, size_t size, float scale) { ispc::ScaleI16(data, (uint32_t)size, scale); }
-void fcScaleArray(int32_t *data, size_t size, float scale)  { ispc::ScaleI32(data, (uint32_t)size, scale); }
-void fcScaleArray(half *data, size_t size, float scale)     { ispc::ScaleF16((int16_t*)data, (uint32_t)size, scale); }
-void fcScaleArray(float *data, size_t size, float scale)    { ispc::ScaleF32(data, (uint32_t)size, scale); }
-
-const void* fcConvertPixelFormat_ISPC(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size_)
-{
-    uint32_t size = (uint32_t)size_;
-    switch (srcfmt) {
-    case fcPixelFormat_RGBAu8:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: return src;
-        case fcPixelFormat_RGBu8: ispc::RGBAu8ToRGBu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::RGBAu8ToRGu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGBAu8ToRu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGBAu8ToRGBAf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::RGBAu8ToRGBf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::RGBAu8ToRGf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGBAu8ToRf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGBAu8ToRGBAf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::RGBAu8ToRGBf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::RGBAu8ToRGf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGBAu8ToRf32((float*)dst, (uint8_t*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_RGBu8:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGBu8ToRGBAu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBu8: return src;
-        case fcPixelFormat_RGu8: ispc::RGBu8ToRGu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGBu8ToRu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGBu8ToRGBAf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::RGBu8ToRGBf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::RGBu8ToRGf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGBu8ToRf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGBu8ToRGBAf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::RGBu8ToRGBf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::RGBu8ToRGf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGBu8ToRf32((float*)dst, (uint8_t*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_RGu8:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGu8ToRGBAu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::RGu8ToRGBu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGu8: return src;
-        case fcPixelFormat_Ru8: ispc::RGu8ToRu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGu8ToRGBAf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::RGu8ToRGBf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::RGu8ToRGf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGu8ToRf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGu8ToRGBAf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::RGu8ToRGBf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::RGu8ToRGf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGu8ToRf32((float*)dst, (uint8_t*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_Ru8:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::Ru8ToRGBAu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::Ru8ToRGBu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::Ru8ToRGu8((uint8_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Ru8: return src;
-        case fcPixelFormat_RGBAf16: ispc::Ru8ToRGBAf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::Ru8ToRGBf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::Ru8ToRGf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::Ru8ToRf16((int16_t*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::Ru8ToRGBAf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::Ru8ToRGBf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::Ru8ToRGf32((float*)dst, (uint8_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::Ru8ToRf32((float*)dst, (uint8_t*)src, size); break;
-        }
-        break;
-
-    case fcPixelFormat_RGBAf16:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGBAf16ToRGBAu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::RGBAf16ToRGBu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::RGBAf16ToRGu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGBAf16ToRu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::RGBAf16ToRGBAi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::RGBAf16ToRGBi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::RGBAf16ToRGi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::RGBAf16ToRi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAf16: return src;
-        case fcPixelFormat_RGBf16: ispc::RGBAf16ToRGBf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::RGBAf16ToRGf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGBAf16ToRf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGBAf16ToRGBAf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::RGBAf16ToRGBf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::RGBAf16ToRGf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGBAf16ToRf32((float*)dst, (int16_t*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_RGBf16:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGBf16ToRGBAu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::RGBf16ToRGBu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::RGBf16ToRGu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGBf16ToRu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::RGBf16ToRGBAi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::RGBf16ToRGBi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::RGBf16ToRGi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::RGBf16ToRi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGBf16ToRGBAf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBf16: return src;
-        case fcPixelFormat_RGf16: ispc::RGBf16ToRGf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGBf16ToRf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGBf16ToRGBAf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::RGBf16ToRGBf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::RGBf16ToRGf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGBf16ToRf32((float*)dst, (int16_t*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_RGf16:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGf16ToRGBAu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::RGf16ToRGBu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::RGf16ToRGu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGf16ToRu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::RGf16ToRGBAi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::RGf16ToRGBi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::RGf16ToRGi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::RGf16ToRi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGf16ToRGBAf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::RGf16ToRGBf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGf16: return src;
-        case fcPixelFormat_Rf16: ispc::RGf16ToRf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGf16ToRGBAf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::RGf16ToRGBf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::RGf16ToRGf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGf16ToRf32((float*)dst, (int16_t*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_Rf16:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::Rf16ToRGBAu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::Rf16ToRGBu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::Rf16ToRGu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::Rf16ToRu8((uint8_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::Rf16ToRGBAi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::Rf16ToRGBi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::Rf16ToRGi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::Rf16ToRi16((uint16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::Rf16ToRGBAf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::Rf16ToRGBf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::Rf16ToRGf16((int16_t*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Rf16: return src;
-        case fcPixelFormat_RGBAf32: ispc::Rf16ToRGBAf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::Rf16ToRGBf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::Rf16ToRGf32((float*)dst, (int16_t*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::Rf16ToRf32((float*)dst, (int16_t*)src, size); break;
-        }
-        break;
-
-    case fcPixelFormat_RGBAf32:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGBAf32ToRGBAu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::RGBAf32ToRGBu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::RGBAf32ToRGu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGBAf32ToRu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::RGBAf32ToRGBAi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::RGBAf32ToRGBi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::RGBAf32ToRGi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::RGBAf32ToRi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGBAf32ToRGBAf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::RGBAf32ToRGBf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::RGBAf32ToRGf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGBAf32ToRf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf32: return src;
-        case fcPixelFormat_RGBf32: ispc::RGBAf32ToRGBf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::RGBAf32ToRGf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGBAf32ToRf32((float*)dst, (float*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_RGBf32:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGBf32ToRGBAu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::RGBf32ToRGBu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::RGBf32ToRGu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGBf32ToRu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::RGBf32ToRGBAi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::RGBf32ToRGBi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::RGBf32ToRGi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::RGBf32ToRi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGBf32ToRGBAf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::RGBf32ToRGBf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::RGBf32ToRGf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGBf32ToRf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGBf32ToRGBAf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBf32: return src;
-        case fcPixelFormat_RGf32: ispc::RGBf32ToRGf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_Rf32: ispc::RGBf32ToRf32((float*)dst, (float*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_RGf32:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::RGf32ToRGBAu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::RGf32ToRGBu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::RGf32ToRGu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::RGf32ToRu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::RGf32ToRGBAi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::RGf32ToRGBi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::RGf32ToRGi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::RGf32ToRi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::RGf32ToRGBAf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::RGf32ToRGBf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::RGf32ToRGf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::RGf32ToRf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::RGf32ToRGBAf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::RGf32ToRGBf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGf32: return src;
-        case fcPixelFormat_Rf32: ispc::RGf32ToRf32((float*)dst, (float*)src, size); break;
-        }
-        break;
-    case fcPixelFormat_Rf32:
-        switch (dstfmt) {
-        case fcPixelFormat_RGBAu8: ispc::Rf32ToRGBAu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBu8: ispc::Rf32ToRGBu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGu8: ispc::Rf32ToRGu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ru8: ispc::Rf32ToRu8((uint8_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAi16: ispc::Rf32ToRGBAi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBi16: ispc::Rf32ToRGBi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGi16: ispc::Rf32ToRGi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Ri16: ispc::Rf32ToRi16((uint16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf16: ispc::Rf32ToRGBAf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBf16: ispc::Rf32ToRGBf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGf16: ispc::Rf32ToRGf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_Rf16: ispc::Rf32ToRf16((int16_t*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBAf32: ispc::Rf32ToRGBAf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGBf32: ispc::Rf32ToRGBf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_RGf32: ispc::Rf32ToRGf32((float*)dst, (float*)src, size); break;
-        case fcPixelFormat_Rf32: return src;
-        }
-        break;
-    }
-    return dst;
-}
-
-fcAPI const void* fcConvertPixelFormat(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size)
-{
-    return fcConvertPixelFormat_ISPC(dst, dstfmt, src, srcfmt, size);
-}
-
-void fcF32ToU8Samples(uint8_t *dst, const float *src, size_t size)
-{
-    ispc::F32ToU8Samples(dst, src, (uint32_t)size);
-}
-void fcF32ToI16Samples(int16_t *dst, const float *src, size_t size)
-{
-    ispc::F32ToI16Samples(dst, src, (uint32_t)size);
-}
-void fcF32ToI24Samples(uint8_t *dst, const float *src, size_t size)
-{
-    ispc::F32ToI24Samples(dst, src, (uint32_t)size);
-}
-void fcF32ToI32Samples(int32_t *dst, const float *src, size_t size, float scale)
-{
-    ispc::F32ToI32Samples(dst, src, (uint32_t)size, scale);
-}
-
-#endif // fcEnableISPCKernel
+#include "pch.h"
+#include "fcInternal.h"
+#include "Buffer.h"
+#include "BufferPool.h"
+#include "PixelFormat.h"
+#include "GenericKernel.h"
+#include "ThreadPool.h"
+
+
+int fcGetPixelSize(fcPixelFormat format)
+{
+    switch (format)
+    {
+    case fcPixelFormat_RGBAu8:  return 4;
+    case fcPixelFormat_RGBu8:   return 3;
+    case fcPixelFormat_RGu8:    return 2;
+    case fcPixelFormat_Ru8:     return 1;
+
+    case fcPixelFormat_RGBAf16:
+    case fcPixelFormat_RGBAi16: return 8;
+    case fcPixelFormat_RGBf16:
+    case fcPixelFormat_RGBi16:  return 6;
+    case fcPixelFormat_RGf16:
+    case fcPixelFormat_RGi16:   return 4;
+    case fcPixelFormat_Rf16:
+    case fcPixelFormat_Ri16:    return 2;
+
+    case fcPixelFormat_RGBAf32:
+    case fcPixelFormat_RGBAi32: return 16;
+    case fcPixelFormat_RGBf32:
+    case fcPixelFormat_RGBi32:  return 12;
+    case fcPixelFormat_RGf32:
+    case fcPixelFormat_RGi32:   return 8;
+    case fcPixelFormat_Rf32:
+    case fcPixelFormat_Ri32:    return 4;
+    default:                    return 0;
+    }
+}
+
+size_t fcGetImageSize(fcPixelFormat format, int width, int height)
+{
+    size_t luma = (size_t)width * height;
+    size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    switch (format) {
+    case fcPixelFormat_I420: return luma + chroma * 2; // Y, U, V planes
+    case fcPixelFormat_NV12: return luma + chroma * 2; // Y plane, interleaved UV plane
+    default:                 return luma * fcGetPixelSize(format);
+    }
+}
+
+
+#ifdef fcEnableISPCKernel
+#include "ConvertKernel_ispc.h"
+#include "TransformKernel_ispc.h"
+#endif
+
+// set from the user thread, read by every conversion on the pool
+static std::atomic<bool> g_force_scalar_kernels = { false };
+
+bool fcISPCKernelsEnabled()
+{
+#ifdef fcEnableISPCKernel
+    return !g_force_scalar_kernels;
+#else
+    return false;
+#endif
+}
+
+fcAPI fcKernelTarget fcGetKernelTarget()
+{
+#ifdef fcEnableISPCKernel
+    if (fcISPCKernelsEnabled()) {
+        return (fcKernelTarget)ispc::GetKernelTarget();
+    }
+#endif
+    return fcKernelTarget::Scalar;
+}
+
+fcAPI void fcForceScalarKernels(bool v)
+{
+    g_force_scalar_kernels = v;
+}
+
+
+void fcScaleArray(uint8_t *data, size_t size, float scale)  { fcKernelCall(ScaleU8, data, (uint32_t)size, scale); }
+void fcScaleArray(uint16_t *data, size_t size, float scale) { fcKernelCall(ScaleI16, data, (uint32_t)size, scale); }
+void fcScaleArray(int32_t *data, size_t size, float scale)  { fcKernelCall(ScaleI32, data, (uint32_t)size, scale); }
+void fcScaleArray(half *data, size_t size, float scale)     { fcKernelCall(ScaleF16, (int16_t*)data, (uint32_t)size, scale); }
+void fcScaleArray(float *data, size_t size, float scale)    { fcKernelCall(ScaleF32, data, (uint32_t)size, scale); }
+
+// all packed formats with their element types. i16 is the 0-255 scaled integer format and f16 is half bits.
+#define EachPixelFormat(Body)\
+    Body(RGBAu8, uint8_t) Body(RGBu8, uint8_t) Body(RGu8, uint8_t) Body(Ru8, uint8_t)\
+    Body(RGBAi16, uint16_t) Body(RGBi16, uint16_t) Body(RGi16, uint16_t) Body(Ri16, uint16_t)\
+    Body(RGBAi32, int32_t) Body(RGBi32, int32_t) Body(RGi32, int32_t) Body(Ri32, int32_t)\
+    Body(RGBAf16, int16_t) Body(RGBf16, int16_t) Body(RGf16, int16_t) Body(Rf16, int16_t)\
+    Body(RGBAf32, float) Body(RGBf32, float) Body(RGf32, float) Body(Rf32, float)
+#define EachDstPixelFormat(Body, S, ST)\
+    Body(S, ST, RGBAu8, uint8_t) Body(S, ST, RGBu8, uint8_t) Body(S, ST, RGu8, uint8_t) Body(S, ST, Ru8, uint8_t)\
+    Body(S, ST, RGBAi16, uint16_t) Body(S, ST, RGBi16, uint16_t) Body(S, ST, RGi16, uint16_t) Body(S, ST, Ri16, uint16_t)\
+    Body(S, ST, RGBAi32, int32_t) Body(S, ST, RGBi32, int32_t) Body(S, ST, RGi32, int32_t) Body(S, ST, Ri32, int32_t)\
+    Body(S, ST, RGBAf16, int16_t) Body(S, ST, RGBf16, int16_t) Body(S, ST, RGf16, int16_t) Body(S, ST, Rf16, int16_t)\
+    Body(S, ST, RGBAf32, float) Body(S, ST, RGBf32, float) Body(S, ST, RGf32, float) Body(S, ST, Rf32, float)
+
+#ifdef fcEnableISPCKernel
+const void* fcConvertPixelFormat_ISPC(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size_)
+{
+    if (dstfmt == srcfmt) { return src; }
+
+    uint32_t size = (uint32_t)size_;
+    switch (srcfmt) {
+#define DstCase(S, ST, D, DT) case fcPixelFormat_##D: ispc::S##To##D((DT*)dst, (ST*)src, size); break;
+#define SrcCase(S, ST) case fcPixelFormat_##S: switch (dstfmt) { EachDstPixelFormat(DstCase, S, ST) default: break; } break;
+    EachPixelFormat(SrcCase)
+#undef SrcCase
+#undef DstCase
+    default: break;
+    }
+    return dst;
+}
+
+#endif // fcEnableISPCKernel
+
+const void* fcConvertPixelFormatSerial(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size)
+{
+#ifdef fcEnableISPCKernel
+    if (fcISPCKernelsEnabled()) {
+        return fcConvertPixelFormat_ISPC(dst, dstfmt, src, srcfmt, size);
+    }
+#endif
+    return generic::ConvertPixelFormat(dst, dstfmt, src, srcfmt, size);
+}
+
+namespace {
+// conversions of this many pixels or more are split across the shared thread pool
+const size_t ConvertParallelThreshold = 512 * 512;
+// source + destination bytes per block. roughly half of a per-core L2
+const size_t ConvertBlockBytes = 128 * 1024;
+} // namespace
+
+fcAPI const void* fcConvertPixelFormat(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size)
+{
+    if (dstfmt == srcfmt) { return src; }
+
+    size_t src_psize = fcGetPixelSize(srcfmt);
+    size_t dst_psize = fcGetPixelSize(dstfmt);
+    auto src_begin = (const char*)src;
+    auto dst_begin = (char*)dst;
+    bool overlap = dst_begin < src_begin + src_psize * size && src_begin < dst_begin + dst_psize * size;
+    if (size < ConvertParallelThreshold || overlap || src_psize == 0 || dst_psize == 0) {
+        return fcConvertPixelFormatSerial(dst, dstfmt, src, srcfmt, size);
+    }
+
+    int block_size = (int)std::max<size_t>(ConvertBlockBytes / (src_psize + dst_psize), 1024);
+    ParallelFor(0, (int)size, block_size, [&](int begin, int end) {
+        fcConvertPixelFormatSerial(dst_begin + dst_psize * begin, dstfmt, src_begin + src_psize * begin, srcfmt, end - begin);
+    });
+    return dst;
+}
+
+
+namespace {
+
+// 0 for types the transform kernels don't handle
+int GetElementSize(int type)
+{
+    switch (type) {
+    case fcPixelFormat_Type_u8:  return 1;
+    case fcPixelFormat_Type_i16: return 2;
+    case fcPixelFormat_Type_f16: return 2;
+    case fcPixelFormat_Type_f32: return 4;
+    }
+    return 0;
+}
+
+// key of fcTransformPixels()'s dispatch
+constexpr int TransformKey(int dsttype, int srctype) { return dsttype | (srctype << 8); }
+constexpr int Key_U8 = fcPixelFormat_Type_u8, Key_I16 = fcPixelFormat_Type_i16, Key_F16 = fcPixelFormat_Type_f16, Key_F32 = fcPixelFormat_Type_f32;
+
+} // namespace
+
+fcAPI bool fcTransformPixels(void *dst, fcPixelFormat dstfmt, const fcPixelRect *dst_rect,
+    const void *src, fcPixelFormat srcfmt, const fcPixelRect *src_rect, int flags)
+{
+    if (!dst || !src || !dst_rect || !src_rect) { return false; }
+
+    int dst_channels = dstfmt & fcPixelFormat_ChannelMask;
+    int src_channels = srcfmt & fcPixelFormat_ChannelMask;
+    int dst_type = dstfmt & fcPixelFormat_TypeMask;
+    int src_type = srcfmt & fcPixelFormat_TypeMask;
+    if (dst_type == fcPixelFormat_Type_i32 || src_type == fcPixelFormat_Type_i32) {
+        // no transform kernels for i32. PixelTransformStage goes through f32 instead
+        fcDebugLog("fcTransformPixels(): i32 formats are not supported\n");
+        return false;
+    }
+    int dst_esize = GetElementSize(dst_type);
+    int src_esize = GetElementSize(src_type);
+    if (dst_channels < 1 || dst_channels > 4 || src_channels < 1 || src_channels > 4 || dst_esize == 0 || src_esize == 0) {
+        fcDebugLog("fcTransformPixels(): unsupported pixel format\n");
+        return false;
+    }
+
+    const auto& dr = *dst_rect;
+    const auto& sr = *src_rect;
+    if (dr.width <= 0 || dr.height <= 0 || sr.width <= 0 || sr.height <= 0 || dr.x < 0 || dr.y < 0 || sr.x < 0 || sr.y < 0) {
+        fcDebugLog("fcTransformPixels(): invalid rect\n");
+        return false;
+    }
+    int dst_pitch = dr.pitch != 0 ? dr.pitch : (dr.x + dr.width) * dst_esize * dst_channels;
+    int src_pitch = sr.pitch != 0 ? sr.pitch : (sr.x + sr.width) * src_esize * src_channels;
+    if (dst_pitch % dst_esize != 0 || src_pitch % src_esize != 0) {
+        fcDebugLog("fcTransformPixels(): pitch must be a multiple of the element size\n");
+        return false;
+    }
+    bool fits =
+        ((int64_t)dr.x + dr.width) * dst_esize * dst_channels <= dst_pitch &&
+        ((int64_t)sr.x + sr.width) * src_esize * src_channels <= src_pitch &&
+        (dr.image_height == 0 || (int64_t)dr.y + dr.height <= dr.image_height) &&
+        (sr.image_height == 0 || (int64_t)sr.y + sr.height <= sr.image_height);
+    if (!fits) {
+        fcDebugLog("fcTransformPixels(): rect is out of the image\n");
+        return false;
+    }
+
+    // the kernels work with element pitches and the top-left of the regions. flip reads from the last row upwards.
+    dst_pitch /= dst_esize;
+    src_pitch /= src_esize;
+    auto d = (char*)dst + ((size_t)dst_pitch * dr.y + (size_t)dr.x * dst_channels) * dst_esize;
+    auto s = (const char*)src + ((size_t)src_pitch * sr.y + (size_t)sr.x * src_channels) * src_esize;
+    if (flags & fcTransform_FlipY) {
+        s += (size_t)src_pitch * (sr.height - 1) * src_esize;
+        src_pitch = -src_pitch;
+    }
+    int bilinear = (flags & fcTransform_Bilinear) ? 1 : 0;
+
+    size_t row_bytes = (size_t)dr.width * (dst_esize * dst_channels + src_esize * src_channels);
+    int block_rows = (size_t)dr.width * dr.height < ConvertParallelThreshold ?
+        dr.height : (int)std::max<size_t>(ConvertBlockBytes / row_bytes, 1);
+
+    int key = TransformKey(dst_type, src_type);
+    ParallelFor(0, dr.height, block_rows, [&](int begin, int end) {
+        switch (key) {
+#define Case(Src, ST, Dst, DT)\
+        case TransformKey(Key_##Dst, Key_##Src):\
+            fcKernelCall(Transform##Src##To##Dst, (DT*)d, dst_pitch, dst_channels, dr.width, dr.height,\
+                (ST*)s, src_pitch, src_channels, sr.width, sr.height, bilinear, begin, end);\
+            break;
+        fcEachTransformPair(Case)
+#undef Case
+        }
+    });
+    return true;
+}
+
+
+void PixelTransformStage::set(const fcPixelTransform *v)
+{
+    m_enabled = v != nullptr;
+    if (v) { m_transform = *v; }
+}
+
+bool PixelTransformStage::enabled() const
+{
+    return m_enabled;
+}
+
+bool PixelTransformStage::apply(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, int width, int height) const
+{
+    if (!m_enabled) {
+        if (dstfmt == srcfmt) {
+            memcpy(dst, src, fcGetImageSize(dstfmt, width, height));
+        }
+        else {
+            fcConvertPixelFormat(dst, dstfmt, src, srcfmt, (size_t)width * height);
+        }
+        return true;
+    }
+
+    fcPixelRect dst_rect;
+    dst_rect.width = width;
+    dst_rect.height = height;
+    if ((dstfmt & fcPixelFormat_TypeMask) == fcPixelFormat_Type_i32) {
+        // the transform kernels don't write i32. go through f32
+        auto tmpfmt = fcPixelFormat(fcPixelFormat_Type_f32 | (dstfmt & fcPixelFormat_ChannelMask));
+        PooledBuffer tmp;
+        tmp.resize((size_t)width * height * fcGetPixelSize(tmpfmt));
+        if (!fcTransformPixels(tmp.data(), tmpfmt, &dst_rect, src, srcfmt, &m_transform.src_rect, m_transform.flags)) {
+            return false;
+        }
+        fcConvertPixelFormat(dst, dstfmt, tmp.data(), tmpfmt, (size_t)width * height);
+        return true;
+    }
+    return fcTransformPixels(dst, dstfmt, &dst_rect, src, srcfmt, &m_transform.src_rect, m_transform.flags);
+}
+
+void fcF32ToU8Samples(uint8_t *dst, const float *src, size_t size)
+{
+    fcKernelCall(F32ToU8Samples, dst, src, (uint32_t)size);
+}
+void fcF32ToI16Samples(int16_t *dst, const float *src, size_t size)
+{
+    fcKernelCall(F32ToI16Samples, dst, src, (uint32_t)size);
+}
+void fcF32ToI24Samples(uint8_t *dst, const float *src, size_t size)
+{
+    fcKernelCall(F32ToI24Samples, dst, src, (uint32_t)size);
+}
+void fcF32ToI32Samples(int32_t *dst, const float *src, size_t size, float scale)
+{
+    fcKernelCall(F32ToI32Samples, dst, src, (uint32_t)size, scale);
+}
+fcAPI void fcDeinterleaveSamples(float * const *dst, const float *src, size_t num_frames, int num_channels)
+{
+    if (num_channels == 1) {
+        memcpy(dst[0], src, sizeof(float) * num_frames);
+        return;
+    }
+    for (int ci = 0; ci < num_channels; ++ci) {
+        fcKernelCall(F32DeinterleaveSamples, dst[ci], src, (uint32_t)num_frames, num_channels, ci);
+    }
+}
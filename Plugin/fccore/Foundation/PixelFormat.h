@@ -1,20 +1,43 @@
-#pragma once
-
-enum fcPixelFormat;
-int fcGetPixelSize(fcPixelFormat format);
-
-void fcImageFlipY(void *image_, int width, int height, fcPixelFormat fmt);
-
-class half;
-void fcScaleArray(uint8_t *data, size_t size, float scale);
-void fcScaleArray(uint16_t *data, size_t size, float scale);
-void fcScaleArray(int32_t *data, size_t size, float scale);
-void fcScaleArray(half *data, size_t size, float scale);
-void fcScaleArray(float *data, size_t size, float scale);
-fcAPI const void* fcConvertPixelFormat(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size);
-
-// audio sample conversion
-void fcF32ToU8Samples(uint8_t *dst, const float *src, size_t size);
-void fcF32ToI16Samples(int16_t *dst, const float *src, size_t size);
-void fcF32ToI24Samples(uint8_t *dst, const float *src, size_t size);
-void fcF32ToI32Samples(int32_t *dst, const float *src, size_t size, float scale);
+#pragma once
+
+enum fcPixelFormat;
+int fcGetPixelSize(fcPixelFormat format); // 0 for planar formats (I420 / NV12)
+// bytes of a tightly packed image. unlike fcGetPixelSize() this handles I420 / NV12.
+size_t fcGetImageSize(fcPixelFormat format, int width, int height);
+
+class half;
+void fcScaleArray(uint8_t *data, size_t size, float scale);
+void fcScaleArray(uint16_t *data, size_t size, float scale);
+void fcScaleArray(int32_t *data, size_t size, float scale);
+void fcScaleArray(half *data, size_t size, float scale);
+void fcScaleArray(float *data, size_t size, float scale);
+// large conversions are split across the shared thread pool. returns src if dstfmt == srcfmt, otherwise dst
+fcAPI const void* fcConvertPixelFormat(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size);
+// single threaded. for callers that are already running in parallel tasks
+const void* fcConvertPixelFormatSerial(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, size_t size);
+
+// crop / flip / resize + conversion. see fccore.h
+fcAPI bool fcTransformPixels(void *dst, fcPixelFormat dstfmt, const fcPixelRect *dst_rect,
+    const void *src, fcPixelFormat srcfmt, const fcPixelRect *src_rect, int flags);
+
+// input stage of the encoder contexts. copies or converts frames as is until a transform is set.
+class PixelTransformStage
+{
+public:
+    void set(const fcPixelTransform *v); // nullptr: disable
+    bool enabled() const;
+    // width / height are the output size. src layout is described by the transform's src_rect when enabled.
+    bool apply(void *dst, fcPixelFormat dstfmt, const void *src, fcPixelFormat srcfmt, int width, int height) const;
+
+private:
+    fcPixelTransform m_transform;
+    bool m_enabled = false;
+};
+
+// audio sample conversion
+void fcF32ToU8Samples(uint8_t *dst, const float *src, size_t size);
+void fcF32ToI16Samples(int16_t *dst, const float *src, size_t size);
+void fcF32ToI24Samples(uint8_t *dst, const float *src, size_t size);
+void fcF32ToI32Samples(int32_t *dst, const float *src, size_t size, float scale);
+// interleaved -> planar. dst[c] receives num_frames samples of channel c.
+fcAPI void fcDeinterleaveSamples(float * const *dst, const float *src, size_t num_frames, int num_channels);
@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "fcInternal.h"
+#include "Stats.h"
+
+
+namespace {
+
+std::mutex g_stats_mutex;
+std::map<const void*, StatsCollector*> g_stats;
+
+} // namespace
+
+
+StatsCollector::StatsCollector(const void *owner)
+    : m_owner(owner)
+    , m_start_time(GetCurrentTimeInSeconds())
+    , m_bytes_written(0)
+    , m_buffer_waits(0)
+    , m_buffer_wait_ns(0)
+    , m_tracing(false)
+{
+    std::unique_lock<std::mutex> l(g_stats_mutex);
+    g_stats[m_owner] = this;
+}
+
+StatsCollector::~StatsCollector()
+{
+    std::unique_lock<std::mutex> l(g_stats_mutex);
+    auto it = g_stats.find(m_owner);
+    if (it != g_stats.end() && it->second == this) {
+        g_stats.erase(it);
+    }
+}
+
+void StatsCollector::addStageTime(fcStatsStage stage, double begin, double end)
+{
+    if (stage < 0 || stage >= fcStatsStage_Count) { return; }
+    m_stages[stage].add(end - begin);
+
+    if (m_tracing.load(std::memory_order_relaxed)) {
+        std::unique_lock<std::mutex> l(m_trace_mutex);
+        if (m_trace.size() < MaxTraceEvents) {
+            m_trace.push_back({ stage, std::this_thread::get_id(), begin, end });
+        }
+    }
+}
+
+void StatsCollector::addBytesWritten(size_t size)
+{
+    m_bytes_written.fetch_add(size, std::memory_order_relaxed);
+}
+
+void StatsCollector::addBufferWait(double duration)
+{
+    m_buffer_waits.fetch_add(1, std::memory_order_relaxed);
+    m_buffer_wait_ns.fetch_add(ToNanoseconds(duration), std::memory_order_relaxed);
+}
+
+void StatsCollector::enqueue(Queue q)
+{
+    auto& depth = m_queues[(int)q];
+    AtomicMax(depth.max, depth.current.fetch_add(1, std::memory_order_relaxed) + 1);
+}
+
+void StatsCollector::dequeue(Queue q)
+{
+    m_queues[(int)q].current.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void StatsCollector::getStats(fcStats& dst) const
+{
+    for (int i = 0; i < fcStatsStage_Count; ++i) {
+        m_stages[i].get(dst.stages[i]);
+    }
+    auto& video = m_queues[(int)Queue::Video];
+    auto& audio = m_queues[(int)Queue::Audio];
+    dst.video_queue_depth = video.current.load(std::memory_order_relaxed);
+    dst.video_queue_depth_max = video.max.load(std::memory_order_relaxed);
+    dst.audio_queue_depth = audio.current.load(std::memory_order_relaxed);
+    dst.audio_queue_depth_max = audio.max.load(std::memory_order_relaxed);
+    dst.bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+    dst.buffer_waits = m_buffer_waits.load(std::memory_order_relaxed);
+    dst.buffer_wait_ms = double(m_buffer_wait_ns.load(std::memory_order_relaxed)) * 1e-6;
+}
+
+void StatsCollector::setTracing(bool v)
+{
+    m_tracing = v;
+}
+
+bool StatsCollector::dumpTrace(const char *path) const
+{
+    if (!path) { return false; }
+    std::ofstream os(path, std::ios::binary);
+    if (!os) {
+        fcDebugLog("StatsCollector::dumpTrace(): failed to open %s\n", path);
+        return false;
+    }
+
+    std::unique_lock<std::mutex> l(m_trace_mutex);
+    // threads are numbered in order of appearance. timestamps are microseconds since the context was created.
+    std::vector<std::thread::id> threads;
+    char buf[256];
+    os << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < m_trace.size(); ++i) {
+        const auto& e = m_trace[i];
+        size_t tid = std::find(threads.begin(), threads.end(), e.thread) - threads.begin();
+        if (tid == threads.size()) {
+            threads.push_back(e.thread);
+        }
+        sprintf(buf, "{\"name\":\"%s\",\"cat\":\"fc\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}%s\n",
+            getStageName(e.stage), (e.begin - m_start_time) * 1e6, (e.end - e.begin) * 1e6, (int)tid,
+            i + 1 < m_trace.size() ? "," : "");
+        os << buf;
+    }
+    os << "]}\n";
+    return os.good();
+}
+
+bool StatsCollector::getStats(const void *owner, fcStats& dst)
+{
+    std::unique_lock<std::mutex> l(g_stats_mutex);
+    auto it = g_stats.find(owner);
+    if (it == g_stats.end()) { return false; }
+    it->second->getStats(dst);
+    return true;
+}
+
+bool StatsCollector::setTracing(const void *owner, bool v)
+{
+    std::unique_lock<std::mutex> l(g_stats_mutex);
+    auto it = g_stats.find(owner);
+    if (it == g_stats.end()) { return false; }
+    it->second->setTracing(v);
+    return true;
+}
+
+bool StatsCollector::dumpTrace(const void *owner, const char *path)
+{
+    std::unique_lock<std::mutex> l(g_stats_mutex);
+    auto it = g_stats.find(owner);
+    if (it == g_stats.end()) { return false; }
+    return it->second->dumpTrace(path);
+}
+
+const char* StatsCollector::getStageName(fcStatsStage stage)
+{
+    switch (stage) {
+    case fcStatsStage_Readback:     return "Readback";
+    case fcStatsStage_Convert:      return "Convert";
+    case fcStatsStage_YUV:          return "YUV";
+    case fcStatsStage_Encode:       return "Encode";
+    case fcStatsStage_AudioEncode:  return "AudioEncode";
+    case fcStatsStage_Mux:          return "Mux";
+    case fcStatsStage_Write:        return "Write";
+    default:                        return "";
+    }
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include "Buffer.h"
+#include "Misc.h"
+#include "TaskQueue.h"
+
+inline uint64_t ToNanoseconds(double sec)
+{
+    return sec > 0.0 ? uint64_t(sec * 1e9 + 0.5) : 0;
+}
+
+template<class T>
+inline void AtomicMax(std::atomic<T>& dst, T v)
+{
+    T prev = dst.load(std::memory_order_relaxed);
+    while (prev < v && !dst.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {}
+}
+
+
+// log2 histogram of durations in microseconds, 4 buckets per octave (~19% resolution) from 1us to ~67s.
+// bucket 0 holds everything below 1us. add() is thread safe and lock free.
+class StatsHistogram
+{
+public:
+    static const int BucketsPerOctave = 4;
+    static const int NumBuckets = 1 + BucketsPerOctave * 26;
+
+    StatsHistogram();
+    void add(double duration); // in seconds
+    // percentiles are the geometric center of the bucket that holds them, clamped to the max
+    void get(fcStageStats& dst) const;
+
+private:
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_total_ns;
+    std::atomic<uint64_t> m_max_ns;
+    std::atomic<uint32_t> m_buckets[NumBuckets];
+};
+
+inline StatsHistogram::StatsHistogram()
+    : m_count(0), m_total_ns(0), m_max_ns(0)
+{
+    for (auto& b : m_buckets) { b.store(0, std::memory_order_relaxed); }
+}
+
+inline void StatsHistogram::add(double duration)
+{
+    double us = duration * 1e6;
+    int bucket = 0;
+    if (us >= 1.0) {
+        bucket = std::min<int>(1 + int(std::log2(us) * BucketsPerOctave), NumBuckets - 1);
+    }
+    uint64_t ns = ToNanoseconds(duration);
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_total_ns.fetch_add(ns, std::memory_order_relaxed);
+    AtomicMax(m_max_ns, ns);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void StatsHistogram::get(fcStageStats& dst) const
+{
+    uint32_t hist[NumBuckets];
+    uint64_t num = 0;
+    for (int i = 0; i < NumBuckets; ++i) {
+        hist[i] = m_buckets[i].load(std::memory_order_relaxed);
+        num += hist[i];
+    }
+    double max_ms = double(m_max_ns.load(std::memory_order_relaxed)) * 1e-6;
+
+    dst.count = num;
+    dst.total_ms = double(m_total_ns.load(std::memory_order_relaxed)) * 1e-6;
+    dst.max_ms = max_ms;
+
+    auto percentile = [&](double p) -> double {
+        if (num == 0) { return 0.0; }
+        uint64_t rank = std::max<uint64_t>(uint64_t(double(num) * p + 0.5), 1);
+        uint64_t acc = 0;
+        for (int i = 0; i < NumBuckets; ++i) {
+            acc += hist[i];
+            if (acc >= rank) {
+                if (i == 0) { return std::min<double>(0.5e-3, max_ms); }
+                double ms = std::pow(2.0, (double(i) - 0.5) / BucketsPerOctave) * 1e-3;
+                return std::min<double>(ms, max_ms);
+            }
+        }
+        return max_ms;
+    };
+    dst.p50_ms = percentile(0.50);
+    dst.p99_ms = percentile(0.99);
+}
+
+
+// per-context pipeline instrumentation. always compiled in: recording a sample is a few relaxed atomic operations,
+// which is noise next to the work being measured (a readback, a frame encode).
+// each collector registers itself under its owner (the fcI*Context pointer handed to the user) so that the fcAPI functions
+// can find it from the context alone. the registry lock is held while a collector is read, so reading races with nothing
+// but the context's own destruction, which the caller must not do concurrently (as with every other context function).
+class StatsCollector
+{
+public:
+    enum class Queue { Video, Audio };
+
+    explicit StatsCollector(const void *owner);
+    ~StatsCollector();
+
+    // thread safe. begin / end: GetCurrentTimeInSeconds()
+    void addStageTime(fcStatsStage stage, double begin, double end);
+    void addBytesWritten(size_t size);
+    void addBufferWait(double duration);
+
+    // frames handed to the context and not yet through the pipeline
+    void enqueue(Queue q);
+    void dequeue(Queue q);
+
+    // pops a free buffer from q. the time spent waiting for one is recorded as a buffer wait.
+    template<class T>
+    T popBuffer(ResourceQueue<T>& q)
+    {
+        T ret;
+        if (!q.tryPop(ret)) {
+            double begin = GetCurrentTimeInSeconds();
+            ret = q.pop();
+            addBufferWait(GetCurrentTimeInSeconds() - begin);
+        }
+        return ret;
+    }
+
+    void getStats(fcStats& dst) const;
+    // while enabled, every stage sample is also recorded as a trace event
+    void setTracing(bool v);
+    // Chrome trace event format (chrome://tracing, Perfetto)
+    bool dumpTrace(const char *path) const;
+
+    // registry access. false if no collector is registered for owner.
+    static bool getStats(const void *owner, fcStats& dst);
+    static bool setTracing(const void *owner, bool v);
+    static bool dumpTrace(const void *owner, const char *path);
+    static const char* getStageName(fcStatsStage stage);
+
+private:
+    StatsCollector(const StatsCollector&) = delete;
+    StatsCollector& operator=(const StatsCollector&) = delete;
+
+    struct QueueDepth
+    {
+        std::atomic<int> current;
+        std::atomic<int> max;
+
+        QueueDepth() : current(0), max(0) {}
+    };
+
+    struct TraceEvent
+    {
+        fcStatsStage stage;
+        std::thread::id thread;
+        double begin, end;
+    };
+    static const size_t MaxTraceEvents = 1024 * 1024;
+
+    const void *m_owner;
+    double m_start_time;
+    StatsHistogram m_stages[fcStatsStage_Count];
+    QueueDepth m_queues[2];
+    std::atomic<uint64_t> m_bytes_written;
+    std::atomic<uint64_t> m_buffer_waits;
+    std::atomic<uint64_t> m_buffer_wait_ns;
+
+    std::atomic<bool> m_tracing;
+    mutable std::mutex m_trace_mutex;
+    std::vector<TraceEvent> m_trace;
+};
+
+
+// records the time until the end of the scope as a sample of stage
+class StatsScope
+{
+public:
+    StatsScope(StatsCollector& stats, fcStatsStage stage)
+        : m_stats(stats), m_stage(stage), m_begin(GetCurrentTimeInSeconds()) {}
+    ~StatsScope() { m_stats.addStageTime(m_stage, m_begin, GetCurrentTimeInSeconds()); }
+
+private:
+    StatsCollector& m_stats;
+    fcStatsStage m_stage;
+    double m_begin;
+};
+
+
+// passes everything through to the wrapped stream and counts the bytes written.
+// containers write in many small pieces (box and element headers), so writes are not timed here: timing each one would cost
+// more than the write. the time spent writing is part of fcStatsStage_Mux.
+class StatsStream : public BinaryStream
+{
+public:
+    StatsStream(BinaryStream& s, StatsCollector& stats) : m_stream(s), m_stats(stats) {}
+
+    size_t  tellg() override            { return m_stream.tellg(); }
+    void    seekg(size_t pos) override  { m_stream.seekg(pos); }
+    size_t  read(void *dst, size_t len) override { return m_stream.read(dst, len); }
+
+    size_t  tellp() override            { return m_stream.tellp(); }
+    void    seekp(size_t pos) override  { m_stream.seekp(pos); }
+    size_t  write(const void *data, size_t len) override
+    {
+        m_stats.addBytesWritten(len);
+        return m_stream.write(data, len);
+    }
+
+private:
+    BinaryStream& m_stream;
+    StatsCollector& m_stats;
+};
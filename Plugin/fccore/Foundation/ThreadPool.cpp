@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+ThreadPool& ThreadPool::getInstance()
+{
+    // intentionally never destroyed. joining threads while the module is being unloaded would deadlock on Windows.
+    static ThreadPool *s_instance = new ThreadPool();
+    return *s_instance;
+}
+
+ThreadPool::ThreadPool()
+{
+    int n = std::max<int>(std::thread::hardware_concurrency(), 1);
+    for (int i = 0; i < n; ++i) {
+        m_threads.emplace_back([this]() { process(); });
+    }
+}
+
+int ThreadPool::getNumThreads() const
+{
+    return (int)m_threads.size();
+}
+
+void ThreadPool::run(const Task& v)
+{
+    {
+        Lock l(m_mutex);
+        m_tasks.push_back(v);
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::process()
+{
+    for (;;)
+    {
+        Task task;
+        {
+            Lock lock(m_mutex);
+            while (m_tasks.empty()) {
+                m_condition.wait(lock);
+            }
+
+            task = m_tasks.front();
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+// fixed set of worker threads shared by all contexts. used to split heavy per-frame work (pixel conversion etc).
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+    using Tasks = std::deque<Task>;
+    using Lock = std::unique_lock<std::mutex>;
+
+    static ThreadPool& getInstance();
+
+    int getNumThreads() const;
+    void run(const Task& v);
+
+private:
+    ThreadPool();
+    void process();
+
+    std::vector<std::thread> m_threads;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    Tasks                   m_tasks;
+};
+
+
+// split [begin, end) into blocks of block_size and process them on the shared thread pool.
+// the calling thread processes blocks too, and returns when all blocks are done.
+// Body: [](int begin, int end) -> void
+template<class Body>
+inline void ParallelFor(int begin, int end, int block_size, const Body& body)
+{
+    int num_blocks = (end - begin + block_size - 1) / block_size;
+    if (num_blocks <= 1) {
+        if (end > begin) { body(begin, end); }
+        return;
+    }
+
+    struct State
+    {
+        std::function<void(int, int)> body;
+        std::atomic_int next = { 0 };
+        std::atomic_int done = { 0 };
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    auto state = std::make_shared<State>();
+    state->body = std::cref(body);
+
+    auto process = [state, begin, end, block_size, num_blocks]() {
+        for (;;) {
+            int bi = state->next++;
+            if (bi >= num_blocks) { break; }
+            int b = begin + bi * block_size;
+            state->body(b, std::min<int>(b + block_size, end));
+            if (++state->done == num_blocks) {
+                ThreadPool::Lock lock(state->mutex);
+                state->condition.notify_all();
+            }
+        }
+    };
+
+    auto& pool = ThreadPool::getInstance();
+    int num_workers = std::min<int>(num_blocks - 1, pool.getNumThreads());
+    for (int i = 0; i < num_workers; ++i) {
+        pool.run(process);
+    }
+    process();
+
+    ThreadPool::Lock lock(state->mutex);
+    while (state->done < num_blocks) {
+        state->condition.wait(lock);
+    }
+}
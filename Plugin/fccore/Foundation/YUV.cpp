@@ -1,116 +1,305 @@
-#include "pch.h"
-#include "fcInternal.h"
-#include "YUV.h"
-#include "Misc.h"
-
-#include <libyuv.h>
-#ifdef _WIN32
-    #pragma comment(lib, "yuv.lib")
-#endif
-
-
-// I420
-
-void I420Image::resize(int width, int height)
-{
-    int s = roundup<2>(width) * roundup<2>(height);
-    int sq = s / 4;
-    m_buffer.resize(s + sq + sq);
-    m_data.y = m_buffer.data();
-    m_data.u = (char*)m_data.y + s;
-    m_data.v = (char*)m_data.u + sq;
-    m_data.pitch_y = width;
-    m_data.pitch_u = m_data.pitch_v = width / 4;
-    m_data.height = height;
-}
-
-size_t I420Image::size() const
-{
-    return m_buffer.size();
-}
-I420Data& I420Image::data()
-{
-    return m_data;
-}
-const I420Data& I420Image::data() const
-{
-    return m_data;
-}
-
-void AnyToI420(I420Image& dst, Buffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height)
-{
-    if (fmt != fcPixelFormat_RGBAu8 && fmt != fcPixelFormat_RGBu8) {
-        tmp.resize(width * height * 4);
-        fcConvertPixelFormat(tmp.data(), fcPixelFormat_RGBAu8, pixels, fmt, width * height);
-        pixels = tmp.data();
-        fmt = fcPixelFormat_RGBAu8;
-    }
-
-    dst.resize(width, height);
-    auto& data = dst.data();
-    if (fmt == fcPixelFormat_RGBAu8) {
-        libyuv::ABGRToI420(
-            (const uint8*)pixels, width * 4,
-            (uint8*)data.y, width,
-            (uint8*)data.u, width >> 1,
-            (uint8*)data.v, width >> 1,
-            width, height);
-    }
-    else if (fmt == fcPixelFormat_RGBu8) {
-        libyuv::RAWToI420(
-            (const uint8*)pixels, width * 3,
-            (uint8*)data.y, width,
-            (uint8*)data.u, width >> 1,
-            (uint8*)data.v, width >> 1,
-            width, height);
-    }
-}
-
-
-
-// NV12
-
-void NV12Image::resize(int width, int height)
-{
-    int s = roundup<2>(width) * roundup<2>(height);
-    int sh = s / 2;
-    m_buffer.resize(s + sh);
-    m_data.y = m_buffer.data();
-    m_data.uv = (char*)m_data.y + s;
-    m_data.pitch_y = width;
-    m_data.pitch_uv = width / 2;
-    m_data.height = height;
-}
-
-size_t NV12Image::size() const
-{
-    return m_buffer.size();
-}
-NV12Data& NV12Image::data()
-{
-    return m_data;
-}
-const NV12Data& NV12Image::data() const
-{
-    return m_data;
-}
-
-void AnyToNV12(NV12Image& dst, Buffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height)
-{
-    if (fmt != fcPixelFormat_RGBAu8) {
-        tmp.resize(width * height * 4);
-        fcConvertPixelFormat(tmp.data(), fcPixelFormat_RGBAu8, pixels, fmt, width * height);
-        pixels = tmp.data();
-        fmt = fcPixelFormat_RGBAu8;
-    }
-
-    dst.resize(width, height);
-    auto& data = dst.data();
-    if (fmt == fcPixelFormat_RGBAu8) {
-        libyuv::ARGBToNV12(
-            (const uint8*)pixels, width * 4,
-            (uint8*)data.y, width,
-            (uint8*)data.uv, width,
-            width, height);
-    }
-}
+#include "pch.h"
+#include "fcInternal.h"
+#include "YUV.h"
+#include "Misc.h"
+#include "ThreadPool.h"
+#include "GenericKernel.h"
+
+#ifdef fcEnableISPCKernel
+    #include "YUVKernel_ispc.h"
+#endif
+#include <libyuv.h>
+#ifdef _WIN32
+    #pragma comment(lib, "yuv.lib")
+#endif
+
+
+namespace {
+
+// conversions are split into bands of rows and processed in parallel.
+// bands must have even number of rows so that each band starts at a chroma row. results are identical to whole-frame conversion.
+const int YUVBandRows = 64;
+// frames smaller than this are converted on the calling thread
+const int YUVParallelThreshold = 640 * 360;
+// fcSetYUVBandRows()
+std::atomic<int> g_yuv_band_rows = { 0 };
+
+int GetYUVBandRows(int width, int height)
+{
+    int rows = g_yuv_band_rows.load(std::memory_order_relaxed);
+    if (rows > 0) { return rows; }
+    return width * height < YUVParallelThreshold ? roundup<2>(height) : YUVBandRows;
+}
+
+// 3x4 RGB -> YUV matrix for the ISPC kernels. each row is { r, g, b, offset } and takes RGB in [0, 1].
+void GetYUVMatrix(float (&m)[12], fcColorSpace cs, fcColorRange range)
+{
+    float kr = 0.299f, kb = 0.114f;
+    if (cs == fcColorSpace::BT709) {
+        kr = 0.2126f; kb = 0.0722f;
+    }
+    float kg = 1.0f - kr - kb;
+
+    float ys = 255.0f, yo = 0.0f, cs_ = 255.0f;
+    if (range == fcColorRange::Limited) {
+        ys = 219.0f; yo = 16.0f; cs_ = 224.0f;
+    }
+    float cb = 0.5f / (1.0f - kb);
+    float cr = 0.5f / (1.0f - kr);
+
+    float tmp[12] = {
+        kr * ys,        kg * ys,        kb * ys,        yo,
+        -kr * cb * cs_, -kg * cb * cs_, 0.5f * cs_,     128.0f,
+        0.5f * cs_,     -kg * cr * cs_, -kb * cr * cs_, 128.0f,
+    };
+    memcpy(m, tmp, sizeof(m));
+}
+
+// formats the fused ISPC kernels can read directly
+bool IsYUVKernelSource(fcPixelFormat fmt)
+{
+    return fmt == fcPixelFormat_RGBAu8 || fmt == fcPixelFormat_RGBAf16 || fmt == fcPixelFormat_RGBAf32;
+}
+
+} // namespace
+
+
+// I420
+
+void I420Image::resize(int width, int height, int align)
+{
+    int pitch_y = ceildiv(width, align) * align;
+    int pitch_c = ceildiv((width + 1) / 2, align) * align;
+    size_t sy = (size_t)pitch_y * height;
+    size_t sc = (size_t)pitch_c * ((height + 1) / 2);
+    m_buffer.resize(sy + sc * 2);
+    m_data.y = m_buffer.data();
+    m_data.u = (char*)m_data.y + sy;
+    m_data.v = (char*)m_data.u + sc;
+    m_data.pitch_y = pitch_y;
+    m_data.pitch_u = m_data.pitch_v = pitch_c;
+    m_data.height = height;
+}
+
+size_t I420Image::size() const
+{
+    return m_buffer.size();
+}
+I420Data& I420Image::data()
+{
+    return m_data;
+}
+const I420Data& I420Image::data() const
+{
+    return m_data;
+}
+
+void AnyToI420(I420Image& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height, fcColorSpace cs, fcColorRange range, int align)
+{
+    dst.resize(width, height, align);
+    AnyToI420(dst.data(), tmp, pixels, fmt, width, height, cs, range);
+}
+
+void AnyToI420(const I420Data& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height, fcColorSpace cs, fcColorRange range)
+{
+    // already YUV: plane copies only
+    if (fmt == fcPixelFormat_I420) {
+        I420Data src = GetI420View(pixels, width, height);
+        libyuv::I420Copy((const uint8*)src.y, src.pitch_y, (const uint8*)src.u, src.pitch_u, (const uint8*)src.v, src.pitch_v,
+            (uint8*)dst.y, dst.pitch_y, (uint8*)dst.u, dst.pitch_u, (uint8*)dst.v, dst.pitch_v, width, height);
+        return;
+    }
+    if (fmt == fcPixelFormat_NV12) {
+        NV12Data src = GetNV12View(pixels, width, height);
+        libyuv::NV12ToI420((const uint8*)src.y, src.pitch_y, (const uint8*)src.uv, src.pitch_uv,
+            (uint8*)dst.y, dst.pitch_y, (uint8*)dst.u, dst.pitch_u, (uint8*)dst.v, dst.pitch_v, width, height);
+        return;
+    }
+
+    // libyuv handles BT.601 limited range from RGBAu8 / RGBu8 (and formats converted to RGBAu8), so the default output stays
+    // what it was before the ISPC kernels. other colorspaces / ranges and float sources go to the fused ISPC kernels.
+    // formats neither can read directly are converted to RGBAu8 band by band.
+    bool use_libyuv = cs == fcColorSpace::BT601 && range == fcColorRange::Limited;
+    bool convert = !IsYUVKernelSource(fmt) && !(use_libyuv && fmt == fcPixelFormat_RGBu8);
+    if (convert) {
+        tmp.resize(width * height * 4);
+    }
+    float m[12];
+    GetYUVMatrix(m, cs, range);
+
+    size_t src_pitch = width * fcGetPixelSize(fmt);
+    ParallelFor(0, height, GetYUVBandRows(width, height), [&](int y0, int y1) {
+        int rows = y1 - y0;
+        auto src = (const uint8*)pixels + src_pitch * y0;
+        auto src_fmt = fmt;
+        if (convert) {
+            auto t = (uint8*)tmp.data() + width * 4 * y0;
+            fcConvertPixelFormatSerial(t, fcPixelFormat_RGBAu8, src, fmt, width * rows);
+            src = t;
+            src_fmt = fcPixelFormat_RGBAu8;
+        }
+
+        auto y = (uint8*)dst.y + dst.pitch_y * y0;
+        auto u = (uint8*)dst.u + dst.pitch_u * (y0 / 2);
+        auto v = (uint8*)dst.v + dst.pitch_v * (y0 / 2);
+        if (use_libyuv && src_fmt == fcPixelFormat_RGBAu8) {
+            libyuv::ABGRToI420(src, width * 4, y, dst.pitch_y, u, dst.pitch_u, v, dst.pitch_v, width, rows);
+        }
+        else if (use_libyuv && src_fmt == fcPixelFormat_RGBu8) {
+            libyuv::RAWToI420(src, width * 3, y, dst.pitch_y, u, dst.pitch_u, v, dst.pitch_v, width, rows);
+        }
+        else if (src_fmt == fcPixelFormat_RGBAu8) {
+            fcKernelCall(RGBAu8ToI420, y, u, v, dst.pitch_y, dst.pitch_u, dst.pitch_v, (uint8_t*)src, width * 4, width, rows, m);
+        }
+        else if (src_fmt == fcPixelFormat_RGBAf16) {
+            fcKernelCall(RGBAf16ToI420, y, u, v, dst.pitch_y, dst.pitch_u, dst.pitch_v, (int16_t*)src, width * 4, width, rows, m);
+        }
+        else if (src_fmt == fcPixelFormat_RGBAf32) {
+            fcKernelCall(RGBAf32ToI420, y, u, v, dst.pitch_y, dst.pitch_u, dst.pitch_v, (float*)src, width * 4, width, rows, m);
+        }
+    });
+}
+
+fcAPI void fcSetYUVBandRows(int rows)
+{
+    g_yuv_band_rows = rows > 0 ? roundup<2>(rows) : 0;
+}
+
+fcAPI void fcConvertToI420(const I420Data& dst, const void *pixels, fcPixelFormat fmt, int width, int height, fcColorSpace cs, fcColorRange range)
+{
+    PooledBuffer tmp;
+    AnyToI420(dst, tmp, pixels, fmt, width, height, cs, range);
+}
+
+I420Data GetI420View(const void *pixels, int width, int height)
+{
+    int cw = (width + 1) / 2;
+    int ch = (height + 1) / 2;
+    I420Data r;
+    r.y = (void*)pixels;
+    r.u = (char*)r.y + width * height;
+    r.v = (char*)r.u + cw * ch;
+    r.pitch_y = width;
+    r.pitch_u = r.pitch_v = cw;
+    r.height = height;
+    return r;
+}
+
+I420Data GetI420Data(I420Image& buf, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height, fcColorSpace cs, fcColorRange range)
+{
+    if (fmt == fcPixelFormat_I420) {
+        return GetI420View(pixels, width, height);
+    }
+    AnyToI420(buf, tmp, pixels, fmt, width, height, cs, range);
+    return buf.data();
+}
+
+
+
+// NV12
+
+void NV12Image::resize(int width, int height, int align)
+{
+    int pitch_y = ceildiv(width, align) * align;
+    int pitch_uv = ceildiv(roundup<2>(width), align) * align;
+    size_t sy = (size_t)pitch_y * height;
+    size_t suv = (size_t)pitch_uv * ((height + 1) / 2);
+    m_buffer.resize(sy + suv);
+    m_data.y = m_buffer.data();
+    m_data.uv = (char*)m_data.y + sy;
+    m_data.pitch_y = pitch_y;
+    m_data.pitch_uv = pitch_uv;
+    m_data.height = height;
+}
+
+size_t NV12Image::size() const
+{
+    return m_buffer.size();
+}
+NV12Data& NV12Image::data()
+{
+    return m_data;
+}
+const NV12Data& NV12Image::data() const
+{
+    return m_data;
+}
+
+void AnyToNV12(NV12Image& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height, fcColorSpace cs, fcColorRange range, int align)
+{
+    dst.resize(width, height, align);
+    AnyToNV12(dst.data(), tmp, pixels, fmt, width, height, cs, range);
+}
+
+void AnyToNV12(const NV12Data& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height, fcColorSpace cs, fcColorRange range)
+{
+    // already YUV: plane copies only
+    if (fmt == fcPixelFormat_NV12) {
+        NV12Data src = GetNV12View(pixels, width, height);
+        libyuv::CopyPlane((const uint8*)src.y, src.pitch_y, (uint8*)dst.y, dst.pitch_y, width, height);
+        libyuv::CopyPlane((const uint8*)src.uv, src.pitch_uv, (uint8*)dst.uv, dst.pitch_uv, src.pitch_uv, (height + 1) / 2);
+        return;
+    }
+    if (fmt == fcPixelFormat_I420) {
+        I420Data src = GetI420View(pixels, width, height);
+        libyuv::I420ToNV12((const uint8*)src.y, src.pitch_y, (const uint8*)src.u, src.pitch_u, (const uint8*)src.v, src.pitch_v,
+            (uint8*)dst.y, dst.pitch_y, (uint8*)dst.uv, dst.pitch_uv, width, height);
+        return;
+    }
+
+    // libyuv handles BT.601 limited range from RGBAu8 (and formats converted to it), so the default output stays what it was
+    // before the ISPC kernels. other colorspaces / ranges and float sources go to the fused ISPC kernels.
+    bool use_libyuv = cs == fcColorSpace::BT601 && range == fcColorRange::Limited;
+    bool convert = !IsYUVKernelSource(fmt);
+    if (convert) {
+        tmp.resize(width * height * 4);
+    }
+    float m[12];
+    GetYUVMatrix(m, cs, range);
+
+    size_t src_pitch = width * fcGetPixelSize(fmt);
+    ParallelFor(0, height, GetYUVBandRows(width, height), [&](int y0, int y1) {
+        int rows = y1 - y0;
+        auto src = (const uint8*)pixels + src_pitch * y0;
+        auto src_fmt = fmt;
+        if (convert) {
+            auto t = (uint8*)tmp.data() + width * 4 * y0;
+            fcConvertPixelFormatSerial(t, fcPixelFormat_RGBAu8, src, fmt, width * rows);
+            src = t;
+            src_fmt = fcPixelFormat_RGBAu8;
+        }
+
+        auto y = (uint8*)dst.y + dst.pitch_y * y0;
+        auto uv = (uint8*)dst.uv + dst.pitch_uv * (y0 / 2);
+        if (use_libyuv && src_fmt == fcPixelFormat_RGBAu8) {
+            // ABGR in libyuv's naming is R, G, B, A in memory
+            libyuv::ABGRToNV12(src, width * 4, y, dst.pitch_y, uv, dst.pitch_uv, width, rows);
+        }
+        else if (src_fmt == fcPixelFormat_RGBAu8) {
+            fcKernelCall(RGBAu8ToNV12, y, uv, dst.pitch_y, dst.pitch_uv, (uint8_t*)src, width * 4, width, rows, m);
+        }
+        else if (src_fmt == fcPixelFormat_RGBAf16) {
+            fcKernelCall(RGBAf16ToNV12, y, uv, dst.pitch_y, dst.pitch_uv, (int16_t*)src, width * 4, width, rows, m);
+        }
+        else if (src_fmt == fcPixelFormat_RGBAf32) {
+            fcKernelCall(RGBAf32ToNV12, y, uv, dst.pitch_y, dst.pitch_uv, (float*)src, width * 4, width, rows, m);
+        }
+    });
+}
+
+fcAPI void fcConvertToNV12(const NV12Data& dst, const void *pixels, fcPixelFormat fmt, int width, int height, fcColorSpace cs, fcColorRange range)
+{
+    PooledBuffer tmp;
+    AnyToNV12(dst, tmp, pixels, fmt, width, height, cs, range);
+}
+
+NV12Data GetNV12View(const void *pixels, int width, int height)
+{
+    NV12Data r;
+    r.y = (void*)pixels;
+    r.uv = (char*)r.y + width * height;
+    r.pitch_y = width;
+    r.pitch_uv = (width + 1) / 2 * 2;
+    r.height = height;
+    return r;
+}
@@ -1,62 +1,93 @@
-#pragma once
-
-#include "Buffer.h"
-#include "PixelFormat.h"
-
-
-// I420
-
-struct I420Data
-{
-    void *y = nullptr;
-    void *u = nullptr;
-    void *v = nullptr;
-    int pitch_y = 0;
-    int pitch_u = 0;
-    int pitch_v = 0;
-    int height = 0;
-};
-
-class I420Image
-{
-public:
-    void resize(int width, int height);
-    size_t size() const;
-    I420Data& data();
-    const I420Data& data() const;
-
-private:
-    Buffer m_buffer;
-    I420Data m_data;
-};
-
-void AnyToI420(I420Image& dst, Buffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height);
-
-
-// NV12
-
-struct NV12Data
-{
-    void *y = nullptr;
-    void *uv = nullptr;
-    int pitch_y = 0;
-    int pitch_uv = 0;
-    int height = 0;
-};
-
-class NV12Image
-{
-public:
-    void resize(int width, int height);
-    size_t size() const;
-    NV12Data& data();
-    const NV12Data& data() const;
-
-private:
-    Buffer m_buffer;
-    NV12Data m_data;
-};
-
-void RGBAToNV12(NV12Image& dst, const void *rgba_pixels, int width, int height);
-void RGBAToNV12(const NV12Data& dst, const void *rgba_pixels, int width, int height);
-void AnyToNV12(NV12Image& dst, Buffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height);
+#pragma once
+
+#include "Buffer.h"
+#include "BufferPool.h"
+#include "PixelFormat.h"
+
+// pitch / plane alignment of frames prepared for encoders (see I420Image::resize()).
+// codecs read padded planes with their SIMD paths and can take them without copying.
+const int fcYUVCodecAlignment = 32;
+
+
+// I420
+
+struct I420Data
+{
+    void *y = nullptr;
+    void *u = nullptr;
+    void *v = nullptr;
+    int pitch_y = 0;
+    int pitch_u = 0;
+    int pitch_v = 0;
+    int height = 0;
+};
+
+class I420Image
+{
+public:
+    // pitches and plane offsets are rounded up to align bytes. odd sizes are fine: chroma planes are (width+1)/2 x (height+1)/2.
+    // the buffer comes from BufferPool and is reused as long as the size doesn't change.
+    void resize(int width, int height, int align = 1);
+    size_t size() const;
+    I420Data& data();
+    const I420Data& data() const;
+
+private:
+    PooledBuffer m_buffer;
+    I420Data m_data;
+};
+
+// convert pixels to I420. RGBAu8 / RGBAf16 / RGBAf32 are converted directly, other formats go through RGBAu8 in tmp.
+// large frames are split into row bands and converted on the shared thread pool.
+// I420 / NV12 sources are only copied (cs and range are ignored for them).
+void AnyToI420(I420Image& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height,
+    fcColorSpace cs = fcColorSpace::BT601, fcColorRange range = fcColorRange::Limited, int align = 1);
+void AnyToI420(const I420Data& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height,
+    fcColorSpace cs = fcColorSpace::BT601, fcColorRange range = fcColorRange::Limited);
+fcAPI void fcConvertToI420(const I420Data& dst, const void *pixels, fcPixelFormat fmt, int width, int height,
+    fcColorSpace cs = fcColorSpace::BT601, fcColorRange range = fcColorRange::Limited);
+// rows per band of the parallel I420 / NV12 conversions. rounded up to even. 0: default (whole frame below 640x360, 64 rows otherwise).
+// the result must not depend on it. for validation.
+fcAPI void fcSetYUVBandRows(int rows);
+// planes of fcPixelFormat_I420 pixels. no copy.
+I420Data GetI420View(const void *pixels, int width, int height);
+// returns fcPixelFormat_I420 pixels as they are, otherwise converts into buf.
+I420Data GetI420Data(I420Image& buf, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height,
+    fcColorSpace cs = fcColorSpace::BT601, fcColorRange range = fcColorRange::Limited);
+
+
+// NV12
+
+struct NV12Data
+{
+    void *y = nullptr;
+    void *uv = nullptr;
+    int pitch_y = 0;
+    int pitch_uv = 0;
+    int height = 0;
+};
+
+class NV12Image
+{
+public:
+    // same layout rules as I420Image::resize()
+    void resize(int width, int height, int align = 1);
+    size_t size() const;
+    NV12Data& data();
+    const NV12Data& data() const;
+
+private:
+    PooledBuffer m_buffer;
+    NV12Data m_data;
+};
+
+void RGBAToNV12(NV12Image& dst, const void *rgba_pixels, int width, int height);
+void RGBAToNV12(const NV12Data& dst, const void *rgba_pixels, int width, int height);
+void AnyToNV12(NV12Image& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height,
+    fcColorSpace cs = fcColorSpace::BT601, fcColorRange range = fcColorRange::Limited, int align = 1);
+void AnyToNV12(const NV12Data& dst, PooledBuffer& tmp, const void *pixels, fcPixelFormat fmt, int width, int height,
+    fcColorSpace cs = fcColorSpace::BT601, fcColorRange range = fcColorRange::Limited);
+fcAPI void fcConvertToNV12(const NV12Data& dst, const void *pixels, fcPixelFormat fmt, int width, int height,
+    fcColorSpace cs = fcColorSpace::BT601, fcColorRange range = fcColorRange::Limited);
+// planes of fcPixelFormat_NV12 pixels. no copy.
+NV12Data GetNV12View(const void *pixels, int width, int height);
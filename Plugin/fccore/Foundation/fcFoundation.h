@@ -1,10 +1,14 @@
-#pragma once
-
-#include "fccore.h"
-#include "Misc.h"
-#include "Buffer.h"
-#include "PixelFormat.h"
-#include "YUV.h"
-#include "LazyInstance.h"
-#include "TaskGroup.h"
-#include "TaskQueue.h"
+#pragma once
+
+#include "fccore.h"
+#include "Misc.h"
+#include "Buffer.h"
+#include "BufferPool.h"
+#include "PixelFormat.h"
+#include "YUV.h"
+#include "AudioReframer.h"
+#include "LazyInstance.h"
+#include "TaskGroup.h"
+#include "TaskQueue.h"
+#include "ThreadPool.h"
+#include "Stats.h"
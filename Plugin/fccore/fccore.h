@@ -1,357 +1,594 @@
-﻿#pragma once
-
-#ifdef _WIN32
-    #ifndef fcStaticLink
-        #ifdef fcImpl
-            #define fcAPI extern "C" __declspec(dllexport)
-        #else
-            #define fcAPI extern "C" __declspec(dllimport)
-        #endif
-    #else
-        #define fcAPI extern "C"
-    #endif
-#else
-    #define fcAPI extern "C"
-#endif
-
-#include <cstdint>
-
-class fcIGraphicsDevice;
-class fcIPngContext;
-class fcIExrContext;
-class fcIGifContext;
-class fcIMP4Context;
-class fcIWebMContext;
-class fcIWaveContext;
-class fcIOggContext;
-class fcIFlacContext;
-using fcTime = double;
-
-enum fcPixelFormat
-{
-    fcPixelFormat_Unknown = 0,
-
-    fcPixelFormat_ChannelMask = 0xF,
-    fcPixelFormat_TypeMask = 0xF << 4,
-    fcPixelFormat_Type_f16 = 0x1 << 4,
-    fcPixelFormat_Type_f32 = 0x2 << 4,
-    fcPixelFormat_Type_u8  = 0x3 << 4,
-    fcPixelFormat_Type_i16 = 0x4 << 4,
-    fcPixelFormat_Type_i32 = 0x5 << 4,
-
-    fcPixelFormat_Rf16      = fcPixelFormat_Type_f16 | 1,
-    fcPixelFormat_RGf16     = fcPixelFormat_Type_f16 | 2,
-    fcPixelFormat_RGBf16    = fcPixelFormat_Type_f16 | 3,
-    fcPixelFormat_RGBAf16   = fcPixelFormat_Type_f16 | 4,
-    fcPixelFormat_Rf32      = fcPixelFormat_Type_f32 | 1,
-    fcPixelFormat_RGf32     = fcPixelFormat_Type_f32 | 2,
-    fcPixelFormat_RGBf32    = fcPixelFormat_Type_f32 | 3,
-    fcPixelFormat_RGBAf32   = fcPixelFormat_Type_f32 | 4,
-    fcPixelFormat_Ru8       = fcPixelFormat_Type_u8  | 1,
-    fcPixelFormat_RGu8      = fcPixelFormat_Type_u8  | 2,
-    fcPixelFormat_RGBu8     = fcPixelFormat_Type_u8  | 3,
-    fcPixelFormat_RGBAu8    = fcPixelFormat_Type_u8  | 4,
-    fcPixelFormat_Ri16      = fcPixelFormat_Type_i16 | 1,
-    fcPixelFormat_RGi16     = fcPixelFormat_Type_i16 | 2,
-    fcPixelFormat_RGBi16    = fcPixelFormat_Type_i16 | 3,
-    fcPixelFormat_RGBAi16   = fcPixelFormat_Type_i16 | 4,
-    fcPixelFormat_Ri32      = fcPixelFormat_Type_i32 | 1,
-    fcPixelFormat_RGi32     = fcPixelFormat_Type_i32 | 2,
-    fcPixelFormat_RGBi32    = fcPixelFormat_Type_i32 | 3,
-    fcPixelFormat_RGBAi32   = fcPixelFormat_Type_i32 | 4,
-    fcPixelFormat_I420      = 0x10 << 4,
-    fcPixelFormat_NV12      = 0x11 << 4,
-};
-
-enum fcBitrateMode
-{
-    fcCBR,
-    fcVBR,
-};
-
-
-// -------------------------------------------------------------
-// Foundation
-// -------------------------------------------------------------
-
-fcAPI void            fcGfxInitializeOpenGL();
-fcAPI void            fcGfxInitializeD3D9(void *device);
-fcAPI void            fcGfxInitializeD3D11(void *device);
-fcAPI void            fcGfxFinalize();
-fcAPI void            fcGfxSync();
-
-fcAPI void            fcSetModulePath(const char *path);
-fcAPI const char*     fcGetModulePath();
-fcAPI fcTime          fcGetTime(); // current time in seconds
-
-
-#ifndef fcImpl
-struct fcStream;
-#else
-class BinaryStream;
-using fcStream = BinaryStream;
-#endif
-// function types for custom stream
-using fcTellp_t = size_t(*)(void *obj);
-using fcSeekp_t = void(*)(void *obj, size_t pos);
-using fcWrite_t = size_t(*)(void *obj, const void *data, size_t len);
-
-struct fcBufferData
-{
-    void *data = nullptr;
-    size_t size = 0;
-};
-fcAPI fcStream*       fcCreateFileStream(const char *path);
-fcAPI fcStream*       fcCreateMemoryStream();
-fcAPI fcStream*       fcCreateCustomStream(void *obj, fcTellp_t tellp, fcSeekp_t seekp, fcWrite_t write);
-fcAPI void            fcDestroyStream(fcStream *s);
-fcAPI fcBufferData    fcStreamGetBufferData(fcStream *s); // s must be created by fcCreateMemoryStream(), otherwise return {nullptr, 0}.
-fcAPI uint64_t        fcStreamGetWrittenSize(fcStream *s);
-
-
-// -------------------------------------------------------------
-// PNG Exporter
-// -------------------------------------------------------------
-
-enum class fcPngPixelFormat
-{
-    Adaptive, // select optimal one for input data
-    UInt8,
-    UInt16,
-};
-
-struct fcPngConfig
-{
-    int max_active_tasks = 24;
-    fcPngPixelFormat pixel_format = fcPngPixelFormat::Adaptive;
-};
-
-fcAPI bool            fcPngIsSupported();
-fcAPI fcIPngContext*  fcPngCreateContext(const fcPngConfig *conf = nullptr);
-fcAPI void            fcPngDestroyContext(fcIPngContext *ctx);
-fcAPI bool            fcPngExportPixels(fcIPngContext *ctx, const char *path, const void *pixels, int width, int height, fcPixelFormat fmt, int num_channels = 0);
-fcAPI bool            fcPngExportTexture(fcIPngContext *ctx, const char *path, void *tex, int width, int height, fcPixelFormat fmt, int num_channels = 0);
-
-
-// -------------------------------------------------------------
-// EXR Exporter
-// -------------------------------------------------------------
-
-enum class fcExrPixelFormat
-{
-    Adaptive, // select optimal one for input data
-    Half,
-    Float,
-    Int,
-};
-
-enum class fcExrCompression
-{
-    None,
-    RLE,
-    ZipS, // par-line
-    Zip,  // block
-    PIZ,
-};
-
-struct fcExrConfig
-{
-    int max_active_tasks = 24;
-    fcExrPixelFormat pixel_format = fcExrPixelFormat::Adaptive;
-    fcExrCompression compression = fcExrCompression::Zip;
-};
-
-fcAPI bool            fcExrIsSupported();
-fcAPI fcIExrContext*  fcExrCreateContext(const fcExrConfig *conf = nullptr);
-fcAPI void            fcExrDestroyContext(fcIExrContext *ctx);
-fcAPI bool            fcExrBeginImage(fcIExrContext *ctx, const char *path, int width, int height);
-fcAPI bool            fcExrAddLayerPixels(fcIExrContext *ctx, const void *pixels, fcPixelFormat fmt, int ch, const char *name);
-fcAPI bool            fcExrAddLayerTexture(fcIExrContext *ctx, void *tex, fcPixelFormat fmt, int ch, const char *name);
-fcAPI bool            fcExrEndImage(fcIExrContext *ctx);
-
-
-// -------------------------------------------------------------
-// GIF Exporter
-// -------------------------------------------------------------
-
-struct fcGifConfig
-{
-    int width = 0;
-    int height = 0;
-    int num_colors = 256;
-    int keyframe_interval = 30;
-    int max_active_tasks = 8;
-};
-
-fcAPI bool            fcGifIsSupported();
-fcAPI fcIGifContext*  fcGifCreateContext(const fcGifConfig *conf);
-fcAPI void            fcGifDestroyContext(fcIGifContext *ctx);
-fcAPI void            fcGifAddOutputStream(fcIGifContext *ctx, fcStream *stream);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcGifAddFramePixels(fcIGifContext *ctx, const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcGifAddFrameTexture(fcIGifContext *ctx, void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0);
-// force next frame to update palette
-fcAPI void            fcGifForceKeyframe(fcIGifContext *ctx);
-
-
-// -------------------------------------------------------------
-// MP4 Exporter
-// -------------------------------------------------------------
-
-enum fcMP4VideoFlags
-{
-    fcMP4_H264NVIDIA    = 1 << 1,
-    fcMP4_H264AMD       = 1 << 2,
-    fcMP4_H264IntelHW   = 1 << 3,
-    fcMP4_H264IntelSW   = 1 << 4,
-    fcMP4_H264OpenH264  = 1 << 5,
-    fcMP4_H264Mask = fcMP4_H264NVIDIA | fcMP4_H264AMD | fcMP4_H264IntelHW | fcMP4_H264IntelSW | fcMP4_H264OpenH264,
-};
-
-enum fcMP4AudioFlags
-{
-    fcMP4_AACIntel  = 1 << 1,
-    fcMP4_AACFAAC   = 1 << 2,
-    fcMP4_AACMask = fcMP4_AACIntel | fcMP4_AACFAAC,
-};
-
-struct fcMP4Config
-{
-    bool video = true;
-    bool audio = true;
-
-    int video_width = 0;
-    int video_height = 0;
-    int video_target_framerate = 60;
-    fcBitrateMode video_bitrate_mode = fcVBR;
-    int video_target_bitrate = 1024 * 1000;
-    int video_flags = fcMP4_H264Mask; // combination of fcMP4VideoFlags
-
-    int audio_sample_rate = 48000;
-    int audio_num_channels = 2;
-    fcBitrateMode audio_bitrate_mode = fcVBR;
-    int audio_target_bitrate = 128 * 1000;
-    int audio_flags = fcMP4_AACMask; // combination of fcMP4AudioFlags
-};
-
-fcAPI bool            fcMP4IsSupported();
-fcAPI fcIMP4Context*  fcMP4CreateContext(fcMP4Config *conf);
-// OS-provided mp4 encoder. in this case video_flags and audio_flags in conf are ignored
-fcAPI fcIMP4Context*  fcMP4OSCreateContext(fcMP4Config *conf, const char *out_path);
-fcAPI void            fcMP4DestroyContext(fcIMP4Context *ctx);
-fcAPI const char*     fcMP4GetVideoEncoderInfo(fcIMP4Context *ctx);
-fcAPI const char*     fcMP4GetAudioEncoderInfo(fcIMP4Context *ctx);
-fcAPI void            fcMP4AddOutputStream(fcIMP4Context *ctx, fcStream *stream);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcMP4AddVideoFramePixels(fcIMP4Context *ctx, const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcMP4AddVideoFrameTexture(fcIMP4Context *ctx, void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcMP4AddAudioFrame(fcIMP4Context *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
-
-
-
-// -------------------------------------------------------------
-// WebM Exporter
-// -------------------------------------------------------------
-
-enum class fcWebMVideoEncoder
-{
-    VP8,
-    VP9,
-    VP9LossLess,
-};
-enum class fcWebMAudioEncoder
-{
-    Vorbis,
-    Opus,
-};
-
-struct fcWebMConfig
-{
-    fcWebMVideoEncoder video_encoder = fcWebMVideoEncoder::VP8;
-    fcWebMAudioEncoder audio_encoder = fcWebMAudioEncoder::Vorbis;
-    bool video = true;
-    bool audio = true;
-
-    int video_width = 0;
-    int video_height = 0;
-    int video_target_framerate = 60;
-    fcBitrateMode video_bitrate_mode = fcVBR;
-    int video_target_bitrate = 1024 * 1000;
-
-    int audio_sample_rate = 48000;
-    int audio_num_channels = 2;
-    fcBitrateMode audio_bitrate_mode = fcVBR;
-    int audio_target_bitrate = 128 * 1000;
-};
-
-fcAPI bool            fcWebMIsSupported();
-fcAPI fcIWebMContext* fcWebMCreateContext(fcWebMConfig *conf);
-fcAPI void            fcWebMDestroyContext(fcIWebMContext *ctx);
-fcAPI void            fcWebMAddOutputStream(fcIWebMContext *ctx, fcStream *stream);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcWebMAddVideoFramePixels(fcIWebMContext *ctx, const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcWebMAddVideoFrameTexture(fcIWebMContext *ctx, void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0);
-// timestamp=-1 is treated as current time.
-fcAPI bool            fcWebMAddAudioFrame(fcIWebMContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
-
-
-
-// -------------------------------------------------------------
-// Wave Exporter
-// -------------------------------------------------------------
-
-struct fcWaveConfig
-{
-    int sample_rate = 48000;
-    int num_channels = 2;
-    int bits_per_sample = 16;
-};
-fcAPI bool            fcWaveIsSupported();
-fcAPI fcIWaveContext* fcWaveCreateContext(fcWaveConfig *conf);
-fcAPI void            fcWaveDestroyContext(fcIWaveContext *ctx);
-fcAPI void            fcWaveAddOutputStream(fcIWaveContext *ctx, fcStream *stream);
-fcAPI bool            fcWaveAddAudioFrame(fcIWaveContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
-
-
-// -------------------------------------------------------------
-// Ogg Exporter
-// -------------------------------------------------------------
-
-struct fcOggConfig
-{
-    int sample_rate = 48000;
-    int num_channels = 2;
-    fcBitrateMode bitrate_mode = fcBitrateMode::fcVBR;
-    int target_bitrate = 128 * 1000;
-};
-fcAPI bool            fcOggIsSupported();
-fcAPI fcIOggContext*  fcOggCreateContext(fcOggConfig *conf);
-fcAPI void            fcOggDestroyContext(fcIOggContext *ctx);
-fcAPI void            fcOggAddOutputStream(fcIOggContext *ctx, fcStream *stream);
-fcAPI bool            fcOggAddAudioFrame(fcIOggContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
-
-
-// -------------------------------------------------------------
-// Flac Exporter
-// -------------------------------------------------------------
-
-struct fcFlacConfig
-{
-    int sample_rate = 48000;
-    int num_channels = 2;
-    int bits_per_sample = 16;
-    int compression_level = 5;
-    int block_size = 0;
-    bool verify = false;
-};
-fcAPI bool            fcFlacIsSupported();
-fcAPI fcIFlacContext* fcFlacCreateContext(fcFlacConfig *conf);
-fcAPI void            fcFlacDestroyContext(fcIFlacContext *ctx);
-fcAPI void            fcFlacAddOutputStream(fcIFlacContext *ctx, fcStream *stream);
-fcAPI bool            fcFlacAddAudioFrame(fcIFlacContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
-
-
+﻿#pragma once
+
+#ifdef _WIN32
+    #ifndef fcStaticLink
+        #ifdef fcImpl
+            #define fcAPI extern "C" __declspec(dllexport)
+        #else
+            #define fcAPI extern "C" __declspec(dllimport)
+        #endif
+    #else
+        #define fcAPI extern "C"
+    #endif
+#else
+    #define fcAPI extern "C"
+#endif
+
+#include <cstdint>
+
+class fcIGraphicsDevice;
+class fcIPngContext;
+class fcIExrContext;
+class fcIGifContext;
+class fcIMP4Context;
+class fcIWebMContext;
+class fcIWaveContext;
+class fcIOggContext;
+class fcIFlacContext;
+using fcTime = double;
+
+enum fcPixelFormat
+{
+    fcPixelFormat_Unknown = 0,
+
+    fcPixelFormat_ChannelMask = 0xF,
+    fcPixelFormat_TypeMask = 0xF << 4,
+    fcPixelFormat_Type_f16 = 0x1 << 4,
+    fcPixelFormat_Type_f32 = 0x2 << 4,
+    fcPixelFormat_Type_u8  = 0x3 << 4,
+    fcPixelFormat_Type_i16 = 0x4 << 4,
+    fcPixelFormat_Type_i32 = 0x5 << 4,
+
+    fcPixelFormat_Rf16      = fcPixelFormat_Type_f16 | 1,
+    fcPixelFormat_RGf16     = fcPixelFormat_Type_f16 | 2,
+    fcPixelFormat_RGBf16    = fcPixelFormat_Type_f16 | 3,
+    fcPixelFormat_RGBAf16   = fcPixelFormat_Type_f16 | 4,
+    fcPixelFormat_Rf32      = fcPixelFormat_Type_f32 | 1,
+    fcPixelFormat_RGf32     = fcPixelFormat_Type_f32 | 2,
+    fcPixelFormat_RGBf32    = fcPixelFormat_Type_f32 | 3,
+    fcPixelFormat_RGBAf32   = fcPixelFormat_Type_f32 | 4,
+    fcPixelFormat_Ru8       = fcPixelFormat_Type_u8  | 1,
+    fcPixelFormat_RGu8      = fcPixelFormat_Type_u8  | 2,
+    fcPixelFormat_RGBu8     = fcPixelFormat_Type_u8  | 3,
+    fcPixelFormat_RGBAu8    = fcPixelFormat_Type_u8  | 4,
+    fcPixelFormat_Ri16      = fcPixelFormat_Type_i16 | 1,
+    fcPixelFormat_RGi16     = fcPixelFormat_Type_i16 | 2,
+    fcPixelFormat_RGBi16    = fcPixelFormat_Type_i16 | 3,
+    fcPixelFormat_RGBAi16   = fcPixelFormat_Type_i16 | 4,
+    fcPixelFormat_Ri32      = fcPixelFormat_Type_i32 | 1,
+    fcPixelFormat_RGi32     = fcPixelFormat_Type_i32 | 2,
+    fcPixelFormat_RGBi32    = fcPixelFormat_Type_i32 | 3,
+    fcPixelFormat_RGBAi32   = fcPixelFormat_Type_i32 | 4,
+    // planar YUV (8 bit). Y plane (width x height) followed by chroma planes of ((width+1)/2 x (height+1)/2), no padding.
+    // I420: U plane then V plane. NV12: one plane of interleaved UV.
+    // accepted by fcMP4AddVideoFramePixels() / fcWebMAddVideoFramePixels() and passed to the encoders without color conversion.
+    fcPixelFormat_I420      = 0x10 << 4,
+    fcPixelFormat_NV12      = 0x11 << 4,
+};
+
+enum fcBitrateMode
+{
+    fcCBR,
+    fcVBR,
+};
+
+// RGB -> YUV conversion
+enum class fcColorSpace
+{
+    BT601,
+    BT709,
+};
+
+enum class fcColorRange
+{
+    Limited, // Y: 16-235, UV: 16-240
+    Full,    // 0-255
+};
+
+
+// -------------------------------------------------------------
+// Foundation
+// -------------------------------------------------------------
+
+fcAPI void            fcGfxInitializeOpenGL();
+fcAPI void            fcGfxInitializeD3D9(void *device);
+fcAPI void            fcGfxInitializeD3D11(void *device);
+fcAPI void            fcGfxFinalize();
+fcAPI void            fcGfxSync();
+
+fcAPI void            fcSetModulePath(const char *path);
+fcAPI const char*     fcGetModulePath();
+fcAPI fcTime          fcGetTime(); // current time in seconds
+
+struct fcAllocatorConfig
+{
+    size_t large_alloc_threshold = 16 * 1024 * 1024; // allocations >= this are mapped directly instead of going to the heap. windows & linux only
+    bool use_huge_pages = false; // large allocations: MAP_HUGETLB / MEM_LARGE_PAGES if available, otherwise transparent huge pages
+    // large allocations: bind pages to the NUMA node of the allocating thread. frame buffers are allocated on the thread that
+    // adds frames, not on the encoder workers, so this only helps when those run on the same node.
+    bool numa_local = false;
+};
+struct fcAllocatorStats // bytes currently allocated through each path
+{
+    uint64_t heap_bytes = 0;
+    uint64_t large_bytes = 0;
+    uint64_t huge_page_bytes = 0; // explicit huge pages only (MAP_HUGETLB / MEM_LARGE_PAGES)
+    uint64_t numa_bound_bytes = 0;
+};
+fcAPI void            fcSetAllocatorConfig(const fcAllocatorConfig *conf);
+fcAPI void            fcGetAllocatorStats(fcAllocatorStats *dst);
+
+struct fcBufferPoolConfig
+{
+    size_t max_cached_bytes = 512 * 1024 * 1024; // released blocks beyond this are returned to the OS
+    bool use_huge_pages = false; // blocks >= 2MB are mapped with huge pages regardless of fcAllocatorConfig. windows & linux only
+};
+struct fcBufferPoolStats // pooled-size (>= 64KB) requests only
+{
+    uint64_t allocations = 0;
+    uint64_t reuses = 0; // allocations served from the cache
+    uint64_t cached_bytes = 0;
+};
+fcAPI void            fcSetBufferPoolConfig(const fcBufferPoolConfig *conf);
+fcAPI void            fcGetBufferPoolStats(fcBufferPoolStats *dst);
+fcAPI void            fcReleaseBufferPool(); // free all cached blocks
+
+// instruction set used by the pixel / sample conversion kernels
+enum class fcKernelTarget
+{
+    Scalar, // portable C++ kernels. used when ISPC is not available
+    SSE2,
+    SSE4,
+    AVX,
+    AVX2,
+    AVX512,
+    NEON,
+};
+fcAPI fcKernelTarget  fcGetKernelTarget(); // target picked by ISPC's runtime dispatch for this CPU
+fcAPI void            fcForceScalarKernels(bool v); // use the C++ kernels even if ISPC ones are available. for validation and benchmarks
+
+// crop / flip / resize combined with pixel format conversion
+struct fcPixelRect
+{
+    int x = 0, y = 0;          // top-left of the region in pixels
+    int width = 0, height = 0; // size of the region
+    int pitch = 0;             // bytes per row of the whole image. 0: (x + width) * pixel size
+    int image_height = 0;      // rows of the whole image. 0: y + height
+};
+enum fcTransformFlags
+{
+    fcTransform_FlipY    = 1 << 0, // read the source region bottom-up
+    fcTransform_Bilinear = 1 << 1, // bilinear filter when resizing. default is box filter (area average)
+};
+// converts src_rect of src into dst_rect of dst. region sizes may differ. supports u8 / i16 / f16 / f32 with 1-4 channels (not i32).
+// returns false if a region doesn't fit in its pitch / image_height.
+fcAPI bool            fcTransformPixels(void *dst, fcPixelFormat dstfmt, const fcPixelRect *dst_rect,
+                          const void *src, fcPixelFormat srcfmt, const fcPixelRect *src_rect, int flags);
+
+// input stage of the encoder contexts (fc*SetPixelTransform()).
+// once set, pixels passed to the context are read through src_rect and resized to the frame size.
+struct fcPixelTransform
+{
+    fcPixelRect src_rect;
+    int flags = 0; // combination of fcTransformFlags
+};
+
+
+#ifndef fcImpl
+struct fcStream;
+#else
+class BinaryStream;
+using fcStream = BinaryStream;
+#endif
+// function types for custom stream
+using fcTellp_t = size_t(*)(void *obj);
+using fcSeekp_t = void(*)(void *obj, size_t pos);
+using fcWrite_t = size_t(*)(void *obj, const void *data, size_t len);
+
+struct fcBufferData
+{
+    void *data = nullptr;
+    size_t size = 0;
+};
+fcAPI fcStream*       fcCreateFileStream(const char *path);
+fcAPI fcStream*       fcCreateMemoryStream();
+fcAPI fcStream*       fcCreateCustomStream(void *obj, fcTellp_t tellp, fcSeekp_t seekp, fcWrite_t write);
+fcAPI void            fcDestroyStream(fcStream *s);
+fcAPI fcBufferData    fcStreamGetBufferData(fcStream *s); // s must be created by fcCreateMemoryStream(), otherwise return {nullptr, 0}.
+fcAPI uint64_t        fcStreamGetWrittenSize(fcStream *s);
+
+// handle of a background operation (e.g. fc*DestroyContextAsync()).
+// callback is called on the background thread once the operation is done.
+// fcAsyncRelease() waits for the operation if it is not finished yet. every handle must be released.
+struct fcAsync;
+using fcAsyncCallback = void(*)(void *userdata);
+fcAPI bool            fcAsyncIsFinished(fcAsync *a); // null is regarded as finished
+fcAPI void            fcAsyncWait(fcAsync *a);
+fcAPI void            fcAsyncRelease(fcAsync *a);
+
+// pipeline statistics. every context (fcIPngContext, fcIMP4Context etc.) collects them while it is alive.
+// stage times are measured per frame (per audio block for audio stages) on the thread that does the work.
+enum fcStatsStage
+{
+    fcStatsStage_Readback,  // texture -> system memory
+    fcStatsStage_Convert,   // pixel transform / pixel format conversion
+    fcStatsStage_YUV,       // RGB -> YUV, when done ahead of the encoder
+    fcStatsStage_Encode,    // video frame / image encoding
+    fcStatsStage_AudioEncode,
+    fcStatsStage_Mux,       // container writing, including the writes to the output streams
+    fcStatsStage_Write,     // file writes of contexts that write whole files themselves (PNG etc). containers' writes are in Mux.
+    fcStatsStage_Count,
+};
+struct fcStageStats
+{
+    uint64_t count = 0;
+    double total_ms = 0.0;
+    double p50_ms = 0.0; // percentiles are approximate (within ~10%)
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+};
+struct fcStats
+{
+    fcStageStats stages[fcStatsStage_Count];
+    int video_queue_depth = 0;      // frames accepted and not encoded yet
+    int video_queue_depth_max = 0;
+    int audio_queue_depth = 0;
+    int audio_queue_depth_max = 0;
+    uint64_t bytes_written = 0;     // to all output streams
+    uint64_t buffer_waits = 0;      // times a frame had to wait for a free buffer (the pipeline was full)
+    double buffer_wait_ms = 0.0;
+};
+// ctx: any context. return false if ctx is not a live context.
+fcAPI bool            fcGetContextStats(const void *ctx, fcStats *dst);
+// records every stage sample as a trace event while enabled (up to ~1M events). disabled by default.
+fcAPI bool            fcSetContextTracing(const void *ctx, bool v);
+// writes recorded trace events as Chrome trace event JSON (chrome://tracing, Perfetto)
+fcAPI bool            fcDumpContextTrace(const void *ctx, const char *path);
+// "Readback", "Encode" etc. the same names as in the trace. "" if stage is out of range.
+fcAPI const char*     fcGetStatsStageName(fcStatsStage stage);
+
+
+// -------------------------------------------------------------
+// PNG Exporter
+// -------------------------------------------------------------
+
+enum class fcPngPixelFormat
+{
+    Adaptive, // select optimal one for input data
+    UInt8,
+    UInt16,
+};
+
+struct fcPngConfig
+{
+    int max_active_tasks = 24;
+    fcPngPixelFormat pixel_format = fcPngPixelFormat::Adaptive;
+};
+
+fcAPI bool            fcPngIsSupported();
+fcAPI fcIPngContext*  fcPngCreateContext(const fcPngConfig *conf = nullptr);
+fcAPI void            fcPngDestroyContext(fcIPngContext *ctx);
+// finalizes and destroys ctx on a background thread. output streams must stay alive until the returned handle is finished.
+fcAPI fcAsync*        fcPngDestroyContextAsync(fcIPngContext *ctx, fcAsyncCallback cb = nullptr, void *userdata = nullptr);
+fcAPI bool            fcPngExportPixels(fcIPngContext *ctx, const char *path, const void *pixels, int width, int height, fcPixelFormat fmt, int num_channels = 0);
+fcAPI bool            fcPngExportTexture(fcIPngContext *ctx, const char *path, void *tex, int width, int height, fcPixelFormat fmt, int num_channels = 0);
+fcAPI void            fcPngSetPixelTransform(fcIPngContext *ctx, const fcPixelTransform *t); // nullptr: disable. width / height of fcPngExportPixels() are the output size
+
+
+// -------------------------------------------------------------
+// EXR Exporter
+// -------------------------------------------------------------
+
+enum class fcExrPixelFormat
+{
+    Adaptive, // select optimal one for input data
+    Half,
+    Float,
+    Int,
+};
+
+enum class fcExrCompression
+{
+    None,
+    RLE,
+    ZipS, // par-line
+    Zip,  // block
+    PIZ,
+};
+
+struct fcExrConfig
+{
+    int max_active_tasks = 24;
+    fcExrPixelFormat pixel_format = fcExrPixelFormat::Adaptive;
+    fcExrCompression compression = fcExrCompression::Zip;
+};
+
+fcAPI bool            fcExrIsSupported();
+fcAPI fcIExrContext*  fcExrCreateContext(const fcExrConfig *conf = nullptr);
+fcAPI void            fcExrDestroyContext(fcIExrContext *ctx);
+fcAPI fcAsync*        fcExrDestroyContextAsync(fcIExrContext *ctx, fcAsyncCallback cb = nullptr, void *userdata = nullptr);
+fcAPI bool            fcExrBeginImage(fcIExrContext *ctx, const char *path, int width, int height);
+fcAPI bool            fcExrAddLayerPixels(fcIExrContext *ctx, const void *pixels, fcPixelFormat fmt, int ch, const char *name);
+fcAPI bool            fcExrAddLayerTexture(fcIExrContext *ctx, void *tex, fcPixelFormat fmt, int ch, const char *name);
+fcAPI bool            fcExrEndImage(fcIExrContext *ctx);
+fcAPI void            fcExrSetPixelTransform(fcIExrContext *ctx, const fcPixelTransform *t); // nullptr: disable
+
+
+// -------------------------------------------------------------
+// GIF Exporter
+// -------------------------------------------------------------
+
+struct fcGifConfig
+{
+    int width = 0;
+    int height = 0;
+    int num_colors = 256;
+    int keyframe_interval = 30;
+    int max_active_tasks = 8;
+};
+
+fcAPI bool            fcGifIsSupported();
+fcAPI fcIGifContext*  fcGifCreateContext(const fcGifConfig *conf);
+fcAPI void            fcGifDestroyContext(fcIGifContext *ctx);
+fcAPI fcAsync*        fcGifDestroyContextAsync(fcIGifContext *ctx, fcAsyncCallback cb = nullptr, void *userdata = nullptr);
+fcAPI void            fcGifAddOutputStream(fcIGifContext *ctx, fcStream *stream);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcGifAddFramePixels(fcIGifContext *ctx, const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcGifAddFrameTexture(fcIGifContext *ctx, void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0);
+// force next frame to update palette
+fcAPI void            fcGifForceKeyframe(fcIGifContext *ctx);
+fcAPI void            fcGifSetPixelTransform(fcIGifContext *ctx, const fcPixelTransform *t); // nullptr: disable
+
+
+// -------------------------------------------------------------
+// MP4 Exporter
+// -------------------------------------------------------------
+
+enum fcMP4VideoFlags
+{
+    fcMP4_H264NVIDIA    = 1 << 1,
+    fcMP4_H264AMD       = 1 << 2,
+    fcMP4_H264IntelHW   = 1 << 3,
+    fcMP4_H264IntelSW   = 1 << 4,
+    fcMP4_H264OpenH264  = 1 << 5,
+    fcMP4_H264Mask = fcMP4_H264NVIDIA | fcMP4_H264AMD | fcMP4_H264IntelHW | fcMP4_H264IntelSW | fcMP4_H264OpenH264,
+};
+
+enum fcMP4AudioFlags
+{
+    fcMP4_AACIntel  = 1 << 1,
+    fcMP4_AACFAAC   = 1 << 2,
+    fcMP4_AACMask = fcMP4_AACIntel | fcMP4_AACFAAC,
+};
+
+struct fcMP4Config
+{
+    bool video = true;
+    bool audio = true;
+
+    int video_width = 0;
+    int video_height = 0;
+    int video_target_framerate = 60;
+    fcBitrateMode video_bitrate_mode = fcVBR;
+    int video_target_bitrate = 1024 * 1000;
+    int video_flags = fcMP4_H264Mask; // combination of fcMP4VideoFlags
+
+    int audio_sample_rate = 48000;
+    int audio_num_channels = 2;
+    fcBitrateMode audio_bitrate_mode = fcVBR;
+    int audio_target_bitrate = 128 * 1000;
+    int audio_flags = fcMP4_AACMask; // combination of fcMP4AudioFlags
+    // true: audio timing is the number of encoded samples / sample rate, so every AAC packet lasts exactly one frame and
+    // 'stts' is a single entry. audio can't drift against the sample rate, but gaps in the input are closed up.
+    // false: audio follows the timestamps given to fcMP4AddAudioFrame(). the first sample of each call is placed at its
+    // timestamp and the following ones are counted from there. timestamp=-1 continues from the previous call.
+    bool audio_sample_clock = true;
+
+    // in seconds. encoded audio and video are held up to this long so that they are written in timestamp order (see fcWebMConfig).
+    double interleave_window = 1.0;
+    // in seconds. samples of each track are written in chunks of this length, so that a player reads this much audio and the
+    // corresponding video sequentially and 'stco' has one entry per chunk. the samples of the current chunk are held in memory.
+    // 0: every sample is written as soon as it arrives.
+    double chunk_duration = 0.5;
+
+    // offline capture: >1 encodes closed-GOP segments of video_segment_frames frames in parallel (see fcWebMConfig).
+    // only software encoders (OpenH264, Intel SW) are used in this mode. hardware encoders run on their own silicon and don't scale with cores.
+    int video_parallel_segments = 0;
+    int video_segment_frames = 120;
+    int video_max_buffered_frames = 0;
+    // true: frames are a constant 1 / video_target_framerate apart and their timestamps are ignored. 'stts' is a single entry.
+    // false: frame durations are taken from the timestamps.
+    bool video_constant_framerate = false;
+};
+
+fcAPI bool            fcMP4IsSupported();
+fcAPI fcIMP4Context*  fcMP4CreateContext(fcMP4Config *conf);
+// tries the encoders enabled by conf and remembers which ones work with its settings (resolution, sample rate and channels).
+// call it early (e.g. at startup) so that fcMP4CreateContext() skips the ones that fail and recording start doesn't pay for
+// module loading. hardware encoders are tried on the calling thread, as they need the graphics device. software encoders
+// and module loading run on a background thread.
+fcAPI void            fcMP4ProbeEncoders(fcMP4Config *conf);
+// OS-provided mp4 encoder. in this case video_flags and audio_flags in conf are ignored
+fcAPI fcIMP4Context*  fcMP4OSCreateContext(fcMP4Config *conf, const char *out_path);
+fcAPI void            fcMP4DestroyContext(fcIMP4Context *ctx);
+// returns immediately. draining and destroying the encoders, muxing the frames still held and finalizing the outputs all run
+// in the background. encoders already run on the context's worker threads, not on the thread that added the frames.
+// output streams must outlive the operation.
+fcAPI fcAsync*        fcMP4DestroyContextAsync(fcIMP4Context *ctx, fcAsyncCallback cb = nullptr, void *userdata = nullptr);
+fcAPI const char*     fcMP4GetVideoEncoderInfo(fcIMP4Context *ctx);
+fcAPI const char*     fcMP4GetAudioEncoderInfo(fcIMP4Context *ctx);
+fcAPI void            fcMP4AddOutputStream(fcIMP4Context *ctx, fcStream *stream);
+// raw encoded H.264 (Annex B) and AAC frames also go to video_stream / audio_stream (either can be null). for debugging.
+// call before adding frames. not supported by contexts created with fcMP4OSCreateContext().
+fcAPI void            fcMP4AddElementaryStreamTap(fcIMP4Context *ctx, fcStream *video_stream, fcStream *audio_stream);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcMP4AddVideoFramePixels(fcIMP4Context *ctx, const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcMP4AddVideoFrameTexture(fcIMP4Context *ctx, void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcMP4AddAudioFrame(fcIMP4Context *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
+fcAPI void            fcMP4SetPixelTransform(fcIMP4Context *ctx, const fcPixelTransform *t); // nullptr: disable
+
+
+
+// -------------------------------------------------------------
+// WebM Exporter
+// -------------------------------------------------------------
+
+enum class fcWebMVideoEncoder
+{
+    VP8,
+    VP9,
+    VP9LossLess,
+};
+enum class fcWebMAudioEncoder
+{
+    Vorbis,
+    Opus,
+};
+// libvpx encoding deadline. Realtime is required to keep up with capture; Good trades speed for quality (offline capture).
+enum class fcVPXDeadline
+{
+    Realtime,
+    Good,
+    Best,
+};
+
+struct fcWebMConfig
+{
+    fcWebMVideoEncoder video_encoder = fcWebMVideoEncoder::VP8;
+    fcWebMAudioEncoder audio_encoder = fcWebMAudioEncoder::Vorbis;
+    bool video = true;
+    bool audio = true;
+
+    int video_width = 0;
+    int video_height = 0;
+    int video_target_framerate = 60;
+    fcBitrateMode video_bitrate_mode = fcVBR;
+    int video_target_bitrate = 1024 * 1000;
+    int audio_sample_rate = 48000;
+    int audio_num_channels = 2;
+    fcBitrateMode audio_bitrate_mode = fcVBR;
+    int audio_target_bitrate = 128 * 1000;
+
+    // in seconds. encoded audio and video are held up to this long so that they are written in timestamp order.
+    // gives monotonic muxing and keeps audio and video of the same time close together in the file. 0: written as soon as encoded
+    double interleave_window = 1.0;
+
+    // live (default): nothing is patched after it is written and no Cues are written, so any output works, including ones that
+    // can't seek (e.g. streaming). false: the seek index (Cues) is appended on finalize and only header fields are patched in place.
+    // every output stream must be seekable then. the file is not rewritten.
+    bool live = true;
+    double max_cluster_duration = 0.0;  // in seconds. 0: libwebm default (30 seconds)
+    int max_cluster_size = 0;           // in bytes. 0: no limit
+    // interval of seek points in seconds. each video keyframe starts a cluster and gets a cue point, so this caps the keyframe
+    // distance of the video encoder. audio only files get a cue point per cluster, so this caps the cluster duration instead.
+    // 0: encoder default
+    double cue_interval = 0.0;
+
+    // libvpx speed settings. defaults are tuned to keep up with 1080p60 on an 8 core machine.
+    fcVPXDeadline video_deadline = fcVPXDeadline::Realtime;
+    int video_cpu_used = 8;         // speed preset. VP8: 0-16, VP9: 0-9. higher is faster.
+    int video_threads = 0;          // 0: number of hardware threads
+    int video_tile_columns = -1;    // VP9 only. log2 of tile columns. -1: decided by width and thread count
+    bool video_row_mt = true;       // VP9 only. row based multi-threading
+    int video_lag_in_frames = 0;    // look-ahead frames. ignored (treated as 0) by Realtime deadline
+
+    // offline capture: >1 splits the stream into closed-GOP segments of video_segment_frames frames and encodes that many segments
+    // in parallel, each by its own encoder instance. throughput scales with cores at the cost of a keyframe per segment and
+    // buffered raw frames. 0 or 1: one encoder (realtime capture).
+    // video_max_buffered_frames caps the raw frames waiting for the segment encoders; adding a frame beyond it waits until an
+    // encoder takes one. a raw frame is width * height * bytes per pixel of the input (~8MB for 1080p RGBA8), and the segments
+    // only overlap fully with video_parallel_segments * video_segment_frames of them. 0: as many as fit in 1GB of RGBA8 frames.
+    // the buffers are kept until the context is destroyed. lower video_segment_frames to overlap with fewer frames.
+    int video_parallel_segments = 0;
+    int video_segment_frames = 120;
+    int video_max_buffered_frames = 0;
+};
+
+fcAPI bool            fcWebMIsSupported();
+fcAPI fcIWebMContext* fcWebMCreateContext(fcWebMConfig *conf);
+fcAPI void            fcWebMDestroyContext(fcIWebMContext *ctx);
+// same as fcMP4DestroyContextAsync(): the encoders are drained and the outputs are finalized in the background.
+fcAPI fcAsync*        fcWebMDestroyContextAsync(fcIWebMContext *ctx, fcAsyncCallback cb = nullptr, void *userdata = nullptr);
+fcAPI void            fcWebMAddOutputStream(fcIWebMContext *ctx, fcStream *stream);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcWebMAddVideoFramePixels(fcIWebMContext *ctx, const void *pixels, fcPixelFormat fmt, fcTime timestamp = -1.0);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcWebMAddVideoFrameTexture(fcIWebMContext *ctx, void *tex, fcPixelFormat fmt, fcTime timestamp = -1.0);
+// timestamp=-1 is treated as current time.
+fcAPI bool            fcWebMAddAudioFrame(fcIWebMContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
+fcAPI void            fcWebMSetPixelTransform(fcIWebMContext *ctx, const fcPixelTransform *t); // nullptr: disable
+
+
+
+// -------------------------------------------------------------
+// Wave Exporter
+// -------------------------------------------------------------
+
+struct fcWaveConfig
+{
+    int sample_rate = 48000;
+    int num_channels = 2;
+    int bits_per_sample = 16;
+};
+fcAPI bool            fcWaveIsSupported();
+fcAPI fcIWaveContext* fcWaveCreateContext(fcWaveConfig *conf);
+fcAPI void            fcWaveDestroyContext(fcIWaveContext *ctx);
+fcAPI void            fcWaveAddOutputStream(fcIWaveContext *ctx, fcStream *stream);
+fcAPI bool            fcWaveAddAudioFrame(fcIWaveContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
+
+
+// -------------------------------------------------------------
+// Ogg Exporter
+// -------------------------------------------------------------
+
+enum class fcOggAudioEncoder
+{
+    Vorbis,
+    Opus, // sample_rate must be 8000, 12000, 16000, 24000 or 48000 and num_channels 1 or 2
+};
+
+struct fcOggConfig
+{
+    int sample_rate = 48000;
+    int num_channels = 2;
+    fcBitrateMode bitrate_mode = fcBitrateMode::fcVBR;
+    int target_bitrate = 128 * 1000;
+    fcOggAudioEncoder encoder = fcOggAudioEncoder::Vorbis;
+};
+fcAPI bool            fcOggIsSupported();
+fcAPI fcIOggContext*  fcOggCreateContext(fcOggConfig *conf);
+fcAPI void            fcOggDestroyContext(fcIOggContext *ctx);
+fcAPI void            fcOggAddOutputStream(fcIOggContext *ctx, fcStream *stream);
+fcAPI bool            fcOggAddAudioFrame(fcIOggContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
+// raw encoded packets: records of [uint32 size][int64 granule][size bytes], little endian.
+// the first record is the codec private data (Vorbis: Xiph-laced headers, Opus: OpusHead) with granule -1.
+fcAPI void            fcOggAddPacketStream(fcIOggContext *ctx, fcStream *stream);
+// packets encoded by ctx also go to webm's audio track, so both files share one audio analysis.
+// webm must be created with audio enabled and the same sample rate and channels. its audio_encoder setting is ignored and
+// fcWebMAddAudioFrame() fails on it from then on. call before adding frames to either context, and destroy ctx before webm.
+fcAPI bool            fcOggAddWebMOutput(fcIOggContext *ctx, fcIWebMContext *webm);
+
+
+// -------------------------------------------------------------
+// Flac Exporter
+// -------------------------------------------------------------
+
+struct fcFlacConfig
+{
+    int sample_rate = 48000;
+    int num_channels = 2;
+    int bits_per_sample = 16;
+    int compression_level = 5;
+    int block_size = 0;
+    bool verify = false;
+};
+fcAPI bool            fcFlacIsSupported();
+fcAPI fcIFlacContext* fcFlacCreateContext(fcFlacConfig *conf);
+fcAPI void            fcFlacDestroyContext(fcIFlacContext *ctx);
+fcAPI void            fcFlacAddOutputStream(fcIFlacContext *ctx, fcStream *stream);
+fcAPI bool            fcFlacAddAudioFrame(fcIFlacContext *ctx, const float *samples, int num_samples, fcTime timestamp = -1.0);
+
+
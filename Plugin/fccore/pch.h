@@ -1,25 +1,27 @@
-﻿#ifdef _MSC_VER
-    #pragma warning(disable: 4190)
-    #define _CRT_SECURE_NO_WARNINGS
-#endif
-
-#include <algorithm>
-#include <string>
-#include <vector>
-#include <deque>
-#include <list>
-#include <map>
-#include <memory>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
-#include <future>
-#include <functional>
-#include <fstream>
-#include <sstream>
-#include <cstring>
-#include <cstdarg>
-
-#define fcImpl
-#include "fcInternal.h"
+﻿#ifdef _MSC_VER
+    #pragma warning(disable: 4190)
+    #define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdarg>
+
+#define fcImpl
+#include "fcInternal.h"